@@ -0,0 +1,284 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// Emulation & import throughput benchmark (console app). Prints one JSON object per line (JSON Lines) so the results can be diffed/tracked between releases.
+// Usage: sidplaywx-bench [songs.zip] [Songlengths.md5] [seconds per tune]
+
+#include "../src/PlaybackController/TuneInfoScanner.h"
+#include "../src/PlaybackController/PlaybackWrappers/Input/SidDecoder.h"
+#include "../src/PlaybackController/PlaybackWrappers/Input/Songlengths.h"
+#include "../src/Util/BufferHolder.h"
+
+#include <wx/init.h>
+#include <wx/wfstream.h>
+#include <wx/zipstrm.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr const char* const DEFAULT_SONGS_ZIP = "dev/bundled-Songs.zip";
+    constexpr const char* const DEFAULT_SONGLENGTHS = "dev/bundled-Songlengths.md5";
+    constexpr int DEFAULT_SECONDS_PER_TUNE = 10;
+    constexpr unsigned long CHUNK_FRAMES = 512; // Similar to a typical audio callback request.
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Tune
+    {
+        std::string name;
+        std::vector<uint_least8_t> data;
+    };
+
+    struct EmulationVariant
+    {
+        const char* name;
+        SidConfig::sid_model_t sidModel;
+        uint_least32_t sampleRate;
+        bool filterEnabled;
+    };
+
+    constexpr EmulationVariant EMULATION_VARIANTS[] = {
+        {"6581_44100_filter", SidConfig::sid_model_t::MOS6581, 44100, true},
+        {"6581_44100_nofilter", SidConfig::sid_model_t::MOS6581, 44100, false},
+        {"8580_44100_filter", SidConfig::sid_model_t::MOS8580, 44100, true},
+        {"6581_48000_filter", SidConfig::sid_model_t::MOS6581, 48000, true},
+        {"6581_96000_filter", SidConfig::sid_model_t::MOS6581, 96000, true}
+    };
+
+    double ElapsedMs(Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    std::string JsonEscaped(const std::string& text)
+    {
+        std::string out;
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+            }
+
+            out += (static_cast<unsigned char>(c) < 0x20) ? ' ' : c;
+        }
+
+        return out;
+    }
+
+    double Percentile(std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+
+        const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5));
+        return sorted.at(index);
+    }
+
+    std::vector<Tune> LoadTunesFromZip(const std::string& zipPath)
+    {
+        std::vector<Tune> tunes;
+        wxFFileInputStream fileStream(zipPath);
+        if (!fileStream.IsOk())
+        {
+            return tunes;
+        }
+
+        wxZipInputStream zipStream(fileStream);
+        std::unique_ptr<wxZipEntry> entry;
+        while (entry.reset(zipStream.GetNextEntry()), entry != nullptr)
+        {
+            if (entry->IsDir())
+            {
+                continue;
+            }
+
+            Tune tune;
+            tune.name = entry->GetName().ToStdString();
+
+            char buffer[4096];
+            while (zipStream.Read(buffer, sizeof(buffer)).LastRead() > 0)
+            {
+                tune.data.insert(tune.data.end(), buffer, buffer + zipStream.LastRead());
+            }
+
+            tunes.emplace_back(std::move(tune));
+        }
+
+        return tunes;
+    }
+
+    void BenchSonglengthsLoad(const std::wstring& songlengthsPath)
+    {
+        // Cold: parse the text database (and write the compiled sidecar), then warm: just map the sidecar.
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(songlengthsPath + L".bin"), ec);
+
+        for (const char* variant : {"text", "compiled"})
+        {
+            Songlengths database;
+            const Clock::time_point start = Clock::now();
+            const bool success = database.TryLoad(songlengthsPath);
+            const double ms = ElapsedMs(start);
+
+            printf("{\"bench\":\"songlengths_load\",\"variant\":\"%s\",\"success\":%s,\"ms\":%.3f}\n", variant, (success) ? "true" : "false", ms);
+        }
+    }
+
+    void BenchScan(const std::vector<Tune>& tunes, const SidDecoder& databaseSource)
+    {
+        const Clock::time_point start = Clock::now();
+
+        TuneInfoScanner scanner;
+        scanner.Start(tunes.size(), [&tunes](size_t index)
+        {
+            const Tune& tune = tunes.at(index);
+            std::unique_ptr<BufferHolder> bufferHolder = std::make_unique<BufferHolder>(tune.data.size());
+            memcpy(bufferHolder->buffer, tune.data.data(), tune.data.size());
+            return bufferHolder;
+        }, databaseSource);
+
+        std::vector<TuneInfoScanner::TuneInfo> infos;
+        while (!scanner.IsDone())
+        {
+            scanner.TakeReady(infos, tunes.size(), std::chrono::milliseconds(100));
+        }
+
+        const double ms = ElapsedMs(start);
+        const size_t validCount = std::count_if(infos.begin(), infos.end(), [](const TuneInfoScanner::TuneInfo& info) { return info.valid; });
+
+        printf("{\"bench\":\"scan\",\"files\":%zu,\"valid\":%zu,\"ms\":%.3f,\"files_per_s\":%.1f}\n", tunes.size(), validCount, ms, (ms > 0.0) ? tunes.size() * 1000.0 / ms : 0.0);
+    }
+
+    void BenchEmulation(const std::vector<Tune>& tunes, const EmulationVariant& variant, int secondsPerTune)
+    {
+        SidConfig sidConfig;
+        sidConfig.frequency = variant.sampleRate;
+        sidConfig.playback = SidConfig::playback_t::STEREO;
+        sidConfig.defaultSidModel = variant.sidModel;
+        sidConfig.forceSidModel = true;
+
+        SidDecoder decoder;
+        if (!decoder.TryInitEmulation(sidConfig, SidDecoder::FilterConfig(variant.filterEnabled, 0.5, 0.5)))
+        {
+            printf("{\"bench\":\"emulation\",\"variant\":\"%s\",\"success\":false}\n", variant.name);
+            return;
+        }
+
+        std::vector<short> buffer(CHUNK_FRAMES * sidConfig.playback);
+        const unsigned long chunksPerTune = static_cast<unsigned long>(static_cast<uint_least64_t>(secondsPerTune) * variant.sampleRate / CHUNK_FRAMES);
+
+        double totalRenderMs = 0.0;
+        uint_least64_t totalAudioFrames = 0;
+
+        for (const Tune& tune : tunes)
+        {
+            if (!decoder.TryLoadSong(tune.data.data(), static_cast<uint_least32_t>(tune.data.size())))
+            {
+                continue;
+            }
+
+            std::vector<double> chunkUs;
+            chunkUs.reserve(chunksPerTune);
+
+            for (unsigned long i = 0; i < chunksPerTune; ++i)
+            {
+                const Clock::time_point start = Clock::now();
+                if (!decoder.TryFillBuffer(buffer.data(), CHUNK_FRAMES))
+                {
+                    break;
+                }
+
+                chunkUs.emplace_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+
+            double renderMs = 0.0;
+            for (const double us : chunkUs)
+            {
+                renderMs += us / 1000.0;
+            }
+
+            const double audioMs = static_cast<double>(chunkUs.size()) * CHUNK_FRAMES * 1000.0 / variant.sampleRate;
+            totalRenderMs += renderMs;
+            totalAudioFrames += static_cast<uint_least64_t>(chunkUs.size()) * CHUNK_FRAMES;
+
+            std::sort(chunkUs.begin(), chunkUs.end());
+            printf("{\"bench\":\"emulation\",\"variant\":\"%s\",\"tune\":\"%s\",\"audio_ms\":%.1f,\"render_ms\":%.3f,\"x_realtime\":%.2f,\"chunk_frames\":%lu,\"chunk_us_p50\":%.2f,\"chunk_us_p90\":%.2f,\"chunk_us_p99\":%.2f,\"chunk_us_max\":%.2f}\n",
+                   variant.name,
+                   JsonEscaped(tune.name).c_str(),
+                   audioMs,
+                   renderMs,
+                   (renderMs > 0.0) ? audioMs / renderMs : 0.0,
+                   CHUNK_FRAMES,
+                   Percentile(chunkUs, 0.5),
+                   Percentile(chunkUs, 0.9),
+                   Percentile(chunkUs, 0.99),
+                   (chunkUs.empty()) ? 0.0 : chunkUs.back());
+
+            decoder.UnloadActiveTune();
+        }
+
+        const double totalAudioMs = totalAudioFrames * 1000.0 / variant.sampleRate;
+        printf("{\"bench\":\"emulation_total\",\"variant\":\"%s\",\"audio_ms\":%.1f,\"render_ms\":%.3f,\"x_realtime\":%.2f}\n", variant.name, totalAudioMs, totalRenderMs, (totalRenderMs > 0.0) ? totalAudioMs / totalRenderMs : 0.0);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    wxInitializer wxInit;
+    if (!wxInit.IsOk())
+    {
+        fprintf(stderr, "Failed to initialize wxWidgets.\n");
+        return EXIT_FAILURE;
+    }
+
+    const std::string songsZipPath = (argc > 1) ? argv[1] : DEFAULT_SONGS_ZIP;
+    const std::wstring songlengthsPath = std::filesystem::path((argc > 2) ? argv[2] : DEFAULT_SONGLENGTHS).wstring();
+    const int secondsPerTune = (argc > 3) ? std::max(1, atoi(argv[3])) : DEFAULT_SECONDS_PER_TUNE;
+
+    const std::vector<Tune> tunes = LoadTunesFromZip(songsZipPath);
+    if (tunes.empty())
+    {
+        fprintf(stderr, "No tunes found in: %s\n", songsZipPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    BenchSonglengthsLoad(songlengthsPath);
+
+    SidDecoder databaseSource;
+    databaseSource.TryInitSidDatabase(songlengthsPath);
+    BenchScan(tunes, databaseSource);
+
+    for (const EmulationVariant& variant : EMULATION_VARIANTS)
+    {
+        BenchEmulation(tunes, variant, secondsPerTune);
+    }
+
+    return EXIT_SUCCESS;
+}
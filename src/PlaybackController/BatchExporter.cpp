@@ -0,0 +1,171 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "BatchExporter.h"
+#include "PlaybackWrappers/Output/WavFileWriter.h"
+#include "../Util/Const.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    constexpr unsigned long RENDER_CHUNK_FRAMES = 4096;
+}
+
+BatchExporter::BatchExporter(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig, const RomUtil::RomPaths& romPaths) :
+    _sidConfig(sidConfig),
+    _filterConfig(filterConfig),
+    _romPaths(romPaths)
+{
+}
+
+BatchExporter::Progress BatchExporter::Run(const std::vector<Job>& jobs, const FileLoader& loader, const SidDecoder& databaseSource, const ProgressCallback& onProgress, unsigned int workerCount)
+{
+    _abortFlag = false;
+
+    if (workerCount == 0)
+    {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workerCount = static_cast<unsigned int>(std::min<size_t>(workerCount, jobs.size()));
+
+    const auto startTime = std::chrono::steady_clock::now();
+    std::atomic_size_t nextJob = 0;
+    std::atomic_uint_least64_t renderedMs = 0;
+
+    Progress progress;
+    progress.jobsTotal = jobs.size();
+    std::mutex progressMutex;
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back([&]()
+        {
+            SidDecoder decoder;
+            decoder.UseSidDatabaseOf(databaseSource);
+            const bool decoderReady = decoder.TryInitEmulation(_sidConfig, _filterConfig);
+            if (decoderReady)
+            {
+                decoder.TrySetRoms(_romPaths.kernal, _romPaths.basic, _romPaths.chargen);
+            }
+
+            std::vector<short> renderBuffer(RENDER_CHUNK_FRAMES * _sidConfig.playback);
+
+            while (!_abortFlag)
+            {
+                const size_t index = nextJob++;
+                if (index >= jobs.size())
+                {
+                    break;
+                }
+
+                const Job& job = jobs.at(index);
+                const bool success = decoderReady && TryRender(decoder, job, loader, renderBuffer, renderedMs);
+
+                std::lock_guard<std::mutex> lock(progressMutex);
+                ++progress.jobsDone;
+                if (!success)
+                {
+                    ++progress.jobsFailed;
+                }
+
+                progress.renderedMs = renderedMs;
+                progress.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+                if (onProgress != nullptr)
+                {
+                    onProgress(job, success, progress);
+                }
+            }
+
+            decoder.UnloadActiveTune();
+        });
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    progress.renderedMs = renderedMs;
+    progress.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    return progress;
+}
+
+void BatchExporter::Abort()
+{
+    _abortFlag = true;
+}
+
+bool BatchExporter::TryRender(SidDecoder& decoder, const Job& job, const FileLoader& loader, std::vector<short>& renderBuffer, std::atomic_uint_least64_t& renderedMs) const
+{
+    {
+        const std::unique_ptr<BufferHolder> bufferHolder = loader(job.fileIndex);
+        if (bufferHolder == nullptr || !decoder.TryLoadSong(bufferHolder->data, bufferHolder->size, job.subsong))
+        {
+            return false;
+        }
+    } // Reminder: the tune is copied by the SidTune so the buffer is not needed anymore.
+
+    WavFileWriter writer;
+    if (!writer.TryOpen(job.outputFilepath, _sidConfig.frequency, _sidConfig.playback))
+    {
+        return false;
+    }
+
+    const auto discardOutput = [&writer, &job]()
+    {
+        writer.TryClose();
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(job.outputFilepath), ec); // Don't leave incomplete files behind.
+        return false;
+    };
+
+    // Stream the subsong in fixed-size chunks
+    const uint_least64_t totalFrames = static_cast<uint_least64_t>(job.durationMs) * _sidConfig.frequency / Const::MILLISECONDS_IN_SECOND;
+    uint_least64_t framesDone = 0;
+    uint_least64_t reportedMs = 0;
+
+    while (framesDone < totalFrames)
+    {
+        if (_abortFlag)
+        {
+            return discardOutput();
+        }
+
+        const unsigned long frames = static_cast<unsigned long>(std::min<uint_least64_t>(RENDER_CHUNK_FRAMES, totalFrames - framesDone));
+        if (!decoder.TryFillBuffer(renderBuffer.data(), frames) || !writer.TryWrite(renderBuffer.data(), frames * _sidConfig.playback))
+        {
+            return discardOutput();
+        }
+
+        framesDone += frames;
+
+        const uint_least64_t doneMs = framesDone * Const::MILLISECONDS_IN_SECOND / _sidConfig.frequency;
+        renderedMs += doneMs - reportedMs;
+        reportedMs = doneMs;
+    }
+
+    return writer.TryClose() || discardOutput();
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/Input/SidDecoder.h"
+#include "Util/RomUtil.h"
+#include "../Util/BufferHolder.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief Renders subsongs straight into WAV files (no audio output involved) in a pool of workers, each one with its own SidDecoder. Memory use is bounded by a small per-worker render buffer.
+class BatchExporter
+{
+public:
+    struct Job
+    {
+        size_t fileIndex = 0; // Passed to the FileLoader.
+        unsigned int subsong = 0;
+        uint_least32_t durationMs = 0;
+        std::wstring outputFilepath;
+    };
+
+    struct Progress
+    {
+        size_t jobsDone = 0;
+        size_t jobsFailed = 0; // Included in the jobsDone.
+        size_t jobsTotal = 0;
+        uint_least64_t renderedMs = 0; // Of audio.
+        uint_least64_t elapsedMs = 0; // Of wall time.
+
+        /// @brief Throughput as a multiple of real-time.
+        double GetSpeedFactor() const
+        {
+            return (elapsedMs == 0) ? 0.0 : static_cast<double>(renderedMs) / elapsedMs;
+        }
+    };
+
+    /// @brief Returns the content of the file at the given index (or nullptr on failure). Called from the worker threads.
+    using FileLoader = std::function<std::unique_ptr<BufferHolder>(size_t fileIndex)>;
+
+    /// @brief Called from the worker threads (serialized) after each finished job.
+    using ProgressCallback = std::function<void(const Job& job, bool success, const Progress& progress)>;
+
+public:
+    BatchExporter() = delete;
+    BatchExporter(BatchExporter&) = delete;
+    BatchExporter(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig, const RomUtil::RomPaths& romPaths);
+
+public:
+    /// @brief Renders all jobs (blocking). Songlengths database of the databaseSource is shared with the workers. Pass 0 workers to use one per hardware thread.
+    Progress Run(const std::vector<Job>& jobs, const FileLoader& loader, const SidDecoder& databaseSource, const ProgressCallback& onProgress, unsigned int workerCount = 0);
+
+    /// @brief Makes the Run return as soon as the current jobs are done. Can be called from any thread.
+    void Abort();
+
+private:
+    bool TryRender(SidDecoder& decoder, const Job& job, const FileLoader& loader, std::vector<short>& renderBuffer, std::atomic_uint_least64_t& renderedMs) const;
+
+private:
+    const SidConfig _sidConfig;
+    const SidDecoder::FilterConfig _filterConfig;
+    const RomUtil::RomPaths _romPaths;
+
+    std::atomic_bool _abortFlag = false;
+};
@@ -0,0 +1,400 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "DurationEstimator.h"
+#include "../Util/Const.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+    constexpr unsigned int SNAPSHOT_INTERVAL_MS = 5;
+    constexpr uint_least32_t ANALYSIS_LIMIT_MS = 12 * 60 * Const::MILLISECONDS_IN_SECOND;
+    constexpr uint_least32_t MIN_DURATION_MS = 1000; // Silence before this is more likely a quiet intro than the end.
+    constexpr unsigned int MAX_WORKERS = 2; // Each one is a full emulation running flat out, on top of the playback (and the upcoming subsongs' pre-renders).
+
+    // Silence detection
+    constexpr unsigned int SILENCE_BLOCK_MS = 100;
+    constexpr int SILENCE_MAX_PEAK_TO_PEAK = 128;
+    constexpr uint_least32_t SILENCE_MIN_MS = 5000;
+
+    // Loop detection
+    constexpr unsigned int STABLE_SNAPSHOTS = 2; // A register state must hold at least this long to count (filters out the states caught in the middle of the player routine's writes).
+    constexpr size_t LOOP_WINDOW_EVENTS = 32;
+    constexpr uint_least32_t LOOP_MIN_MS = 10000;
+    constexpr uint_least32_t LOOP_CONFIRM_MIN_MS = 30000;
+    constexpr uint_least32_t LOOP_TIMING_TOLERANCE_MS = 40;
+
+    constexpr uint_least64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+    constexpr uint_least64_t FNV_PRIME = 0x100000001b3ull;
+
+    // The registers defining the notes (per voice: frequency high byte, control, attack/decay, sustain/release) and the filter routing/mode/volume.
+    // Pulse width and filter cutoff are left out on purpose, their sweeps often run independently of the song's structure.
+    constexpr uint8_t MUSICAL_REGISTERS[] = {1, 4, 5, 6, 8, 11, 12, 13, 15, 18, 19, 20, 23, 24};
+
+    constexpr unsigned int MAX_SID_CHIPS = 3;
+
+    SidConfig ForAnalysis(SidConfig sidConfig)
+    {
+        sidConfig.playback = SidConfig::playback_t::MONO; // Enough for the silence detection, and cheaper.
+        sidConfig.samplingMethod = SidConfig::sampling_method_t::INTERPOLATE;
+        sidConfig.fastSampling = true;
+        return sidConfig;
+    }
+
+    bool IsWithinTolerance(uint_least32_t lagMs, uint_least32_t expectedLagMs)
+    {
+        return std::abs(static_cast<int_least64_t>(lagMs) - static_cast<int_least64_t>(expectedLagMs)) <= LOOP_TIMING_TOLERANCE_MS;
+    }
+
+    /// @brief Turns the sampled register states into a sequence of state changes, and looks for that sequence (with the same timing) repeating itself.
+    class LoopDetector
+    {
+    public:
+        LoopDetector()
+        {
+            for (size_t i = 0; i < LOOP_WINDOW_EVENTS; ++i)
+            {
+                _basePowWindow *= FNV_PRIME;
+            }
+        }
+
+        /// @brief Feeds the register state signature sampled at the given time. Returns true (with the loop point) once the tune is confirmed to repeat itself.
+        bool TryAdd(uint_least64_t signature, uint_least32_t timeMs, uint_least32_t& outLoopPointMs)
+        {
+            if (signature != _pendingSignature || _pendingCount == 0)
+            {
+                _pendingSignature = signature;
+                _pendingSinceMs = timeMs;
+                _pendingCount = 1;
+                return false;
+            }
+
+            if (++_pendingCount != STABLE_SNAPSHOTS)
+            {
+                return false;
+            }
+
+            if (!_events.empty() && _events.back().signature == signature)
+            {
+                return false; // Back to the same state after a transient one.
+            }
+
+            return TryAddEvent({signature, _pendingSinceMs}, outLoopPointMs);
+        }
+
+    private:
+        struct Event
+        {
+            uint_least64_t signature;
+            uint_least32_t timeMs;
+        };
+
+    private:
+        bool TryAddEvent(const Event& event, uint_least32_t& outLoopPointMs)
+        {
+            _events.push_back(event);
+            const size_t last = _events.size() - 1;
+
+            // Rolling hash of the last LOOP_WINDOW_EVENTS events
+            _windowHash = _windowHash * FNV_PRIME + event.signature;
+            if (last >= LOOP_WINDOW_EVENTS)
+            {
+                _windowHash -= _events.at(last - LOOP_WINDOW_EVENTS).signature * _basePowWindow;
+            }
+
+            // Confirm the ongoing candidate...
+            if (_loopLagEvents > 0)
+            {
+                const Event& counterpart = _events.at(last - _loopLagEvents);
+                if (counterpart.signature == event.signature && IsWithinTolerance(event.timeMs - counterpart.timeMs, _loopLagMs))
+                {
+                    const uint_least32_t loopPointMs = _events.at(_loopStart).timeMs;
+                    if (event.timeMs - loopPointMs >= std::max(_loopLagMs, LOOP_CONFIRM_MIN_MS)) // The whole loop repeated (and for long enough to not be just a repeated section).
+                    {
+                        outLoopPointMs = loopPointMs;
+                        return true;
+                    }
+
+                    return false;
+                }
+
+                _loopLagEvents = 0; // Just a repeated section after all.
+            }
+
+            // ...or look for a new one
+            if (last + 1 < LOOP_WINDOW_EVENTS)
+            {
+                return false;
+            }
+
+            const auto [it, inserted] = _windowEnds.try_emplace(_windowHash, last);
+            if (inserted)
+            {
+                return false;
+            }
+
+            const size_t earlierEnd = it->second;
+            const uint_least32_t lagMs = event.timeMs - _events.at(earlierEnd).timeMs;
+            if (lagMs < LOOP_MIN_MS)
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < LOOP_WINDOW_EVENTS; ++i) // Hash collisions & timing.
+            {
+                const Event& earlier = _events.at(earlierEnd - i);
+                const Event& later = _events.at(last - i);
+                if (earlier.signature != later.signature || !IsWithinTolerance(later.timeMs - earlier.timeMs, lagMs))
+                {
+                    return false;
+                }
+            }
+
+            _loopLagEvents = last - earlierEnd;
+            _loopLagMs = lagMs;
+            _loopStart = last + 1 - LOOP_WINDOW_EVENTS;
+            return false;
+        }
+
+    private:
+        uint_least64_t _pendingSignature = 0;
+        uint_least32_t _pendingSinceMs = 0;
+        unsigned int _pendingCount = 0;
+
+        std::vector<Event> _events;
+        uint_least64_t _windowHash = 0;
+        uint_least64_t _basePowWindow = 1;
+        std::unordered_map<uint_least64_t, size_t> _windowEnds; // Window hash -> index of the window's last event (first occurrence only).
+
+        size_t _loopLagEvents = 0; // Non-zero while a candidate is being confirmed.
+        uint_least32_t _loopLagMs = 0;
+        size_t _loopStart = 0; // Index of the first event of the repetition.
+    };
+}
+
+DurationEstimator::DurationEstimator(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig, const RomUtil::RomPaths& romPaths, const FileLoader& loader) :
+    _sidConfig(ForAnalysis(sidConfig)),
+    _filterConfig(filterConfig),
+    _romPaths(romPaths),
+    _loader(loader)
+{
+}
+
+DurationEstimator::~DurationEstimator()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _abortFlag = true;
+    }
+
+    _queueCv.notify_all();
+    for (std::thread& worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void DurationEstimator::Enqueue(const std::vector<Job>& jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const Job& job : jobs)
+        {
+            const auto it = _estimates.find({job.filepath, job.subsong});
+            if (it != _estimates.end())
+            {
+                _finished.push_back({job, it->second});
+            }
+            else
+            {
+                _queue.push_back(job);
+            }
+        }
+
+        if (_workers.empty() && !_queue.empty())
+        {
+            StartWorkers();
+        }
+    }
+
+    _queueCv.notify_all();
+}
+
+void DurationEstimator::ClearQueue()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.clear();
+}
+
+size_t DurationEstimator::TakeFinished(std::vector<Estimate>& out)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const size_t count = _finished.size();
+    std::move(_finished.begin(), _finished.end(), std::back_inserter(out));
+    _finished.clear();
+    return count;
+}
+
+void DurationEstimator::StartWorkers()
+{
+    const unsigned int workerCount = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MAX_WORKERS); // Leave enough room for the playback itself.
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        _workers.emplace_back(&DurationEstimator::RunWorker, this);
+    }
+}
+
+void DurationEstimator::RunWorker()
+{
+    SidDecoder decoder;
+    const bool decoderReady = decoder.TryInitEmulation(_sidConfig, _filterConfig);
+    if (decoderReady)
+    {
+        decoder.TrySetRoms(_romPaths.kernal, _romPaths.basic, _romPaths.chargen);
+    }
+
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queueCv.wait(lock, [this]() { return _abortFlag || !_queue.empty(); });
+            if (_abortFlag)
+            {
+                break;
+            }
+
+            job = std::move(_queue.front());
+            _queue.pop_front();
+
+            const auto it = _estimates.find({job.filepath, job.subsong}); // Duplicates in the playlist.
+            if (it != _estimates.end())
+            {
+                _finished.push_back({std::move(job), it->second});
+                continue;
+            }
+        }
+
+        uint_least32_t durationMs = 0;
+        if (decoderReady)
+        {
+            bool loaded = false;
+
+            {
+                const std::unique_ptr<BufferHolder> bufferHolder = _loader(job.filepath);
+                loaded = bufferHolder != nullptr && decoder.TryLoadSong(bufferHolder->data, bufferHolder->size, job.subsong);
+            } // Reminder: the tune is copied by the SidTune so the buffer is not needed anymore.
+
+            if (loaded)
+            {
+                durationMs = Analyze(decoder);
+            }
+        }
+
+        if (_abortFlag)
+        {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _estimates[{job.filepath, job.subsong}] = durationMs;
+        _finished.push_back({std::move(job), durationMs});
+    }
+
+    decoder.UnloadActiveTune();
+}
+
+uint_least32_t DurationEstimator::Analyze(SidDecoder& decoder) const
+{
+    const unsigned long snapshotFrames = std::max(1ul, static_cast<unsigned long>(_sidConfig.frequency * SNAPSHOT_INTERVAL_MS / Const::MILLISECONDS_IN_SECOND));
+    const unsigned long silenceBlockFrames = _sidConfig.frequency * SILENCE_BLOCK_MS / Const::MILLISECONDS_IN_SECOND;
+    const unsigned int sidCount = std::clamp(decoder.GetCurrentTuneSidChipsRequired(), 1, static_cast<int>(MAX_SID_CHIPS));
+
+    std::vector<short> buffer(snapshotFrames * _sidConfig.playback);
+    uint8_t registers[32];
+    LoopDetector loopDetector;
+
+    uint_least64_t framesDone = 0;
+    unsigned long blockFrames = 0;
+    short blockMin = std::numeric_limits<short>::max();
+    short blockMax = std::numeric_limits<short>::min();
+    uint_least32_t lastSoundMs = 0;
+
+    while (!_abortFlag)
+    {
+        if (!decoder.TryFillBuffer(buffer.data(), snapshotFrames))
+        {
+            return 0;
+        }
+
+        framesDone += snapshotFrames;
+        const uint_least32_t timeMs = static_cast<uint_least32_t>(framesDone * Const::MILLISECONDS_IN_SECOND / _sidConfig.frequency);
+        if (timeMs >= ANALYSIS_LIMIT_MS)
+        {
+            return 0;
+        }
+
+        // Trailing silence
+        const auto [minIt, maxIt] = std::minmax_element(buffer.begin(), buffer.end());
+        blockMin = std::min(blockMin, *minIt);
+        blockMax = std::max(blockMax, *maxIt);
+        blockFrames += snapshotFrames;
+        if (blockFrames >= silenceBlockFrames)
+        {
+            if (blockMax - blockMin > SILENCE_MAX_PEAK_TO_PEAK)
+            {
+                lastSoundMs = timeMs;
+            }
+            else if (lastSoundMs >= MIN_DURATION_MS && timeMs - lastSoundMs >= SILENCE_MIN_MS)
+            {
+                return lastSoundMs;
+            }
+
+            blockFrames = 0;
+            blockMin = std::numeric_limits<short>::max();
+            blockMax = std::numeric_limits<short>::min();
+        }
+
+        // Repeating register pattern
+        uint_least64_t signature = FNV_OFFSET_BASIS;
+        for (unsigned int sidNum = 0; sidNum < sidCount; ++sidNum)
+        {
+            if (decoder.TryGetSidRegisters(sidNum, registers))
+            {
+                for (const uint8_t reg : MUSICAL_REGISTERS)
+                {
+                    signature = (signature ^ registers[reg]) * FNV_PRIME;
+                }
+            }
+        }
+
+        uint_least32_t loopPointMs = 0;
+        if (loopDetector.TryAdd(signature, timeMs, loopPointMs))
+        {
+            return loopPointMs;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/Input/SidDecoder.h"
+#include "Util/RomUtil.h"
+#include "../Util/BufferHolder.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @brief Estimates the durations of (sub)songs unknown to the Songlengths database by emulating them faster than real-time (no audio output involved) in a pool of background workers.
+/// A (sub)song is considered finished where its output fades into lasting silence, or where its SID register writes start repeating an earlier stretch (i.e., the tune looped).
+class DurationEstimator
+{
+public:
+    struct Job
+    {
+        std::wstring filepath;
+        unsigned int subsong = 0;
+    };
+
+    struct Estimate
+    {
+        Job job;
+        uint_least32_t durationMs = 0; // 0 if neither the silence nor a loop was detected within the analysis limit.
+    };
+
+    /// @brief Returns the content of the file (or nullptr on failure). Called from the worker threads.
+    using FileLoader = std::function<std::unique_ptr<BufferHolder>(const std::wstring& filepath)>;
+
+public:
+    DurationEstimator() = delete;
+    DurationEstimator(DurationEstimator&) = delete;
+    DurationEstimator(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig, const RomUtil::RomPaths& romPaths, const FileLoader& loader);
+
+    ~DurationEstimator();
+
+public:
+    /// @brief Queues the jobs (starting the workers if needed). The already estimated ones are finished immediately.
+    void Enqueue(const std::vector<Job>& jobs);
+
+    /// @brief Drops all the queued jobs (the ones in progress still finish).
+    void ClearQueue();
+
+    /// @brief Moves all the finished estimates into the out vector (non-blocking). Returns the number of estimates moved.
+    size_t TakeFinished(std::vector<Estimate>& out);
+
+private:
+    using EstimateKey = std::pair<std::wstring, unsigned int>;
+
+private:
+    void StartWorkers();
+    void RunWorker();
+    uint_least32_t Analyze(SidDecoder& decoder) const;
+
+private:
+    const SidConfig _sidConfig;
+    const SidDecoder::FilterConfig _filterConfig;
+    const RomUtil::RomPaths _romPaths;
+    const FileLoader _loader;
+
+    std::vector<std::thread> _workers;
+    std::atomic_bool _abortFlag = false;
+
+    std::deque<Job> _queue;
+    std::vector<Estimate> _finished;
+    std::map<EstimateKey, uint_least32_t> _estimates; // Kept for the session, so re-added tunes aren't analyzed again.
+    std::condition_variable _queueCv;
+    std::mutex _mutex;
+};
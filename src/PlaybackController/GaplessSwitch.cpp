@@ -0,0 +1,169 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "GaplessSwitch.h"
+#include <algorithm>
+
+void GaplessSwitch::SetCurrent(IBufferWriter& source, int sampleRate, int numChannels, uint_least32_t positionMs)
+{
+    _current = &source;
+    _sampleRate = sampleRate;
+    _numChannels = numChannels;
+    _framesRendered = static_cast<uint_least64_t>(positionMs) * _sampleRate / 1000;
+    _switched = false;
+    _framesSinceSwitch = 0;
+}
+
+void GaplessSwitch::Arm(IBufferWriter& next, uint_least32_t switchAtMs)
+{
+    // Withdraw the armed source first, so the render thread never claims the new one with the old switch point (or vice versa).
+    uint_least64_t state = _armState;
+    while ((state & ARM_STATUS_MASK) == ARM_ARMED && !_armState.compare_exchange_weak(state, state & ~ARM_STATUS_MASK))
+    {
+    }
+
+    _armed = &next;
+    _switchAtMs = switchAtMs;
+    _armState.store(((state & ~ARM_STATUS_MASK) + ARM_GENERATION_STEP) | ARM_ARMED, std::memory_order_release);
+}
+
+bool GaplessSwitch::TryDisarm()
+{
+    if (_switched)
+    {
+        return false;
+    }
+
+    uint_least64_t state = _armState;
+    while ((state & ARM_STATUS_MASK) == ARM_ARMED)
+    {
+        if (_armState.compare_exchange_weak(state, state & ~ARM_STATUS_MASK))
+        {
+            _armed = nullptr;
+            return true;
+        }
+    }
+
+    return (state & ARM_STATUS_MASK) != ARM_CLAIMED; // Claimed just now.
+}
+
+void GaplessSwitch::HardReset()
+{
+    _current = nullptr;
+    _armed = nullptr;
+    _armState = ARM_NONE;
+    _framesRendered = 0;
+    _switchAtMs = 0;
+    _switched = false;
+    _framesSinceSwitch = 0;
+}
+
+bool GaplessSwitch::IsArmed() const
+{
+    return (_armState & ARM_STATUS_MASK) == ARM_ARMED;
+}
+
+bool GaplessSwitch::HasSwitched() const
+{
+    return _switched;
+}
+
+uint_least64_t GaplessSwitch::GetFramesSinceSwitch() const
+{
+    return _framesSinceSwitch;
+}
+
+uint_least32_t GaplessSwitch::GetSwitchAtMs() const
+{
+    return _switchAtMs;
+}
+
+void GaplessSwitch::AcceptSwitch()
+{
+    const uint_least64_t state = _armState;
+    if ((state & ARM_STATUS_MASK) == ARM_CLAIMED)
+    {
+        _armState = state & ~ARM_STATUS_MASK; // Reminder: the render thread never changes a claimed state.
+    }
+
+    _switched = false;
+    _framesSinceSwitch = 0;
+}
+
+bool GaplessSwitch::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
+{
+    if (_current == nullptr)
+    {
+        return false;
+    }
+
+    // Commit to the switch if it's within this chunk.
+    IBufferWriter* current = _current;
+    IBufferWriter* switchTo = nullptr;
+    unsigned long framesToSwitch = 0;
+
+    const uint_least64_t state = _armState.load(std::memory_order_acquire);
+    if ((state & ARM_STATUS_MASK) == ARM_ARMED && !_switched)
+    {
+        IBufferWriter* const armed = _armed;
+        const uint_least64_t switchAtFrame = static_cast<uint_least64_t>(_switchAtMs) * _sampleRate / 1000;
+        const uint_least64_t framesLeftToSwitch = (switchAtFrame > _framesRendered) ? switchAtFrame - _framesRendered : 0;
+
+        uint_least64_t expectedState = state;
+        if (framesLeftToSwitch < framesPerBuffer && _armState.compare_exchange_strong(expectedState, (state & ~ARM_STATUS_MASK) | ARM_CLAIMED))
+        {
+            // From now on the armed source is rendered by this thread (TryDisarm refuses).
+            framesToSwitch = static_cast<unsigned long>(framesLeftToSwitch);
+            switchTo = armed;
+            _current = armed;
+            _framesRendered = 0;
+            _framesSinceSwitch = 0;
+            _switched = true;
+        }
+    }
+
+    short* const out = static_cast<short*>(buffer);
+    unsigned long framesDone = 0;
+
+    if (switchTo != nullptr)
+    {
+        // Render the rest of the current source up to the switch point...
+        if (framesToSwitch > 0 && !current->TryFillBuffer(out, framesToSwitch))
+        {
+            return false;
+        }
+
+        // ...then continue with the armed one.
+        framesDone = framesToSwitch;
+        current = switchTo;
+    }
+
+    const unsigned long framesLeft = framesPerBuffer - framesDone;
+    if (!current->TryFillBuffer(out + static_cast<size_t>(framesDone) * _numChannels, framesLeft))
+    {
+        return false;
+    }
+
+    _framesRendered += framesLeft;
+    if (_switched)
+    {
+        _framesSinceSwitch += framesLeft;
+    }
+
+    return true;
+}
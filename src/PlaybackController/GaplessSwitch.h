@@ -0,0 +1,77 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/IBufferWriter.h"
+#include <atomic>
+#include <cstdint>
+
+/// @brief Sits between the render-ahead buffer and the decoders: renders the current source up to the armed switch point and continues (within the very same chunk) from the armed source, so the next tune follows sample-accurately without the audio stream ever stopping.
+class GaplessSwitch : public IBufferWriter
+{
+public:
+    GaplessSwitch() = default;
+    GaplessSwitch(GaplessSwitch&) = delete;
+
+public:
+    /// @brief Sets the source to be rendered from its given time position on. Must only be called while nobody is rendering (render-ahead halted). Keeps the armed source, if any.
+    void SetCurrent(IBufferWriter& source, int sampleRate, int numChannels, uint_least32_t positionMs);
+
+    /// @brief Arms (or re-arms) the source to continue with once the current one reaches the switchAtMs. The armed source must not be accessed by anyone else until disarmed or promoted.
+    void Arm(IBufferWriter& next, uint_least32_t switchAtMs);
+
+    /// @brief Returns false if the armed source is already being rendered (too late to back out).
+    bool TryDisarm();
+
+    /// @brief Forgets both the current and the armed sources. Must only be called while nobody is rendering.
+    void HardReset();
+
+    bool IsArmed() const;
+    bool HasSwitched() const;
+
+    /// @brief Number of frames rendered from the armed source since the switch.
+    uint_least64_t GetFramesSinceSwitch() const;
+    uint_least32_t GetSwitchAtMs() const;
+
+    /// @brief Acknowledges the switch, the (formerly) armed source is simply the current one from now on.
+    void AcceptSwitch();
+
+    bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override; // Render thread (or the audio callback in the pass-through mode).
+
+private:
+    // Reminder: lock-free since it's rendered in the audio callback in the pass-through mode. The arming calls (Arm, TryDisarm, AcceptSwitch) come from one thread at a time, and the render thread only ever claims the armed source.
+    static constexpr uint_least64_t ARM_NONE = 0;
+    static constexpr uint_least64_t ARM_ARMED = 1;
+    static constexpr uint_least64_t ARM_CLAIMED = 2; // Being rendered since the switch (until accepted).
+    static constexpr uint_least64_t ARM_STATUS_MASK = 3;
+    static constexpr uint_least64_t ARM_GENERATION_STEP = 4; // Each arming is a new generation, so a claim can't succeed on a re-armed source with a stale switch point.
+
+    std::atomic_uint_least64_t _armState = ARM_NONE; // Generation and status.
+    std::atomic<IBufferWriter*> _armed = nullptr;
+    std::atomic_uint_least32_t _switchAtMs = 0;
+
+    // Render thread only (or while nobody is rendering)
+    IBufferWriter* _current = nullptr;
+    int _sampleRate = 0;
+    int _numChannels = 0;
+    uint_least64_t _framesRendered = 0; // Position of the current source, in frames.
+
+    std::atomic_bool _switched = false;
+    std::atomic_uint_least64_t _framesSinceSwitch = 0;
+};
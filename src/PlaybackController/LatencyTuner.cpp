@@ -0,0 +1,214 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "LatencyTuner.h"
+#include "../Util/HelpersBinaryFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    constexpr const char PROFILES_MAGIC[8] = {'S', 'P', 'W', 'X', 'L', 'A', 'T', '\0'};
+    constexpr uint_least32_t PROFILES_VERSION = 2;
+    constexpr uint_least32_t MAX_KEY_LENGTH = 1u << 12; // Sanity limit while reading.
+
+    constexpr unsigned long MIN_FRAMES_PER_BUFFER = 64; // Level 0, each next level doubles it.
+    constexpr uint_least8_t MAX_LEVEL = 6;
+    constexpr double HOST_BUFFERS = 2.0; // Suggested latency in buffers (double buffering).
+
+    constexpr double MIN_SESSION_SECONDS = 20.0; // Shorter dropout-free sessions tell nothing.
+    constexpr double OVERLOAD_FACTOR = 0.75; // Of the buffer period spent rendering (high percentile), dropouts are imminent beyond it.
+    constexpr double RELAXED_FACTOR = 0.4; // Smaller buffers are only tried while below it.
+    constexpr uint_least8_t STABLE_SESSIONS_TO_DESCEND = 3;
+    constexpr uint_least8_t STABLE_SESSIONS_TO_FORGIVE = 10; // Conditions change (e.g., drivers, background load), so the unstable level is retried eventually.
+
+    // Trouble score: a session with dropouts backs off right away, an overloaded one only if it repeats.
+    constexpr uint_least8_t DROPOUTS_SCORE = 2;
+    constexpr uint_least8_t OVERLOAD_SCORE = 1;
+    constexpr uint_least8_t TROUBLE_SCORE_TO_BACK_OFF = 2;
+
+    unsigned long GetFramesPerBuffer(uint_least8_t level)
+    {
+        return MIN_FRAMES_PER_BUFFER << level;
+    }
+
+    using Helpers::BinaryFile::Write;
+    using Helpers::BinaryFile::WriteString;
+    using Helpers::BinaryFile::TryRead;
+    using Helpers::BinaryFile::TryReadString;
+    using Helpers::BinaryFile::TrySaveReplacing;
+}
+
+std::string LatencyTuner::MakeProfileKey(const std::string& deviceIdentity, int sidChips)
+{
+    return deviceIdentity + " #" + std::to_string(sidChips);
+}
+
+bool LatencyTuner::TryLoad(const std::wstring& filepath)
+{
+    _profiles.clear();
+    _dirty = false;
+
+    std::ifstream file(std::filesystem::path(filepath), std::ios::binary);
+    if (!file.good())
+    {
+        return false;
+    }
+
+    char magic[sizeof(PROFILES_MAGIC)]{};
+    uint_least32_t version = 0;
+    uint_least32_t profileCount = 0;
+
+    file.read(magic, sizeof(magic));
+    const bool validHeader = file.good() && memcmp(magic, PROFILES_MAGIC, sizeof(PROFILES_MAGIC)) == 0 &&
+        TryRead(file, version) && version == PROFILES_VERSION &&
+        TryRead(file, profileCount);
+
+    if (!validHeader)
+    {
+        _dirty = true; // Overwrite it upon save.
+        return false;
+    }
+
+    for (uint_least32_t i = 0; i < profileCount; ++i)
+    {
+        std::string key;
+        Profile profile;
+
+        const bool success = TryReadString(file, key, MAX_KEY_LENGTH) &&
+            TryRead(file, profile.level) &&
+            TryRead(file, profile.unstableLevel) &&
+            TryRead(file, profile.stableSessions) &&
+            TryRead(file, profile.troubleScore) &&
+            TryRead(file, profile.forgivingSessions) &&
+            profile.level <= MAX_LEVEL && profile.unstableLevel <= MAX_LEVEL + 1;
+
+        if (!success)
+        {
+            _profiles.clear(); // Corrupted.
+            _dirty = true;
+            return false;
+        }
+
+        _profiles.emplace(std::move(key), profile);
+    }
+
+    return true;
+}
+
+bool LatencyTuner::TrySave(const std::wstring& filepath) const
+{
+    if (!_dirty)
+    {
+        return true;
+    }
+
+    const bool success = TrySaveReplacing(std::filesystem::path(filepath), [this](std::ostream& file)
+    {
+        file.write(PROFILES_MAGIC, sizeof(PROFILES_MAGIC));
+        Write(file, PROFILES_VERSION);
+        Write(file, static_cast<uint_least32_t>(_profiles.size()));
+
+        for (const auto& [key, profile] : _profiles)
+        {
+            WriteString(file, key);
+            Write(file, profile.level);
+            Write(file, profile.unstableLevel);
+            Write(file, profile.stableSessions);
+            Write(file, profile.troubleScore);
+            Write(file, profile.forgivingSessions);
+        }
+    });
+
+    _dirty = !success;
+    return success;
+}
+
+LatencyTuner::Setting LatencyTuner::GetSetting(const std::string& profileKey, double sampleRate, double startLatency)
+{
+    auto it = _profiles.find(profileKey);
+    if (it == _profiles.end())
+    {
+        Profile profile;
+        while (profile.level < MAX_LEVEL && GetFramesPerBuffer(profile.level) * HOST_BUFFERS / sampleRate < startLatency)
+        {
+            ++profile.level;
+        }
+
+        it = _profiles.emplace(profileKey, profile).first; // Reminder: not worth saving until anything is learned.
+    }
+
+    const unsigned long framesPerBuffer = GetFramesPerBuffer(it->second.level);
+    return {framesPerBuffer, framesPerBuffer * HOST_BUFFERS / sampleRate};
+}
+
+void LatencyTuner::Learn(const std::string& profileKey, const PortAudioOutput::OutputStats& session)
+{
+    const auto it = _profiles.find(profileKey);
+    if (it == _profiles.end())
+    {
+        return;
+    }
+
+    Profile& profile = it->second;
+    const bool overloaded = session.highLoad > OVERLOAD_FACTOR;
+    if (session.underruns > 0 || overloaded)
+    {
+        profile.troubleScore = std::min<uint_least8_t>(profile.troubleScore + ((session.underruns > 0) ? DROPOUTS_SCORE : OVERLOAD_SCORE), TROUBLE_SCORE_TO_BACK_OFF);
+        profile.stableSessions = 0;
+        _dirty = true;
+
+        if (profile.troubleScore >= TROUBLE_SCORE_TO_BACK_OFF)
+        {
+            // Back off, and don't come back to this level until forgiven.
+            profile.unstableLevel = std::max<uint_least8_t>(profile.unstableLevel, profile.level + 1);
+            profile.level = std::min<uint_least8_t>(profile.level + 1, MAX_LEVEL);
+            profile.troubleScore = 0;
+            profile.forgivingSessions = 0;
+        }
+
+        return;
+    }
+
+    if (session.playedSeconds < MIN_SESSION_SECONDS)
+    {
+        return;
+    }
+
+    profile.troubleScore = (profile.troubleScore > 0) ? profile.troubleScore - 1 : 0; // Sporadic overloads don't add up.
+    profile.stableSessions = std::min<uint_least8_t>(profile.stableSessions + 1, STABLE_SESSIONS_TO_DESCEND);
+    profile.forgivingSessions = std::min<uint_least8_t>(profile.forgivingSessions + 1, STABLE_SESSIONS_TO_FORGIVE);
+
+    if (profile.forgivingSessions >= STABLE_SESSIONS_TO_FORGIVE && profile.unstableLevel > 0)
+    {
+        --profile.unstableLevel;
+        profile.forgivingSessions = 0;
+    }
+
+    const bool relaxed = session.highLoad < RELAXED_FACTOR;
+    if (profile.stableSessions >= STABLE_SESSIONS_TO_DESCEND && profile.level > profile.unstableLevel && relaxed)
+    {
+        --profile.level; // Try the smaller buffer.
+        profile.stableSessions = 0;
+        profile.troubleScore = 0;
+    }
+
+    _dirty = true;
+}
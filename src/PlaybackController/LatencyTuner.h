@@ -0,0 +1,69 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/Output/PortAudioOutput.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/// @brief Learns the smallest stable playback buffer per audio device & SID chip count (from the dropouts and the rendering load of the finished playback sessions) and persists it on disk.
+class LatencyTuner
+{
+public:
+    struct Setting
+    {
+        unsigned long framesPerBuffer;
+        double suggestedLatency; // In seconds.
+    };
+
+public:
+    LatencyTuner() = default;
+    LatencyTuner(LatencyTuner&) = delete;
+
+public:
+    static std::string MakeProfileKey(const std::string& deviceIdentity, int sidChips);
+
+    bool TryLoad(const std::wstring& filepath);
+
+    /// @brief Saves the profiles file (if anything was learned since loading).
+    bool TrySave(const std::wstring& filepath) const;
+
+    /// @brief Returns the buffer setting to play with. Profiles not learned yet start from the one closest to the startLatency (in seconds).
+    Setting GetSetting(const std::string& profileKey, double sampleRate, double startLatency);
+
+    /// @brief Adjusts the profile (see GetSetting) according to the playback session played with its setting.
+    /// The session's dropouts and highLoad must include whatever renders for the audio callback (e.g., the render-ahead buffer's underruns and its producer load), as the callback alone may only be copying.
+    void Learn(const std::string& profileKey, const PortAudioOutput::OutputStats& session);
+
+private:
+    struct Profile
+    {
+        uint_least8_t level = 0; // Index of the buffer size.
+        uint_least8_t unstableLevel = 0; // Highest level which had to be backed off from, plus one (0 if none). Forgiven one level at a time after enough stable sessions.
+        uint_least8_t stableSessions = 0; // Since the last level change.
+        uint_least8_t troubleScore = 0; // Evidence of dropouts or overload at the current level (decays with the stable sessions).
+        uint_least8_t forgivingSessions = 0; // Stable sessions since the unstableLevel last changed.
+    };
+
+private:
+    std::map<std::string, Profile> _profiles;
+    mutable bool _dirty = false;
+};
@@ -0,0 +1,183 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "ParallelPreRender.h"
+#include <algorithm>
+#include <thread>
+
+// Worker inner struct ----------------------------------------
+
+ParallelPreRender::Worker::~Worker()
+{
+    if (startThread.joinable())
+    {
+        abortStartFlag = true;
+        startThread.join(); // Reminder: the preRender (if started) is stopped by its own destructor.
+    }
+}
+
+bool ParallelPreRender::Worker::IsSameJob(const std::wstring& aFilepath, unsigned int aSubsong, int aDurationMs) const
+{
+    return subsong == aSubsong && durationMs == aDurationMs && filepath == aFilepath;
+}
+
+// ParallelPreRender main class -------------------------------
+
+void ParallelPreRender::SetEmulationConfig(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig)
+{
+    Clear();
+    _sidConfig = sidConfig;
+    _filterConfig = std::make_unique<SidDecoder::FilterConfig>(filterConfig);
+}
+
+void ParallelPreRender::SetRoms(const std::wstring& pathKernal, const std::wstring& pathBasic, const std::wstring& pathChargen)
+{
+    Clear();
+    _pathKernal = pathKernal;
+    _pathBasic = pathBasic;
+    _pathChargen = pathChargen;
+}
+
+void ParallelPreRender::SetMaxWorkers(unsigned int maxWorkers)
+{
+    _maxWorkers = maxWorkers;
+    if (_workers.size() > GetEffectiveWorkerCount())
+    {
+        _workers.resize(GetEffectiveWorkerCount()); // Lowest priority ones are at the end.
+    }
+}
+
+void ParallelPreRender::Enqueue(const std::vector<Job>& jobs)
+{
+    const size_t capacity = std::min(jobs.size(), GetEffectiveWorkerCount());
+
+    // Keep the renders that are still relevant, stop all others (before starting new ones, to free the cores).
+    std::vector<std::unique_ptr<Worker>> retained(capacity);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const Job& job = jobs.at(i);
+        const auto it = std::find_if(_workers.begin(), _workers.end(), [&job](const std::unique_ptr<Worker>& worker)
+        {
+            return worker != nullptr && worker->IsSameJob(job.filepath, job.subsong, job.durationMs);
+        });
+
+        if (it != _workers.end())
+        {
+            retained.at(i) = std::move(*it);
+        }
+    }
+
+    _workers.clear();
+
+    // Start the missing ones
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        if (retained.at(i) == nullptr)
+        {
+            retained.at(i) = StartWorker(jobs.at(i));
+        }
+    }
+
+    retained.erase(std::remove(retained.begin(), retained.end(), nullptr), retained.end());
+    _workers = std::move(retained);
+}
+
+bool ParallelPreRender::TryTake(const std::wstring& filepath, unsigned int subsong, int durationMs, PreRender& target, std::unique_ptr<SidDecoder>& outDecoder)
+{
+    const auto it = std::find_if(_workers.begin(), _workers.end(), [&](const std::unique_ptr<Worker>& worker)
+    {
+        return worker->IsSameJob(filepath, subsong, durationMs);
+    });
+
+    if (it == _workers.end())
+    {
+        return false;
+    }
+
+    Worker& worker = **it;
+    if (worker.startThread.joinable())
+    {
+        worker.startThread.join(); // Still loading the file at worst, which is cheaper than starting over.
+    }
+
+    bool success = false;
+    if (worker.startedFlag)
+    {
+        success = target.TryAdoptCompleted(worker.preRender) || target.TryAdoptRunning(worker.preRender, *worker.decoder);
+        if (success)
+        {
+            outDecoder = std::move(worker.decoder); // Reminder: only after the target has taken over (stopping whatever it was rendering from the previous outDecoder).
+        }
+    }
+
+    _workers.erase(it); // Either taken or failed (in which case the caller renders it on its own anyway).
+
+    return success;
+}
+
+void ParallelPreRender::Clear()
+{
+    _workers.clear();
+}
+
+size_t ParallelPreRender::GetEffectiveWorkerCount() const
+{
+    // Leave one core for the currently playing subsong's pre-render.
+    const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    const unsigned int spareCores = (hardwareThreads > 1) ? hardwareThreads - 1 : 1;
+    return std::min(_maxWorkers, spareCores);
+}
+
+std::unique_ptr<ParallelPreRender::Worker> ParallelPreRender::StartWorker(const Job& job) const
+{
+    if (_filterConfig == nullptr || job.loader == nullptr || job.durationMs <= 0)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<Worker> worker = std::make_unique<Worker>(job);
+
+    // Reminder: the thread works with its own copies of the settings, a change of those discards the worker (joining the thread) anyway.
+    worker->startThread = std::thread([worker = worker.get(), loader = job.loader, sidConfig = _sidConfig, filterConfig = *_filterConfig, pathKernal = _pathKernal, pathBasic = _pathBasic, pathChargen = _pathChargen]()
+    {
+        worker->bufferHolder = loader();
+        if (worker->bufferHolder == nullptr || worker->abortStartFlag)
+        {
+            return;
+        }
+
+        worker->decoder = std::make_unique<SidDecoder>(); // Own sidplayfp & ReSIDfpBuilder instance per worker.
+
+        if (!worker->decoder->TryInitEmulation(sidConfig, filterConfig))
+        {
+            return;
+        }
+
+        worker->decoder->TrySetRoms(pathKernal, pathBasic, pathChargen);
+
+        if (worker->abortStartFlag || !worker->decoder->TryLoadSong(worker->bufferHolder->data, worker->bufferHolder->size, worker->subsong))
+        {
+            return;
+        }
+
+        worker->preRender.DoPreRender(*worker->decoder, sidConfig.frequency, sidConfig.playback, worker->durationMs);
+        worker->startedFlag = true;
+    });
+
+    return worker;
+}
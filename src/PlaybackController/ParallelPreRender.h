@@ -0,0 +1,121 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PreRender.h"
+#include "PlaybackWrappers/Input/SidDecoder.h"
+#include "../Util/BufferHolder.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief Pre-renders the upcoming subsongs in parallel (each one on its own emulation engine and thread) so their playback can start from an already (partly or fully) rendered buffer.
+class ParallelPreRender
+{
+public:
+    /// @brief Reads the tune file's content (nullptr if it fails). Called from the worker's own thread.
+    using FileLoader = std::function<std::unique_ptr<BufferHolder>()>;
+
+    struct Job
+    {
+        Job() = delete;
+        Job(const std::wstring& aFilepath, const FileLoader& aLoader, unsigned int aSubsong, int aDurationMs) :
+            filepath(aFilepath),
+            loader(aLoader),
+            subsong(aSubsong),
+            durationMs(aDurationMs)
+        {
+        }
+
+        std::wstring filepath;
+        FileLoader loader; // Only called if the job isn't being rendered already.
+        unsigned int subsong;
+        int durationMs;
+    };
+
+private:
+    struct Worker
+    {
+        Worker() = delete;
+        explicit Worker(const Job& job) :
+            filepath(job.filepath),
+            subsong(job.subsong),
+            durationMs(job.durationMs)
+        {
+        }
+
+        ~Worker();
+
+        bool IsSameJob(const std::wstring& aFilepath, unsigned int aSubsong, int aDurationMs) const;
+
+        const std::wstring filepath;
+        const unsigned int subsong;
+        const int durationMs;
+        std::unique_ptr<const BufferHolder> bufferHolder;
+        std::unique_ptr<SidDecoder> decoder;
+        PreRender preRender; // Reminder: must be declared after the decoder (i.e., destroyed first) since it renders from it.
+
+        std::thread startThread; // Loads the file and starts the preRender, the members above are its own until the startedFlag.
+        std::atomic_bool startedFlag = false;
+        std::atomic_bool abortStartFlag = false;
+    };
+
+public:
+    ParallelPreRender() = default;
+    ParallelPreRender(ParallelPreRender&) = delete;
+
+public:
+    /// @brief Sets the emulation parameters used by the worker engines. Discards all existing renders.
+    void SetEmulationConfig(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig);
+
+    /// @brief Sets the ROMs used by the worker engines (paths should be absolute). Discards all existing renders.
+    void SetRoms(const std::wstring& pathKernal, const std::wstring& pathBasic, const std::wstring& pathChargen);
+
+    /// @brief Sets the maximum number of upcoming subsongs to pre-render. The effective number is further limited by the available CPU cores. Pass 0 to disable.
+    void SetMaxWorkers(unsigned int maxWorkers);
+
+    /// @brief Starts pre-rendering the upcoming subsongs (in order of priority). Renders of the same subsongs which are already running are kept, all others are discarded.
+    /// The files of the new ones are loaded in the background (see FileLoader).
+    void Enqueue(const std::vector<Job>& jobs);
+
+    /// @brief Moves the render of a given subsong into the target. If it's still in progress, the target continues rendering it from the worker's decoder, which is then handed over via outDecoder (and must outlive that rendering).
+    /// Returns false (and discards the failed render of that subsong, if any) if not available.
+    bool TryTake(const std::wstring& filepath, unsigned int subsong, int durationMs, PreRender& target, std::unique_ptr<SidDecoder>& outDecoder);
+
+    void Clear();
+
+private:
+    size_t GetEffectiveWorkerCount() const;
+    std::unique_ptr<Worker> StartWorker(const Job& job) const;
+
+private:
+    SidConfig _sidConfig;
+    std::unique_ptr<SidDecoder::FilterConfig> _filterConfig;
+
+    std::wstring _pathKernal;
+    std::wstring _pathBasic;
+    std::wstring _pathChargen;
+
+    unsigned int _maxWorkers = 0;
+    std::vector<std::unique_ptr<Worker>> _workers;
+};
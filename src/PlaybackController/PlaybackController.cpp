@@ -19,7 +19,9 @@
 #include "PlaybackController.h"
 #include "../Util/HelpersGeneral.h"
 #include <sidplayfp/SidTuneInfo.h>
+#include <algorithm>
 #include <filesystem>
+#include <limits>
 #include <iostream>
 #include <stdexcept>
 
@@ -60,6 +62,26 @@ PlaybackController::State PlaybackController::StateHolder::Get() const
 
 namespace Static
 {
+    static constexpr uint_least32_t SEEK_CHECKPOINT_INTERVAL_MS = 15000;
+    static constexpr unsigned int SEEK_CHECKPOINTS_MAX = 20;
+    static constexpr unsigned int VOICES_PER_SID = 3;
+    static constexpr int CLOCK_READ_ATTEMPTS = 50; // Then settle for a possibly torn read (off by a playback buffer at worst).
+
+    static PreRender::AbortableRendererSeeker GetAbortableSeeker(SidDecoder& decoder)
+    {
+        return [&decoder](uint_least32_t timeMs, const IBufferWriter::SeekStatusCallback& callback)
+        {
+            uint_least32_t reachedTimeMs = 0;
+            decoder.SeekTo(timeMs, [&reachedTimeMs, &callback](uint_least32_t cTimeMs, bool done) -> bool
+            {
+                reachedTimeMs = cTimeMs;
+                return callback(cTimeMs, done);
+            });
+
+            return reachedTimeMs;
+        };
+    }
+
     static std::string GetSidName(const SidTuneInfo& tuneInfo, int sidNum)
     {
         switch (tuneInfo.sidModel(sidNum))
@@ -97,6 +119,8 @@ PlaybackController::~PlaybackController()
     {
         _seekOperation.seekThread.join();
     }
+
+    JoinArmThread();
 }
 
 bool PlaybackController::TryInit(const SyncedPlaybackConfig& config)
@@ -107,6 +131,10 @@ bool PlaybackController::TryInit(const SyncedPlaybackConfig& config)
     }
 
     _sidDecoder = std::make_unique<SidDecoder>();
+    _renderAhead = std::make_unique<RenderAheadBuffer>();
+    _gaplessSwitch = std::make_unique<GaplessSwitch>();
+    _speedResampler = std::make_unique<SpeedResampler>();
+    _timeStretcher = std::make_unique<TimeStretcher>();
 
     const bool sidInitSuccess = TryResetSidDecoder(config);
     const bool audioInitSuccess = TryResetAudioOutput(config.audioConfig, false);
@@ -148,6 +176,7 @@ PlaybackController::SwitchAudioDeviceResult PlaybackController::TrySwitchPlaybac
     if (needResetSidDecoder)
     {
         Stop();
+        StashPreRender();
         _preRender = nullptr; // SID params changed, any pre-rendered content is no longer valid.
 
         success = TryResetSidDecoder(newConfig);
@@ -159,8 +188,6 @@ PlaybackController::SwitchAudioDeviceResult PlaybackController::TrySwitchPlaybac
         Stop();
         success = TryResetAudioOutput(newConfig.audioConfig, enablePreRender);
         result = (success) ? result : SwitchAudioDeviceResult::Failure;
-
-        TrySetPlaybackSpeed(_playbackSpeedFactor);
     }
 
     EmitSignal(SignalsPlaybackController::SIGNAL_AUDIO_DEVICE_CHANGED, static_cast<int>(success));
@@ -176,7 +203,32 @@ RomUtil::RomStatus PlaybackController::TrySetRoms(const std::wstring& pathKernal
         return preCheckStatus;
     }
 
+    // Reminder: the decoders must not be rendering (by the render-ahead, pre-render or arm threads) while their ROMs are replaced.
+    if (_state != State::Stopped && _state != State::Undefined)
+    {
+        Stop();
+    }
+
     _loadedRoms = _sidDecoder->TrySetRoms(pathKernal, pathBasic, pathChargen);
+    _upcomingPreRender.SetRoms(pathKernal, pathBasic, pathChargen);
+    _preRenderCache.Clear();
+    _preRenderKey = nullptr; // Rendered with the old ROMs.
+    for (std::unique_ptr<SidDecoder>& stemDecoder : _stemSidDecoders)
+    {
+        stemDecoder->TrySetRoms(pathKernal, pathBasic, pathChargen);
+    }
+
+    if (_seekSidDecoder != nullptr)
+    {
+        _seekSidDecoder->TrySetRoms(pathKernal, pathBasic, pathChargen);
+    }
+
+    JoinArmThread(); // Reminder: before updating the ROM paths, the arm thread reads them.
+    _romPathKernal = pathKernal;
+    _romPathBasic = pathBasic;
+    _romPathChargen = pathChargen;
+    _armedSidDecoder = nullptr; // Will be re-created with the new ROMs.
+
     return _loadedRoms;
 }
 
@@ -184,7 +236,7 @@ bool PlaybackController::TryPlayFromBuffer(const std::wstring& filepathForUid, s
 {
     PrepareTryPlay();
     _activeTuneHolder = std::make_unique<TuneHolder>(filepathForUid, loadedBufferToAdopt);
-    const bool success = _sidDecoder->TryLoadSong(_activeTuneHolder->bufferHolder->buffer, _activeTuneHolder->bufferHolder->size, subsong);
+    const bool success = _sidDecoder->TryLoadSong(_activeTuneHolder->bufferHolder->data, _activeTuneHolder->bufferHolder->size, subsong);
     return FinalizeTryPlay(success, preRenderDurationMs);
 }
 
@@ -203,6 +255,131 @@ bool PlaybackController::TryPlaySubsong(unsigned int subsong, int preRenderDurat
     return false;
 }
 
+bool PlaybackController::TryArmNext(const std::wstring& filepathForUid, std::unique_ptr<BufferHolder>& loadedBufferToAdopt, unsigned int subsong, uint_least32_t switchAtMs)
+{
+    if (_state == State::Undefined || _state == State::Stopped || _preRender != nullptr || _activeTuneHolder == nullptr)
+    {
+        return false;
+    }
+
+    JoinArmThread();
+    if (!_gaplessSwitch->TryDisarm())
+    {
+        return false; // The previously armed one is already playing.
+    }
+
+    const bool needsInit = _armedSidDecoder == nullptr;
+    if (needsInit)
+    {
+        _armedSidDecoder = std::make_unique<SidDecoder>();
+    }
+
+    _armedSidDecoder->UseSidDatabaseOf(*_sidDecoder);
+    _armedTuneHolder = std::make_unique<TuneHolder>(filepathForUid, loadedBufferToAdopt);
+
+    // Reminder: the active decoder is being rendered in another thread, so take the copies of its config here rather than in the arm thread.
+    const SidConfig sidConfig = _sidDecoder->GetSidConfig();
+    const FilterConfig filterConfig = _sidDecoder->GetFilterConfig();
+    const SidDecoder::SidVoicesEnabledStatus voicesEnabledStatus = _sidDecoder->GetSidVoicesEnabledStatus();
+
+    _armThread = std::thread([this, needsInit, sidConfig, filterConfig, voicesEnabledStatus, subsong, switchAtMs]()
+    {
+        SidDecoder& decoder = *_armedSidDecoder;
+        if (needsInit)
+        {
+            if (!decoder.TryInitEmulation(sidConfig, filterConfig))
+            {
+                _armedSidDecoder = nullptr; // Try again from scratch next time.
+                return;
+            }
+
+            decoder.TrySetRoms(_romPathKernal, _romPathBasic, _romPathChargen);
+        }
+
+        if (!decoder.TryLoadSong(_armedTuneHolder->bufferHolder->data, _armedTuneHolder->bufferHolder->size, subsong))
+        {
+            return;
+        }
+
+        decoder.SetSeekCheckpoints(Static::SEEK_CHECKPOINT_INTERVAL_MS, Static::SEEK_CHECKPOINTS_MAX);
+
+        // Carry over the toggled voices.
+        for (unsigned int sidNum = 0; sidNum < voicesEnabledStatus.size(); ++sidNum)
+        {
+            for (unsigned int voice = 0; voice < voicesEnabledStatus[sidNum].size(); ++voice)
+            {
+                decoder.ToggleVoice(sidNum, voice, voicesEnabledStatus[sidNum][voice]);
+            }
+        }
+
+        _gaplessSwitch->Arm(decoder, switchAtMs);
+    });
+
+    return true;
+}
+
+void PlaybackController::DisarmNext()
+{
+    JoinArmThread();
+    _gaplessSwitch->TryDisarm();
+}
+
+bool PlaybackController::HasSwitchedToArmedTune() const
+{
+    return _gaplessSwitch->HasSwitched();
+}
+
+bool PlaybackController::TryPromoteArmedTune()
+{
+    if (!_gaplessSwitch->HasSwitched() || _renderAhead->GetBufferedFrames() > _gaplessSwitch->GetFramesSinceSwitch())
+    {
+        return false; // Nothing to promote or the tail of the active one is still buffered.
+    }
+
+    JoinArmThread(); // Already done, the arming is what triggered the switch.
+    _gaplessSwitch->AcceptSwitch();
+
+    // The armed decoder is already being rendered, so it only changes its role here.
+    std::swap(_sidDecoder, _armedSidDecoder);
+    _activeTuneHolder = std::move(_armedTuneHolder);
+    _armedSidDecoder->UnloadActiveTune(); // No longer rendered.
+
+    return true;
+}
+
+void PlaybackController::PreRenderUpcoming(std::vector<UpcomingPreRenderJob>& jobs)
+{
+    // Upcoming subsongs are rendered whole (never windowed), so skip the ones which wouldn't fit within the memory limit. Also the already cached ones (before their files get loaded at all).
+    const int windowMs = GetPreRenderWindowMs();
+    const uint_least64_t configHash = PreRenderCache::HashConfig(_sidDecoder->GetSidConfig(), _sidDecoder->GetFilterConfig());
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [this, windowMs, configHash](const UpcomingPreRenderJob& job)
+    {
+        return (windowMs > 0 && job.durationMs > windowMs) || _preRenderCache.Contains(job.filepath, job.subsong, job.durationMs, configHash);
+    }), jobs.end());
+
+    _upcomingPreRender.Enqueue(jobs);
+}
+
+void PlaybackController::SetUpcomingPreRenderLimit(unsigned int maxSubsongs)
+{
+    _upcomingPreRender.SetMaxWorkers(maxSubsongs);
+}
+
+void PlaybackController::SetPreRenderMemoryLimit(unsigned int megabytes)
+{
+    _preRenderMemoryLimitMb = megabytes;
+}
+
+void PlaybackController::SetPreRenderVoiceStems(bool enable)
+{
+    _preRenderVoiceStems = enable;
+}
+
+void PlaybackController::SetPreRenderCacheLimit(unsigned int megabytes)
+{
+    _preRenderCache.SetBudget(static_cast<size_t>(megabytes) * 1024 * 1024);
+}
+
 void PlaybackController::Pause()
 {
     if (_state == State::Playing)
@@ -224,6 +401,11 @@ void PlaybackController::Resume()
 {
     if (_state == State::Paused)
     {
+        if (_preRender == nullptr && !_renderAhead->IsRunning())
+        {
+            StartRenderAhead(); // Was halted by seeking.
+        }
+
         _portAudioOutput->TryStartStream();
         _state = State::Playing;
     }
@@ -268,11 +450,14 @@ void PlaybackController::Stop()
                 _preRender->Stop();
             }
 
+            _renderAhead->Halt();
             _sidDecoder->Stop();
         }
 
         _state = State::Stopped;
     }
+
+    DropArmedTune();
 }
 
 void PlaybackController::SeekTo(uint_least32_t targetTimeMs)
@@ -281,6 +466,11 @@ void PlaybackController::SeekTo(uint_least32_t targetTimeMs)
     {
         throw std::runtime_error("SeekTo: not possible from current state!");
     }
+    else if (_gaplessSwitch->HasSwitched())
+    {
+        Warn("SeekTo called while switching over to the armed tune, ignored.");
+        return;
+    }
     else if (_state == State::Seeking)
     {
         PlaybackController::State restoreState = _seekOperation.resumeToState;
@@ -301,6 +491,14 @@ void PlaybackController::SeekTo(uint_least32_t targetTimeMs)
     _seekOperation.resumeToState = _state.Get();
     _seekOperation.safeCtimeMs = 0;
 
+    if (_preRender == nullptr)
+    {
+        _renderAhead->Halt(); // Its thread must not render while the decoder is seeking, and its buffered content is obsolete anyway.
+    }
+
+    _speedResampler->Reset();
+    _timeStretcher->Reset();
+
     // Start seeking in a new thread
     _state = State::Seeking;
     _seekOperation.seekThread = std::thread([this, targetTimeMs]
@@ -356,15 +554,55 @@ uint_least32_t PlaybackController::GetTime() const
     {
         return _seekOperation.safeCtimeMs;
     }
-    else
+
+    // Compensate for the audio which is already handed out to the device but not audible yet (as timestamped by the audio callback).
+    for (int attempt = 1; ; ++attempt)
     {
-        if (_preRender != nullptr)
+        const uint_least32_t clockSequence = _portAudioOutput->GetClockSequence();
+        const uint_least32_t handedOutTimeMs = GetHandedOutTime();
+
+        uint_least32_t lagClockSequence = 0;
+        const double lagSeconds = _portAudioOutput->GetOutputLagSeconds(lagClockSequence);
+
+        const bool consistent = lagClockSequence == clockSequence && clockSequence % 2 == 0; // Otherwise the audio callback ran meanwhile.
+        if (consistent || attempt == Static::CLOCK_READ_ATTEMPTS)
         {
-            return _preRender->GetCurrentSongTimeMs();
+            const uint_least32_t lagMs = static_cast<uint_least32_t>(lagSeconds * 1000.0 * GetPlaybackSpeedFactor());
+            return (handedOutTimeMs > lagMs) ? handedOutTimeMs - lagMs : 0;
         }
 
-        return _sidDecoder->GetTime();
+        std::this_thread::yield();
+    }
+}
+
+uint_least32_t PlaybackController::GetHandedOutTime() const
+{
+    // The speed stages also hold some of the source's frames (resampler's taps, time-stretcher's windows), which aren't heard yet either.
+    const uint_least32_t frequency = _sidDecoder->GetSidConfig().frequency;
+    const uint_least64_t stagesBufferedFrames = _speedResampler->GetBufferedFrames() + _timeStretcher->GetBufferedFrames();
+    const uint_least32_t stagesBufferedMs = static_cast<uint_least32_t>(stagesBufferedFrames * 1000 / frequency);
+
+    if (_preRender != nullptr)
+    {
+        const uint_least32_t preRenderTimeMs = _preRender->GetCurrentSongTimeMs();
+        return (preRenderTimeMs > stagesBufferedMs) ? preRenderTimeMs - stagesBufferedMs : 0;
+    }
+
+    // Compensate for the audio which is already rendered but not handed out yet.
+    if (_gaplessSwitch->HasSwitched())
+    {
+        // The active decoder has already stopped at the switch point, but its tail may still be buffered ahead of the armed one's beginning.
+        const uint_least64_t bufferedFrames = _renderAhead->GetBufferedFrames() + stagesBufferedFrames;
+        const uint_least64_t framesSinceSwitch = _gaplessSwitch->GetFramesSinceSwitch();
+        const uint_least64_t unheardFrames = (bufferedFrames > framesSinceSwitch) ? bufferedFrames - framesSinceSwitch : 0;
+        const uint_least32_t unheardMs = static_cast<uint_least32_t>(unheardFrames * 1000 / frequency);
+        const uint_least32_t switchAtMs = _gaplessSwitch->GetSwitchAtMs();
+        return (switchAtMs > unheardMs) ? switchAtMs - unheardMs : 0;
     }
+
+    const uint_least32_t decoderTimeMs = _sidDecoder->GetTime();
+    const uint_least32_t bufferedMs = _renderAhead->GetBufferedMs() + stagesBufferedMs;
+    return (decoderTimeMs > bufferedMs) ? decoderTimeMs - bufferedMs : 0;
 }
 
 double PlaybackController::GetPreRenderProgressFactor() const
@@ -372,21 +610,63 @@ double PlaybackController::GetPreRenderProgressFactor() const
     return (_preRender == nullptr) ? 0.0 : _preRender->GetPreRenderProgressFactor();
 }
 
-bool PlaybackController::TrySetPlaybackSpeed(double factor)
+void PlaybackController::SetRenderAheadDepth(unsigned int depthMs)
 {
-    const double deviceSampleRate = _portAudioOutput->GetAudioConfig().sampleRate;
-    const double desiredStreamSampleRate = deviceSampleRate * factor;
+    _renderAhead->SetDepthMs(depthMs);
+}
 
-    const bool supported = _portAudioOutput->IsOutputSampleRateSupported(desiredStreamSampleRate);
-    _playbackSpeedFactor = (supported) ? factor : 1.0;
+void PlaybackController::SetAdaptiveLatency(bool enable)
+{
+    _adaptiveLatency = enable;
+}
+
+bool PlaybackController::TryLoadLatencyProfiles(const std::wstring& filepath)
+{
+    return _latencyTuner.TryLoad(filepath);
+}
 
-    const double applyStreamSampleRate = (supported) ? desiredStreamSampleRate : deviceSampleRate;
+bool PlaybackController::TrySaveLatencyProfiles(const std::wstring& filepath) const
+{
+    return _latencyTuner.TrySave(filepath);
+}
 
-    _portAudioOutput->ResetStream(applyStreamSampleRate);
-    if (_state == State::Playing)
-    {
-        _portAudioOutput->TryStartStream();
-    }
+void PlaybackController::SetRealtimeMode(bool enable, int cpuCore)
+{
+    _realtimeMode = enable && RealtimeUtil::IsSupported();
+    _realtimeReport.clear();
+    _renderAhead->SetRealtime(_realtimeMode, cpuCore);
+    _portAudioOutput->SetMemoryLocking(_realtimeMode);
+}
+
+PlaybackController::RealtimeStatus PlaybackController::GetRealtimeStatus() const
+{
+    const bool regularMode = _preRender == nullptr;
+    const RealtimeUtil::Grants renderAheadGrants = _renderAhead->GetRealtimeGrants();
+    const bool renderAheadRing = regularMode && _renderAhead->IsBuffering();
+
+    RealtimeStatus status{};
+    status.memoryLocked = _realtimeMode && _portAudioOutput->IsMemoryLocked() &&
+                          (regularMode || _preRender->IsMemoryLocked()) &&
+                          (!renderAheadRing || renderAheadGrants.memoryLocked);
+
+    status.realtimeScheduling = _realtimeMode && regularMode && renderAheadGrants.realtimeScheduling;
+    status.cpuPinned = _realtimeMode && regularMode && renderAheadGrants.cpuPinned;
+    return status;
+}
+
+PlaybackController::RenderAheadStatus PlaybackController::GetRenderAheadStatus() const
+{
+    return {_renderAhead->GetUnderrunCount(), _renderAhead->GetBufferedMs(), _renderAhead->GetFillFactor()};
+}
+
+bool PlaybackController::TrySetPlaybackSpeed(double factor)
+{
+    const bool supported = factor >= SpeedResampler::MIN_SPEED_FACTOR && factor <= SpeedResampler::MAX_SPEED_FACTOR;
+    const double clampedFactor = std::clamp(factor, SpeedResampler::MIN_SPEED_FACTOR, SpeedResampler::MAX_SPEED_FACTOR);
+
+    // Only one of them is in effect, the other one just passes the audio through.
+    _speedResampler->SetSpeedFactor(_preservePitch ? 1.0 : clampedFactor);
+    _timeStretcher->SetSpeedFactor(_preservePitch ? clampedFactor : 1.0);
 
     EmitSignal(SignalsPlaybackController::SIGNAL_PLAYBACK_SPEED_CHANGED);
 
@@ -395,7 +675,22 @@ bool PlaybackController::TrySetPlaybackSpeed(double factor)
 
 double PlaybackController::GetPlaybackSpeedFactor() const
 {
-    return _playbackSpeedFactor;
+    return (_preservePitch) ? _timeStretcher->GetSpeedFactor() : _speedResampler->GetSpeedFactor();
+}
+
+void PlaybackController::SetPitchPreserved(bool preserve)
+{
+    if (preserve != _preservePitch)
+    {
+        const double factor = GetPlaybackSpeedFactor();
+        _preservePitch = preserve;
+        TrySetPlaybackSpeed(factor);
+    }
+}
+
+bool PlaybackController::IsPitchPreserved() const
+{
+    return _preservePitch;
 }
 
 int PlaybackController::GetCurrentSubsong() const
@@ -430,7 +725,7 @@ int PlaybackController::GetCurrentTuneSidChipsRequired() const
 
 std::string PlaybackController::GetCurrentTuneSpeedDescription() const
 {
-    return _sidDecoder->GetEngineInfo().speedString();
+    return _sidDecoder->GetEngineInfo().speedString;
 }
 
 SidConfig::sid_model_t PlaybackController::GetCurrentlyEffectiveSidModel() const
@@ -608,6 +903,16 @@ bool PlaybackController::ToggleVoice(unsigned int sidNum, unsigned int voice, bo
         if (sidNum + 1 <= GetCurrentTuneSidChipsRequired())
         {
             _sidDecoder->ToggleVoice(sidNum, voice, enable);
+            if (_upcomingSidDecoder != nullptr)
+            {
+                _upcomingSidDecoder->ToggleVoice(sidNum, voice, enable); // In case the _preRender is still rendering from it.
+            }
+
+            if (IsPreRenderPerVoice())
+            {
+                UpdateStemGains();
+            }
+
             EmitSignal(SignalsPlaybackController::SIGNAL_VOICE_TOGGLED);
             return true;
         }
@@ -631,6 +936,11 @@ bool PlaybackController::AreAllRelevantVoicesEnabled() const
     });
 }
 
+bool PlaybackController::IsPreRenderPerVoice() const
+{
+    return _preRender != nullptr && _preRender->HasStems();
+}
+
 void PlaybackController::UnloadActiveTune()
 {
     Stop();
@@ -659,11 +969,18 @@ bool PlaybackController::TryResetSidDecoder(const SyncedPlaybackConfig& newConfi
         Stop();
     }
 
+    StashPreRender(); // Stays valid for the old SID params (in case they're switched back).
     _preRender = nullptr; // Some SID params changed, any pre-rendered content is no longer valid.
+    _stemSidDecoders.clear(); // Will be re-created with the new config.
+    _seekSidDecoder = nullptr; // Ditto.
+    _upcomingSidDecoder = nullptr; // Ditto.
+    _armedSidDecoder = nullptr; // Will be re-created with the new config.
 
     const bool success = _sidDecoder->TryInitEmulation(newConfig.sidConfig, newConfig.filterConfig);
     if (success)
     {
+        _upcomingPreRender.SetEmulationConfig(newConfig.sidConfig, newConfig.filterConfig);
+
         if (_state != State::Undefined && _activeTuneHolder != nullptr)
         {
             PrepareTryPlay(); // Stop everything (seeking, playback, whathaveyou).
@@ -690,10 +1007,238 @@ bool PlaybackController::TryResetAudioOutput(const PortAudioOutput::AudioConfig&
         throw std::runtime_error("Sample rates not in sync between SID decoder and Audio Output!");
     }
 
+    if (!_latencyProfileKey.empty() && _portAudioOutput != nullptr)
+    {
+        _latencyTuner.Learn(_latencyProfileKey, TakeLatencySession());
+        _latencyProfileKey.clear(); // The stream gets reopened with the defaults.
+    }
+
+    StashPreRender();
     _preRender = (enablePreRender) ? std::make_unique<PreRender>() : nullptr; // Enable the pre-render output if desired, otherwise destroy the old instance.
 
-    IBufferWriter* decoder = (_preRender == nullptr) ? _sidDecoder.get() : static_cast<IBufferWriter*>(_preRender.get()); // Use either the pre-render or the realtime audio output.
-    return _portAudioOutput != nullptr && _portAudioOutput->TryInit(audioConfig, decoder);
+    IBufferWriter* decoder = (_preRender == nullptr) ? static_cast<IBufferWriter*>(_renderAhead.get()) : static_cast<IBufferWriter*>(_preRender.get()); // Use either the pre-render or the realtime (render-ahead) audio output.
+    _speedResampler->SetSource(*decoder, audioConfig.channelCount);
+    _timeStretcher->SetSource(*_speedResampler, static_cast<int>(audioConfig.sampleRate), audioConfig.channelCount);
+    return _portAudioOutput != nullptr && _portAudioOutput->TryInit(audioConfig, _timeStretcher.get());
+}
+
+void PlaybackController::StartRenderAhead()
+{
+    const SidConfig& sidConfig = _sidDecoder->GetSidConfig();
+    _gaplessSwitch->SetCurrent(*_sidDecoder, sidConfig.frequency, sidConfig.playback, _sidDecoder->GetTime());
+    _renderAhead->Start(*_gaplessSwitch, sidConfig.frequency, sidConfig.playback, _portAudioOutput->GetFramesPerBuffer());
+}
+
+void PlaybackController::ApplyLatencyTuning()
+{
+    const PortAudioOutput::OutputStats session = TakeLatencySession();
+    if (!_latencyProfileKey.empty())
+    {
+        _latencyTuner.Learn(_latencyProfileKey, session);
+    }
+
+    _latencyProfileKey = (_adaptiveLatency) ? LatencyTuner::MakeProfileKey(_portAudioOutput->GetDeviceIdentity(), GetCurrentTuneSidChipsRequired()) : "";
+    const LatencyTuner::Setting setting = (_latencyProfileKey.empty()) ?
+        LatencyTuner::Setting{paFramesPerBufferUnspecified, 0.0} :
+        _latencyTuner.GetSetting(_latencyProfileKey, GetAudioConfig().sampleRate, _portAudioOutput->GetDefaultSuggestedLatency());
+
+    if (_portAudioOutput->ReopenStream(setting.framesPerBuffer, setting.suggestedLatency) != paNoError && !_latencyProfileKey.empty())
+    {
+        Warn("The learned audio buffer setting was refused, falling back to the defaults.");
+        _latencyProfileKey.clear();
+        _portAudioOutput->ReopenStream(paFramesPerBufferUnspecified, 0.0);
+    }
+}
+
+PortAudioOutput::OutputStats PlaybackController::TakeLatencySession()
+{
+    PortAudioOutput::OutputStats session = _portAudioOutput->TakeOutputStats();
+    const RenderAheadBuffer::ProducerStats producer = _renderAhead->TakeProducerStats();
+    session.underruns += producer.underruns;
+    session.highLoad = std::max(session.highLoad, producer.highLoad); // The callback's own load still counts for the pass-through parts of the session.
+    return session;
+}
+
+void PlaybackController::ReportRealtimeStatus()
+{
+    const RealtimeStatus status = GetRealtimeStatus();
+    const bool regularMode = _preRender == nullptr;
+    const auto describe = [](bool granted) { return (granted) ? "granted" : "denied"; };
+
+    std::string report = std::string("Real-time mode: memory locking ") + describe(status.memoryLocked);
+    report += (regularMode) ? std::string(", real-time scheduling ") + describe(status.realtimeScheduling) + ", CPU pinning " + describe(status.cpuPinned) : ", render thread not used (Fast seeking mode)";
+    if (report == _realtimeReport)
+    {
+        return;
+    }
+
+    _realtimeReport = report;
+    const bool allGranted = status.memoryLocked && (!regularMode || (status.realtimeScheduling && status.cpuPinned));
+    if (allGranted)
+    {
+        DebugInfo(report.c_str());
+    }
+    else
+    {
+        Warn(report.c_str());
+    }
+}
+
+void PlaybackController::JoinArmThread()
+{
+    if (_armThread.joinable())
+    {
+        _armThread.join();
+    }
+}
+
+void PlaybackController::DropArmedTune()
+{
+    JoinArmThread();
+    _gaplessSwitch->HardReset();
+    _armedTuneHolder = nullptr;
+
+    if (_armedSidDecoder != nullptr)
+    {
+        _armedSidDecoder->UnloadActiveTune();
+    }
+}
+
+int PlaybackController::GetPreRenderWindowMs() const
+{
+    if (_preRenderMemoryLimitMb == 0)
+    {
+        return 0;
+    }
+
+    const SidConfig& sidConfig = _sidDecoder->GetSidConfig();
+    const uint_least64_t bytesPerSecond = static_cast<uint_least64_t>(sidConfig.frequency) * sidConfig.playback * sizeof(short);
+    const uint_least64_t limitBytes = static_cast<uint_least64_t>(_preRenderMemoryLimitMb) * 1024 * 1024;
+    return static_cast<int>(std::min<uint_least64_t>(limitBytes * 1000 / bytesPerSecond, std::numeric_limits<int>::max()));
+}
+
+bool PlaybackController::TryPreRenderStems(int preRenderDurationMs, int preRenderWindowMs)
+{
+    const SidConfig& sidConfig = _sidDecoder->GetSidConfig();
+    const unsigned int sidsNeeded = static_cast<unsigned int>(_sidDecoder->GetCurrentTuneSidChipsRequired());
+    const size_t stemCount = 1 + sidsNeeded * Static::VOICES_PER_SID; // First one has all the voices muted (just the digis and such), the others a single voice each.
+    const int stemChannels = (sidsNeeded == 1) ? 1 : sidConfig.playback; // Single SID sounds the same in both stereo channels anyway.
+
+    // Unlike the mixed pre-render, the stems are never windowed.
+    if (preRenderWindowMs > 0 && static_cast<uint_least64_t>(preRenderDurationMs) * stemCount * stemChannels > static_cast<uint_least64_t>(preRenderWindowMs) * sidConfig.playback)
+    {
+        return false;
+    }
+
+    SidConfig stemSidConfig = sidConfig;
+    stemSidConfig.playback = (stemChannels == 1) ? SidConfig::playback_t::MONO : sidConfig.playback;
+
+    std::vector<PreRender::StemSource> stems;
+    for (size_t stemIndex = 0; stemIndex < stemCount; ++stemIndex)
+    {
+        const bool isNew = stemIndex == _stemSidDecoders.size();
+        if (isNew)
+        {
+            _stemSidDecoders.emplace_back(std::make_unique<SidDecoder>());
+        }
+
+        SidDecoder& decoder = *_stemSidDecoders[stemIndex];
+        if (isNew || decoder.GetSidConfig().playback != stemSidConfig.playback)
+        {
+            if (!decoder.TryInitEmulation(stemSidConfig, _sidDecoder->GetFilterConfig()))
+            {
+                _stemSidDecoders.resize(stemIndex); // Try again from scratch next time.
+                return false;
+            }
+
+            decoder.TrySetRoms(_romPathKernal, _romPathBasic, _romPathChargen);
+        }
+
+        if (!decoder.TryLoadSong(_activeTuneHolder->bufferHolder->data, _activeTuneHolder->bufferHolder->size, GetCurrentSubsong()))
+        {
+            return false;
+        }
+
+        for (unsigned int sidNum = 0; sidNum < sidsNeeded; ++sidNum)
+        {
+            for (unsigned int voice = 0; voice < Static::VOICES_PER_SID; ++voice)
+            {
+                decoder.ToggleVoice(sidNum, voice, stemIndex == 1 + sidNum * Static::VOICES_PER_SID + voice);
+            }
+        }
+
+        stems.push_back({&decoder, stemChannels});
+    }
+
+    _preRender->DoPreRenderStems(stems, sidConfig.frequency, sidConfig.playback, preRenderDurationMs);
+    return true;
+}
+
+bool PlaybackController::TryPrepareSeekSidDecoder()
+{
+    if (_seekSidDecoder == nullptr)
+    {
+        _seekSidDecoder = std::make_unique<SidDecoder>();
+        if (!_seekSidDecoder->TryInitEmulation(_sidDecoder->GetSidConfig(), _sidDecoder->GetFilterConfig()))
+        {
+            _seekSidDecoder = nullptr; // Try again from scratch next time.
+            return false;
+        }
+
+        _seekSidDecoder->TrySetRoms(_romPathKernal, _romPathBasic, _romPathChargen);
+    }
+
+    if (!_seekSidDecoder->TryLoadSong(_activeTuneHolder->bufferHolder->data, _activeTuneHolder->bufferHolder->size, GetCurrentSubsong()))
+    {
+        return false;
+    }
+
+    // Must sound the same as the main one.
+    const SidDecoder::SidVoicesEnabledStatus& voicesEnabledStatus = _sidDecoder->GetSidVoicesEnabledStatus();
+    for (unsigned int sidNum = 0; sidNum < voicesEnabledStatus.size(); ++sidNum)
+    {
+        for (unsigned int voice = 0; voice < voicesEnabledStatus[sidNum].size(); ++voice)
+        {
+            _seekSidDecoder->ToggleVoice(sidNum, voice, voicesEnabledStatus[sidNum][voice]);
+        }
+    }
+
+    return true;
+}
+
+void PlaybackController::StashPreRender()
+{
+    if (_preRender != nullptr && _preRenderKey != nullptr)
+    {
+        _preRenderCache.TryStore(*_preRenderKey, *_preRender);
+    }
+
+    _preRenderKey = nullptr;
+}
+
+PreRenderCache::Key PlaybackController::GetPreRenderKey(int preRenderDurationMs) const
+{
+    return {_activeTuneHolder->md5, static_cast<unsigned int>(GetCurrentSubsong()), preRenderDurationMs, PreRenderCache::HashConfig(_sidDecoder->GetSidConfig(), _sidDecoder->GetFilterConfig()), _activeTuneHolder->filepath};
+}
+
+void PlaybackController::UpdateStemGains()
+{
+    // Every voice stem contains the muted-voices part too, so the first stem compensates for it: mix = muted + sum(voice - muted).
+    const SidDecoder::SidVoicesEnabledStatus& allSidVoices = _sidDecoder->GetSidVoicesEnabledStatus();
+    const unsigned int sidsNeeded = static_cast<unsigned int>(_sidDecoder->GetCurrentTuneSidChipsRequired());
+
+    float mutedPartGain = 1.0f;
+    for (unsigned int sidNum = 0; sidNum < sidsNeeded; ++sidNum)
+    {
+        for (unsigned int voice = 0; voice < Static::VOICES_PER_SID; ++voice)
+        {
+            const bool enabled = allSidVoices.at(sidNum).at(voice);
+            _preRender->SetStemGain(1 + sidNum * Static::VOICES_PER_SID + voice, enabled ? 1.0f : 0.0f);
+            mutedPartGain -= enabled ? 1.0f : 0.0f;
+        }
+    }
+
+    _preRender->SetStemGain(0, mutedPartGain);
 }
 
 void PlaybackController::PrepareTryPlay()
@@ -715,14 +1260,23 @@ void PlaybackController::PrepareTryPlay()
             _preRender->Stop();
         }
 
+        _renderAhead->Halt();
         _sidDecoder->Stop();
     }
+
+    DropArmedTune();
 }
 
 bool PlaybackController::FinalizeTryPlay(bool isSuccessful, int preRenderDurationMs, bool reusePreRender)
 {
     if (isSuccessful)
     {
+        // Instant seeking mode seeks within its own buffer, seek checkpoints are only useful in regular mode (and as seek anchors of a windowed pre-render).
+        const int preRenderWindowMs = GetPreRenderWindowMs();
+        const bool regularMode = preRenderDurationMs <= 0;
+        const bool windowedPreRender = !regularMode && preRenderWindowMs > 0 && preRenderDurationMs > preRenderWindowMs;
+        _sidDecoder->SetSeekCheckpoints((regularMode || windowedPreRender) ? Static::SEEK_CHECKPOINT_INTERVAL_MS : 0, Static::SEEK_CHECKPOINTS_MAX);
+
         if (preRenderDurationMs > 0)
         {
             if (_preRender == nullptr)
@@ -730,21 +1284,64 @@ bool PlaybackController::FinalizeTryPlay(bool isSuccessful, int preRenderDuratio
                 TryResetAudioOutput(GetAudioConfig(), true);
             }
 
-            if (!reusePreRender || _preRender->GetPreRenderProgressFactor() != 1.0)
+            _preRender->SetMemoryLocking(_realtimeMode);
+
+            if (!reusePreRender || !_preRender->IsFullyAvailable())
             {
-                const SidConfig& sidConfig = _sidDecoder->GetSidConfig();
-                _preRender->DoPreRender(*_sidDecoder.get(), sidConfig.frequency, sidConfig.playback, preRenderDurationMs);
+                StashPreRender();
+
+                // Upcoming subsongs are pre-rendered with all voices enabled (as are the cached ones, unless they're per-voice).
+                const bool allVoicesEnabled = AreAllRelevantVoicesEnabled();
+
+                // Reminder: the stems (opt-in, for toggling the voices) cost several emulations, so any already rendered content is preferred.
+                const PreRenderCache::Key key = GetPreRenderKey(preRenderDurationMs);
+                const bool obtained = _preRenderCache.TryTake(key, allVoicesEnabled, *_preRender) ||
+                                      (allVoicesEnabled && _upcomingPreRender.TryTake(_activeTuneHolder->filepath, GetCurrentSubsong(), preRenderDurationMs, *_preRender, _upcomingSidDecoder)) ||
+                                      (_preRenderVoiceStems && TryPreRenderStems(preRenderDurationMs, preRenderWindowMs));
+
+                if (!obtained && !windowedPreRender && TryPrepareSeekSidDecoder())
+                {
+                    const SidConfig& sidConfig = _sidDecoder->GetSidConfig();
+                    _preRender->DoPreRenderSeekPriority({_sidDecoder.get(), Static::GetAbortableSeeker(*_sidDecoder)}, {_seekSidDecoder.get(), Static::GetAbortableSeeker(*_seekSidDecoder)}, sidConfig.frequency, sidConfig.playback, preRenderDurationMs);
+                }
+                else if (!obtained)
+                {
+                    const SidConfig& sidConfig = _sidDecoder->GetSidConfig();
+                    _preRender->DoPreRender(*_sidDecoder.get(), sidConfig.frequency, sidConfig.playback, preRenderDurationMs, preRenderWindowMs, Static::GetAbortableSeeker(*_sidDecoder));
+                }
+
+                if (IsPreRenderPerVoice())
+                {
+                    UpdateStemGains();
+                }
+
+                _preRenderKey = (IsPreRenderPerVoice() || allVoicesEnabled) ? std::make_unique<PreRenderCache::Key>(key) : nullptr;
             }
         }
         else
         {
+            _upcomingPreRender.Clear();
+
             if (_preRender != nullptr)
             {
                 TryResetAudioOutput(GetAudioConfig(), false); // Destroy _preRender
             }
         }
 
+        ApplyLatencyTuning();
+        if (_preRender == nullptr)
+        {
+            StartRenderAhead(); // Reminder: after the ApplyLatencyTuning, the ring depends on the stream's buffer size.
+        }
+
+        _speedResampler->Reset(); // Drop the leftovers of whatever played before.
+        _timeStretcher->Reset();
         isSuccessful = _portAudioOutput->TryStartStream();
+        if (isSuccessful && _realtimeMode)
+        {
+            ReportRealtimeStatus();
+        }
+
         if (!isSuccessful)
         {
             if (_preRender != nullptr)
@@ -752,6 +1349,7 @@ bool PlaybackController::FinalizeTryPlay(bool isSuccessful, int preRenderDuratio
                 _preRender->Stop();
             }
 
+            _renderAhead->Halt();
             _sidDecoder->Stop();
             _activeTuneHolder = nullptr;
         }
@@ -18,16 +18,26 @@
 
 #pragma once
 
+#include "GaplessSwitch.h"
+#include "LatencyTuner.h"
+#include "ParallelPreRender.h"
 #include "PreRender.h"
+#include "PreRenderCache.h"
+#include "RenderAheadBuffer.h"
+#include "SpeedResampler.h"
+#include "TimeStretcher.h"
 #include "PlaybackWrappers/Output/PortAudioOutput.h"
 #include "PlaybackWrappers/Input/SidDecoder.h"
 #include "Util/RomUtil.h"
+#include "Util/RealtimeUtil.h"
 #include "../Util/BufferHolder.h"
 #include "../Util/SimpleSignal/SimpleSignalProvider.h"
 
 #include <atomic>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 enum class SignalsPlaybackController
 {
@@ -59,6 +69,21 @@ public:
 
     using FilterConfig = SidDecoder::FilterConfig;
     using SongInfoCategory = SidDecoder::SongInfoCategory;
+    using UpcomingPreRenderJob = ParallelPreRender::Job;
+
+    struct RenderAheadStatus
+    {
+        uint_least64_t underruns;
+        uint_least32_t bufferedMs;
+        double fillFactor;
+    };
+
+    struct RealtimeStatus
+    {
+        bool memoryLocked; // All the buffers the audio callback reads from or writes to.
+        bool realtimeScheduling; // Of the render-ahead thread (regular mode only).
+        bool cpuPinned; // Ditto.
+    };
 
     struct SyncedPlaybackConfig
     {
@@ -111,12 +136,14 @@ private:
         TuneHolder() = delete;
         TuneHolder(const std::wstring& filepathForUid, std::unique_ptr<BufferHolder>& loadedBufferToAdopt) :
             filepath(filepathForUid),
-            bufferHolder(std::move(loadedBufferToAdopt))
+            bufferHolder(std::move(loadedBufferToAdopt)),
+            md5(Md5Lanes::HashAll({{bufferHolder->data, bufferHolder->size}}).front())
         {
         }
 
         const std::wstring filepath;
         const std::unique_ptr<const BufferHolder> bufferHolder;
+        const Md5Lanes::Digest md5;
     };
 
 public:
@@ -129,7 +156,7 @@ public:
     bool TryInit(const SyncedPlaybackConfig& config);
     SwitchAudioDeviceResult TrySwitchPlaybackConfiguration(const SyncedPlaybackConfig& newConfig);
 
-    // Paths should be absolute.
+    // Paths should be absolute. Stops the playback (if any).
     RomUtil::RomStatus TrySetRoms(const std::wstring& pathKernal, const std::wstring& pathBasic, const std::wstring& pathChargen);
 
 public:
@@ -137,6 +164,34 @@ public:
     bool TryReplayCurrentSong(int preRenderDurationMs, bool reusePreRender = false);
     bool TryPlaySubsong(unsigned int subsong, int preRenderDurationMs, bool reusePreRender = false);
 
+    /// @brief Loads the next (sub)song into a second decoder in the background, so the playback continues with it seamlessly (without stopping the audio stream) once the active one reaches the switchAtMs. Regular (render-ahead) mode only.
+    /// Replaces the previously armed one unless that one is already playing. Returns false if not possible in the current state.
+    bool TryArmNext(const std::wstring& filepathForUid, std::unique_ptr<BufferHolder>& loadedBufferToAdopt, unsigned int subsong, uint_least32_t switchAtMs);
+
+    /// @brief Discards the armed (sub)song unless the playback has already switched over to it.
+    void DisarmNext();
+
+    /// @brief Returns true if the playback has switched over to the armed (sub)song which isn't the active one yet (see TryPromoteArmedTune).
+    bool HasSwitchedToArmedTune() const;
+
+    /// @brief Makes the armed (sub)song the active one as soon as it's actually audible (i.e., the tail of the previous one has been played out). Returns true if that happened.
+    bool TryPromoteArmedTune();
+
+    /// @brief Pre-renders the upcoming subsongs in parallel (in order of priority) so their playback can later start instantly. Pass an empty list to discard.
+    void PreRenderUpcoming(std::vector<UpcomingPreRenderJob>& jobs);
+
+    /// @brief Sets the maximum number of upcoming subsongs to be pre-rendered in parallel. Pass 0 to disable.
+    void SetUpcomingPreRenderLimit(unsigned int maxSubsongs);
+
+    /// @brief Sets the memory limit for a single pre-render. Longer songs are pre-rendered in a sliding window around the play head instead (seeking outside of it re-renders from the nearest seek checkpoint). Takes effect from the next pre-render. Pass 0 for no limit.
+    void SetPreRenderMemoryLimit(unsigned int megabytes);
+
+    /// @brief Whether the pre-render keeps every voice separately (if the whole song fits within the memory limit that way) so the voices can still be toggled during its playback. Takes effect from the next pre-render.
+    void SetPreRenderVoiceStems(bool enable);
+
+    /// @brief Sets the memory budget for keeping the complete pre-renders of the recently played subsongs, so revisiting them starts instantly. Pass 0 to disable.
+    void SetPreRenderCacheLimit(unsigned int megabytes);
+
     void Pause();
     void Resume();
     void Stop();
@@ -147,13 +202,35 @@ public:
     State GetState() const;
     State GetResumeState() const;
 
-    /// @brief Gets the current playback time position. Playback buffer size affects the returned value and is typically some milliseconds in the future.
+    /// @brief Gets the currently audible playback time position (compensated for the output latency, interpolated between the playback buffers).
     uint_least32_t GetTime() const;
     double GetPreRenderProgressFactor() const;
 
+    /// @brief Sets the depth of the render-ahead buffer between the emulation and the audio callback (regular mode only). Takes effect from the next playback start. Pass 0 to render directly in the audio callback.
+    void SetRenderAheadDepth(unsigned int depthMs);
+
+    /// @brief Lets the playback buffer size be learned per audio device & SID chip count (see LatencyTuner) rather than always using the defaults. Takes effect from the next playback start.
+    void SetAdaptiveLatency(bool enable);
+
+    bool TryLoadLatencyProfiles(const std::wstring& filepath);
+    bool TrySaveLatencyProfiles(const std::wstring& filepath) const;
+
+    /// @brief Opt-in real-time mode (Linux only, see RealtimeUtil): pre-faults & locks the playback buffers in RAM and runs the render-ahead thread with a real-time scheduling policy, pinned to the cpuCore (unless negative).
+    /// Takes effect from the next playback start, which reports what was granted (see GetRealtimeStatus).
+    void SetRealtimeMode(bool enable, int cpuCore);
+    RealtimeStatus GetRealtimeStatus() const;
+
+    /// @brief Gets the underrun count (since app start) and the current fill level of the render-ahead buffer.
+    RenderAheadStatus GetRenderAheadStatus() const;
+
+    /// @brief Changes the speed on the fly (no audio stream restart). Returns false if the factor is out of the supported range (it gets clamped then).
     bool TrySetPlaybackSpeed(double factor);
     double GetPlaybackSpeedFactor() const;
 
+    /// @brief Whether the playback speed changes the tempo only (time-stretching) rather than both the tempo and the pitch (resampling).
+    void SetPitchPreserved(bool preserve);
+    bool IsPitchPreserved() const;
+
     int GetCurrentSubsong() const;
     int GetDefaultSubsong();
     int GetTotalSubsongs() const;
@@ -184,24 +261,60 @@ public:
     bool IsVoiceEnabled(unsigned int sidNum, unsigned int voice) const;
     bool AreAllRelevantVoicesEnabled() const;
 
+    /// @brief Whether the active pre-render consists of per-voice stems (i.e., voices are toggleable during its playback).
+    bool IsPreRenderPerVoice() const;
+
     void UnloadActiveTune();
 
     /// @brief Defines visualization (double) buffer length. Pass 0 to disable and free some resources. Returns size of buffer (calculated from milliseconds and the currently effective sample rate).
     size_t SetVisualizationWaveformWindow(size_t milliseconds);
 
-    /// @brief Copies the latest available waveform data (playback buffer size affects latency) into a target buffer. Returns size of data if successful or 0 if not ready or disabled.
+    /// @brief Copies the currently audible waveform data into a target buffer. Returns size of data if successful or 0 if not ready or disabled.
     size_t GetVisualizationWaveform(short* out) const;
 
 private:
     bool TryResetSidDecoder(const SyncedPlaybackConfig& newConfig);
     bool TryResetAudioOutput(const PortAudioOutput::AudioConfig& audioConfig, bool enablePreRender);
 
+    void StartRenderAhead();
+
+    /// @brief Learns from the playback session since the last call, then reopens the (stopped) audio stream with the buffer setting for the active song (if different).
+    void ApplyLatencyTuning();
+
+    /// @brief Returns and resets the stats of the playback session since the last call, including the render-ahead buffer's underruns and producer load (as the audio callback only copies while it's fed by it).
+    PortAudioOutput::OutputStats TakeLatencySession();
+
+    /// @brief Logs what the real-time mode was granted (only if that changed since the last time).
+    void ReportRealtimeStatus();
+
+    void JoinArmThread();
+
+    /// @brief Forgets the armed (sub)song regardless of whether it's already playing. Nothing must be rendering (render-ahead halted).
+    void DropArmedTune();
+
+    /// @brief Returns the pre-render window length corresponding to the memory limit, or 0 if unlimited.
+    int GetPreRenderWindowMs() const;
+
+    /// @brief Pre-renders every voice of the active (sub)song separately (using the stem decoders) if the whole song fits within the memory limit that way.
+    bool TryPreRenderStems(int preRenderDurationMs, int preRenderWindowMs);
+
+    /// @brief Loads the active (sub)song into the second decoder of the seek-priority pre-render (see PreRender::DoPreRenderSeekPriority).
+    bool TryPrepareSeekSidDecoder();
+
+    /// @brief Moves the content of the _preRender (if complete and cacheable) into the cache.
+    void StashPreRender();
+    PreRenderCache::Key GetPreRenderKey(int preRenderDurationMs) const;
+    void UpdateStemGains();
+
     void PrepareTryPlay();
     bool FinalizeTryPlay(bool isSuccessful, int preRenderDurationMs, bool reusePreRender = false);
     bool TryReplayCurrentSongFromBuffer(unsigned int subsong, int preRenderDurationMs, bool reusePreRender = false);
 
     bool OnSeekStatusReceived(uint_least32_t cTimeMs, bool done);
 
+    /// @brief Time position of the audio handed out to the audio device so far (i.e., GetTime without the output latency compensation).
+    uint_least32_t GetHandedOutTime() const;
+
 private:
     static void Warn(const char* message);
     static void DebugInfo(const char* message);
@@ -209,15 +322,40 @@ private:
 private:
     std::unique_ptr<TuneHolder> _activeTuneHolder;
     std::unique_ptr<SidDecoder> _sidDecoder;
+    std::vector<std::unique_ptr<SidDecoder>> _stemSidDecoders; // Lazily created, then reused. Reminder: must outlive the _preRender.
+    std::unique_ptr<SidDecoder> _seekSidDecoder; // Ditto.
+    std::unique_ptr<SidDecoder> _upcomingSidDecoder; // Of the upcoming subsong's render taken over while still in progress (the _preRender continues from it). Ditto.
     std::unique_ptr<PortAudioOutput> _portAudioOutput;
     std::unique_ptr<PreRender> _preRender;
+    std::unique_ptr<PreRenderCache::Key> _preRenderKey; // Of the content held by the _preRender, if cacheable.
+    PreRenderCache _preRenderCache;
+    std::unique_ptr<RenderAheadBuffer> _renderAhead;
+    std::unique_ptr<SpeedResampler> _speedResampler;
+    std::unique_ptr<TimeStretcher> _timeStretcher;
+    bool _preservePitch = false;
+    LatencyTuner _latencyTuner;
+    bool _adaptiveLatency = false;
+    std::string _latencyProfileKey; // Of the buffer setting the audio stream is opened with (empty if the defaults).
+    bool _realtimeMode = false;
+    std::string _realtimeReport; // Last one logged.
+    ParallelPreRender _upcomingPreRender;
+
+    // Gapless playback
+    std::unique_ptr<GaplessSwitch> _gaplessSwitch;
+    std::unique_ptr<SidDecoder> _armedSidDecoder; // Lazily created, then reused (swapped with the _sidDecoder on each promotion).
+    std::unique_ptr<TuneHolder> _armedTuneHolder;
+    std::thread _armThread;
 
     StateHolder _state;
     SeekOperation _seekOperation{};
 
-    double _playbackSpeedFactor = 1.0;
+    unsigned int _preRenderMemoryLimitMb = 0;
+    bool _preRenderVoiceStems = false;
 
     RomUtil::RomStatus _loadedRoms{};
+    std::wstring _romPathKernal;
+    std::wstring _romPathBasic;
+    std::wstring _romPathChargen;
 
 private:
     struct SeekProcessStatus
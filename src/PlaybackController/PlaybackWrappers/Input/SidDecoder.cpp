@@ -19,39 +19,65 @@
 #include "SidDecoder.h"
 
 #include <sidplayfp/SidTuneInfo.h>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 
 namespace
 {
-    // Load ROM dump from file. Allocate the buffer if file exists, otherwise return 0.
-    char* loadRom(const std::wstring& path, size_t romSize)
+    constexpr std::chrono::milliseconds CHECKPOINT_BUILDER_IDLE_POLL(250);
+    constexpr size_t MAX_IDLE_ENGINES = 2;
+    constexpr uint_least32_t CHECKPOINT_PARK_TOLERANCE_MS = 500; // How far past its slot a displaced engine may be to become that checkpoint.
+
+    // Load ROM dump from file. Returns an empty buffer if the file doesn't exist.
+    std::vector<uint8_t> loadRom(const std::wstring& path, size_t romSize)
     {
-        char* buffer = 0;
+        std::vector<uint8_t> buffer;
         std::ifstream is(path.c_str(), std::ios::binary);
         if (is.good())
         {
-            buffer = new char[romSize];
-            is.read(buffer, romSize);
+            buffer.resize(romSize);
+            is.read(reinterpret_cast<char*>(buffer.data()), romSize);
         }
         is.close();
         return buffer;
     }
+
+    const uint8_t* RomOrNull(const std::vector<uint8_t>& rom)
+    {
+        return (rom.empty()) ? nullptr : rom.data();
+    }
 }
 
-SidDecoder::SidDecoder() :
-    _rs(ReSIDfpBuilder(""))
+// EmulationEngine inner struct -------------------------------
+
+SidDecoder::EmulationEngine::EmulationEngine() :
+    builder("")
 {
     // Create SID emulators
-    _rs.create(_sidEngine.info().maxsids());
+    builder.create(player.info().maxsids());
+}
+
+// SidDecoder main class --------------------------------------
+
+SidDecoder::SidDecoder() :
+    _engine(std::make_unique<EmulationEngine>())
+{
+}
+
+SidDecoder::~SidDecoder()
+{
+    StopCheckpointBuilder();
 }
 
 bool SidDecoder::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
 {
+    // Reminder: no locking needed, the _engine is only ever swapped by the SeekTo, which is never called concurrently with this.
     const uint_least32_t length = (framesPerBuffer * _sidConfigCache.playback);
     short* const out = static_cast<short*>(buffer);
-    const uint_least32_t ret = _sidEngine.play(out, length);
+    const uint_least32_t ret = _engine->player.play(out, length);
 
     if (ret < length)
     {
@@ -59,34 +85,29 @@ bool SidDecoder::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
         return false;
     }
 
+    const uint_least32_t cTimeMs = _engine->player.timeMs();
+    if (cTimeMs > _furthestTimeMs)
+    {
+        _furthestTimeMs = cTimeMs;
+    }
+
     return true;
 }
 
 bool SidDecoder::TryInitEmulation(const SidConfig& sidConfig, const FilterConfig& filterConfig)
 {
-    // Check if builder is ok
-    if (!_rs.getStatus())
-    {
-        std::cerr << _rs.error() << std::endl;
-        return false;
-    }
+    StopCheckpointBuilder(); // Checkpoints of the old configuration are no longer valid.
 
     // Configure the engine
     _sidConfigCache = sidConfig;
-    _sidConfigCache.sidEmulation = &_rs;
+    _sidConfigCache.sidEmulation = nullptr; // Reminder: each engine has its own (see TryConfigureEngine).
+    _filterConfigCache = std::make_unique<FilterConfig>(filterConfig);
 
-    if (!_sidEngine.config(_sidConfigCache))
+    if (!TryConfigureEngine(*_engine, _sidConfigCache))
     {
-        std::cerr << _sidEngine.error() << std::endl;
         return false;
     }
 
-    _filterConfigCache = std::make_unique<FilterConfig>(filterConfig);
-
-    _rs.filter6581Curve(_filterConfigCache->filter6581Curve);
-    _rs.filter8580Curve(_filterConfigCache->filter8580Curve);
-    _rs.filter(_filterConfigCache->filterEnabled);
-
     // Reset the voices enabled status
     _sidVoicesEnabledStatus =
     {
@@ -100,29 +121,38 @@ bool SidDecoder::TryInitEmulation(const SidConfig& sidConfig, const FilterConfig
 
 bool SidDecoder::TryInitSidDatabase(const std::wstring& songlengthsFilename)
 {
-    return _sidDatabase.TryLoad(songlengthsFilename);
+    std::shared_ptr<Songlengths> database = std::make_shared<Songlengths>();
+    const bool success = database->TryLoad(songlengthsFilename);
+    _sidDatabase = database;
+    return success;
+}
+
+void SidDecoder::UseSidDatabaseOf(const SidDecoder& other)
+{
+    _sidDatabase = other._sidDatabase;
+}
+
+uint_least64_t SidDecoder::GetSidDatabaseStamp() const
+{
+    return (_sidDatabase == nullptr) ? 0 : _sidDatabase->GetSourceStamp();
 }
 
 RomUtil::RomStatus SidDecoder::TrySetRoms(const std::wstring& pathKernal, const std::wstring& pathBasic, const std::wstring& pathChargen)
 {
-    char* kernal = loadRom(pathKernal, RomUtil::ROM_SIZE_KERNAL);
-    char* basic = loadRom(pathBasic, RomUtil::ROM_SIZE_BASIC);
-    char* chargen = loadRom(pathChargen, RomUtil::ROM_SIZE_CHARGEN);
+    StopCheckpointBuilder(); // Checkpoints with the old ROMs are no longer valid.
+
+    _romKernal = loadRom(pathKernal, RomUtil::ROM_SIZE_KERNAL);
+    _romBasic = loadRom(pathBasic, RomUtil::ROM_SIZE_BASIC);
+    _romChargen = loadRom(pathChargen, RomUtil::ROM_SIZE_CHARGEN);
 
     RomUtil::RomStatus status;
-    status.Mark(RomUtil::RomType::Kernal, kernal != 0);
-    status.Mark(RomUtil::RomType::Basic, basic != 0);
-    status.Mark(RomUtil::RomType::Chargen, chargen != 0);
+    status.Mark(RomUtil::RomType::Kernal, !_romKernal.empty());
+    status.Mark(RomUtil::RomType::Basic, !_romBasic.empty());
+    status.Mark(RomUtil::RomType::Chargen, !_romChargen.empty());
 
-    _sidEngine.setRoms(
-        reinterpret_cast<const uint8_t*>(kernal),
-        reinterpret_cast<const uint8_t*>(basic),
-        reinterpret_cast<const uint8_t*>(chargen)
-    );
+    _engine->player.setRoms(RomOrNull(_romKernal), RomOrNull(_romBasic), RomOrNull(_romChargen));
 
-    delete[] kernal;
-    delete[] basic;
-    delete[] chargen;
+    StartCheckpointBuilder();
 
     return status;
 }
@@ -154,8 +184,25 @@ bool SidDecoder::TryLoadSong(const uint_least8_t* oneFileFormatSidtune, uint_lea
     return TrySetSubsong(subsong);
 }
 
+bool SidDecoder::TryLoadSongInfo(const uint_least8_t* oneFileFormatSidtune, uint_least32_t sidtuneLength)
+{
+    PrepareLoadSong();
+
+    _tune = std::make_unique<SidTune>(oneFileFormatSidtune, sidtuneLength);
+    if (!_tune->getStatus())
+    {
+        std::cerr << _tune->statusString() << std::endl;
+        return false;
+    }
+
+    _tune->selectSong(0); // Reminder: just so the current subsong info is valid, the engine is left alone.
+    return true;
+}
+
 bool SidDecoder::TrySetSubsong(unsigned int subsong)
 {
+    StopCheckpointBuilder();
+
     // Check if the tune is valid
     if (!_tune->getStatus())
     {
@@ -167,23 +214,27 @@ bool SidDecoder::TrySetSubsong(unsigned int subsong)
     _tune->selectSong(subsong);
 
     // Load tune into engine
-    if (!_sidEngine.load(_tune.get()))
+    if (!_engine->player.load(_tune.get()))
     {
-        std::cerr << _sidEngine.error() << std::endl;
+        std::cerr << _engine->player.error() << std::endl;
         return false;
     }
 
+    _furthestTimeMs = 0;
+    _checkpointsRequested = false;
+
     return true;
 }
 
 void SidDecoder::Stop()
 {
-    _sidEngine.stop();
+    _engine->player.stop();
 }
 
 uint_least32_t SidDecoder::GetTime() const
 {
-    return _sidEngine.timeMs();
+    std::lock_guard<std::mutex> lock(_engineMutex);
+    return _engine->player.timeMs();
 }
 
 int SidDecoder::GetCurrentSubsong() const
@@ -203,14 +254,34 @@ int SidDecoder::GetTotalSubsongs() const
 
 int_least32_t SidDecoder::TryGetActiveSongDuration() const
 {
-    if (_sidDatabase.IsLoaded())
+    if (_sidDatabase != nullptr && _sidDatabase->IsLoaded())
     {
-        return _sidDatabase.GetDurationMs(*_tune.get());
+        return _sidDatabase->GetDurationMs(*_tune.get());
     }
 
     return 0;
 }
 
+std::vector<uint_least32_t> SidDecoder::GetAllSubsongDurations() const
+{
+    if (_tune != nullptr && _sidDatabase != nullptr && _sidDatabase->IsLoaded())
+    {
+        return _sidDatabase->GetSubsongDurationsMs(*_tune.get());
+    }
+
+    return {};
+}
+
+std::vector<uint_least32_t> SidDecoder::GetAllSubsongDurations(const Md5Lanes::Digest& precomputedMd5) const
+{
+    if (_tune != nullptr && _sidDatabase != nullptr && _sidDatabase->IsLoaded())
+    {
+        return _sidDatabase->GetSubsongDurationsMs(precomputedMd5);
+    }
+
+    return {};
+}
+
 std::string SidDecoder::GetCurrentTuneInfoString(SongInfoCategory category) const
 {
     return _tune->getInfo()->infoString(static_cast<unsigned int>(category));
@@ -246,9 +317,13 @@ int SidDecoder::GetCurrentTuneSidChipsRequired() const
     return 0;
 }
 
-const SidInfo& SidDecoder::GetEngineInfo() const
+SidDecoder::EngineInfo SidDecoder::GetEngineInfo() const
 {
-    return _sidEngine.info();
+    const auto toString = [](const char* text) { return std::string((text == nullptr) ? "" : text); };
+
+    std::lock_guard<std::mutex> lock(_engineMutex);
+    const SidInfo& info = _engine->player.info();
+    return {toString(info.name()), toString(info.version()), toString(info.speedString()), toString(info.kernalDesc()), toString(info.basicDesc()), toString(info.chargenDesc())};
 }
 
 const SidDecoder::SidVoicesEnabledStatus& SidDecoder::GetSidVoicesEnabledStatus() const
@@ -258,7 +333,7 @@ const SidDecoder::SidVoicesEnabledStatus& SidDecoder::GetSidVoicesEnabledStatus(
 
 const SidConfig& SidDecoder::GetSidConfig() const
 {
-    return _sidEngine.config();
+    return _sidConfigCache;
 }
 
 const SidDecoder::FilterConfig& SidDecoder::GetFilterConfig() const
@@ -268,40 +343,328 @@ const SidDecoder::FilterConfig& SidDecoder::GetFilterConfig() const
 
 void SidDecoder::SeekTo(uint_least32_t timeMs, const SeekStatusCallback& callback)
 {
-    uint_least32_t cTimeMs = _sidEngine.timeMs();
-    if (cTimeMs >= timeMs)
+    // Reminder: the checkpoints only cost CPU time while nobody seeks, so the builder starts with the first seek of the song.
+    if (!_checkpointsRequested)
+    {
+        _checkpointsRequested = true;
+        StartCheckpointBuilder();
+    }
+
+    uint_least32_t cTimeMs = _engine->player.timeMs();
+    const bool seekingBackwards = cTimeMs >= timeMs;
+
+    // Continue from the nearest earlier checkpoint (if it's closer than the current position) rather than from the beginning.
+    if (TryRestoreCheckpoint(timeMs, (seekingBackwards) ? 0 : cTimeMs))
     {
-        _sidEngine.stop();
+        cTimeMs = _engine->player.timeMs();
+    }
+    else if (seekingBackwards)
+    {
+        _engine->player.stop();
         cTimeMs = 0;
     }
 
     while (cTimeMs < timeMs)
     {
-        _sidEngine.play(nullptr, 0);
+        _engine->player.play(nullptr, 0);
 
         if (callback(cTimeMs, false))
         {
             return;
         }
 
-        cTimeMs = _sidEngine.timeMs();
+        cTimeMs = _engine->player.timeMs();
+    }
+
+    if (cTimeMs > _furthestTimeMs)
+    {
+        _furthestTimeMs = cTimeMs;
     }
 
     callback(cTimeMs, true);
 }
 
+void SidDecoder::SetSeekCheckpoints(uint_least32_t intervalMs, unsigned int maxCheckpoints)
+{
+    if (intervalMs == _checkpointIntervalMs && maxCheckpoints == _maxCheckpoints)
+    {
+        return;
+    }
+
+    StopCheckpointBuilder();
+
+    _checkpointIntervalMs = intervalMs;
+    _maxCheckpoints = maxCheckpoints;
+
+    StartCheckpointBuilder();
+}
+
 void SidDecoder::ToggleVoice(unsigned int sidNum, unsigned int voice, bool enable)
 {
+    std::lock_guard<std::mutex> lock(_engineMutex);
     _sidVoicesEnabledStatus.at(sidNum).at(voice) = enable;
-    _sidEngine.mute(sidNum, voice, !enable); // Reminder: mute has it inverted, hopefully they won't fix it and make this incorrect without us noticing :P
+    _engine->player.mute(sidNum, voice, !enable); // Reminder: mute has it inverted, hopefully they won't fix it and make this incorrect without us noticing :P
+}
+
+bool SidDecoder::TryGetSidRegisters(unsigned int sidNum, uint8_t (&outRegisters)[32]) const
+{
+    std::lock_guard<std::mutex> lock(_engineMutex);
+    return _engine->player.getSidStatus(sidNum, outRegisters);
 }
 
 void SidDecoder::UnloadActiveTune()
 {
+    StopCheckpointBuilder();
+
+    _checkpointsRequested = false;
+
     if (_tune != nullptr)
     {
-        _sidEngine.stop();
-        _sidEngine.load(0);
+        _engine->player.stop();
+        _engine->player.load(0);
         _tune = nullptr;
     }
 }
+
+bool SidDecoder::TryConfigureEngine(EmulationEngine& engine, const SidConfig& sidConfig) const
+{
+    // Check if builder is ok
+    if (!engine.builder.getStatus())
+    {
+        std::cerr << engine.builder.error() << std::endl;
+        return false;
+    }
+
+    SidConfig engineSidConfig = sidConfig;
+    engineSidConfig.sidEmulation = &engine.builder;
+
+    if (!engine.player.config(engineSidConfig))
+    {
+        std::cerr << engine.player.error() << std::endl;
+        return false;
+    }
+
+    engine.builder.filter6581Curve(_filterConfigCache->filter6581Curve);
+    engine.builder.filter8580Curve(_filterConfigCache->filter8580Curve);
+    engine.builder.filter(_filterConfigCache->filterEnabled);
+
+    engine.player.setRoms(RomOrNull(_romKernal), RomOrNull(_romBasic), RomOrNull(_romChargen));
+
+    return true;
+}
+
+void SidDecoder::ApplyVoicesEnabledStatus(EmulationEngine& engine) const
+{
+    for (unsigned int sidNum = 0; sidNum < _sidVoicesEnabledStatus.size(); ++sidNum)
+    {
+        for (unsigned int voice = 0; voice < _sidVoicesEnabledStatus.at(sidNum).size(); ++voice)
+        {
+            engine.player.mute(sidNum, voice, !_sidVoicesEnabledStatus.at(sidNum).at(voice));
+        }
+    }
+}
+
+void SidDecoder::StartCheckpointBuilder()
+{
+    if (!_checkpointsRequested || _checkpointIntervalMs == 0 || _maxCheckpoints == 0 || _filterConfigCache == nullptr || _tune == nullptr || !_tune->getStatus())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_checkpointMutex);
+        _checkpointSpacingMs = _checkpointIntervalMs;
+    }
+
+    _abortCheckpointsFlag = false;
+    _checkpointThread = std::thread(&SidDecoder::RunCheckpointBuilder, this, _sidConfigCache); // Reminder: the builder works with its own copy of the config.
+}
+
+void SidDecoder::StopCheckpointBuilder()
+{
+    if (_checkpointThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_checkpointMutex);
+            _abortCheckpointsFlag = true;
+        }
+
+        _checkpointCv.notify_all();
+        _checkpointThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(_checkpointMutex);
+    _checkpoints.clear();
+    _idleEngines.clear(); // Their tune/config/ROMs may be outdated now.
+}
+
+void SidDecoder::RunCheckpointBuilder(const SidConfig sidConfig)
+{
+    while (!_abortCheckpointsFlag)
+    {
+        std::unique_ptr<EmulationEngine> engine;
+        uint_least32_t slotTimeMs = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(_checkpointMutex);
+            UpdateCheckpointSpacing();
+
+            // Missing checkpoints within the already played part (seeking beyond it is a regular fast-forward anyway).
+            std::vector<uint_least32_t> missingSlots;
+            for (unsigned int i = 1; i <= _maxCheckpoints; ++i)
+            {
+                const uint_least32_t cSlotTimeMs = i * _checkpointSpacingMs;
+                if (cSlotTimeMs > _furthestTimeMs)
+                {
+                    break;
+                }
+
+                const bool exists = std::any_of(_checkpoints.begin(), _checkpoints.end(), [cSlotTimeMs](const SeekCheckpoint& checkpoint) { return checkpoint.slotTimeMs == cSlotTimeMs; });
+                if (!exists)
+                {
+                    missingSlots.push_back(cSlotTimeMs);
+                }
+            }
+
+            if (missingSlots.empty())
+            {
+                _checkpointCv.wait_for(lock, CHECKPOINT_BUILDER_IDLE_POLL, [this]() { return _abortCheckpointsFlag.load(); });
+                continue;
+            }
+
+            // Prefer continuing an idle engine to the nearest missing slot ahead of it (the least remaining emulation), only otherwise build the earliest missing slot from the beginning.
+            auto seed = _idleEngines.end();
+            for (auto it = _idleEngines.begin(); it != _idleEngines.end(); ++it)
+            {
+                const uint_least32_t cTimeMs = (*it)->player.timeMs();
+                const auto cSlot = std::lower_bound(missingSlots.begin(), missingSlots.end(), cTimeMs);
+                if (cSlot != missingSlots.end() && (seed == _idleEngines.end() || *cSlot - cTimeMs < slotTimeMs - (*seed)->player.timeMs()))
+                {
+                    seed = it;
+                    slotTimeMs = *cSlot;
+                }
+            }
+
+            if (seed != _idleEngines.end())
+            {
+                engine = std::move(*seed);
+                _idleEngines.erase(seed); // Reminder: the ones beyond every missing slot are kept for when the playback gets further.
+            }
+            else
+            {
+                slotTimeMs = missingSlots.front();
+            }
+        }
+
+        if (engine == nullptr)
+        {
+            engine = std::make_unique<EmulationEngine>();
+            if (!TryConfigureEngine(*engine, sidConfig) || !engine->player.load(_tune.get()))
+            {
+                return; // Shouldn't happen since the active engine got through the same.
+            }
+        }
+
+        // Emulate up to the checkpoint (no output).
+        while (!_abortCheckpointsFlag && engine->player.timeMs() < slotTimeMs)
+        {
+            engine->player.play(nullptr, 0);
+        }
+
+        if (_abortCheckpointsFlag)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_checkpointMutex);
+        ParkEngine(std::move(engine)); // Reminder: a restore may have parked its displaced engine into the same slot meanwhile.
+    }
+}
+
+bool SidDecoder::TryRestoreCheckpoint(uint_least32_t targetTimeMs, uint_least32_t mustExceedTimeMs)
+{
+    std::lock_guard<std::mutex> lock(_checkpointMutex);
+
+    // Find the latest checkpoint not beyond the target.
+    auto nearest = _checkpoints.end();
+    for (auto it = _checkpoints.begin(); it != _checkpoints.end(); ++it)
+    {
+        const uint_least32_t checkpointTimeMs = it->engine->player.timeMs();
+        if (checkpointTimeMs <= targetTimeMs && checkpointTimeMs > mustExceedTimeMs)
+        {
+            nearest = it;
+        }
+    }
+
+    if (nearest == _checkpoints.end())
+    {
+        return false;
+    }
+
+    // Reminder: libsidplayfp can't copy an engine, so the restored one is consumed (the builder re-creates its slot, possibly from the displaced engine).
+    std::unique_ptr<EmulationEngine> restored = std::move(nearest->engine);
+    _checkpoints.erase(nearest);
+
+    std::unique_ptr<EmulationEngine> displaced;
+    {
+        std::lock_guard<std::mutex> engineLock(_engineMutex);
+        ApplyVoicesEnabledStatus(*restored);
+        displaced = std::move(_engine);
+        _engine = std::move(restored);
+    }
+
+    ParkEngine(std::move(displaced));
+    _checkpointCv.notify_all();
+
+    return true;
+}
+
+void SidDecoder::UpdateCheckpointSpacing()
+{
+    while (_furthestTimeMs > static_cast<uint_least64_t>(_maxCheckpoints) * _checkpointSpacingMs && _checkpointSpacingMs <= UINT_LEAST32_MAX / 2)
+    {
+        _checkpointSpacingMs *= 2;
+
+        // Reminder: the even slots are kept as they are, the dropped engines may still serve as the builder's starting points.
+        std::vector<std::unique_ptr<EmulationEngine>> dropped;
+        for (auto it = _checkpoints.begin(); it != _checkpoints.end();)
+        {
+            if (it->slotTimeMs % _checkpointSpacingMs != 0)
+            {
+                dropped.emplace_back(std::move(it->engine));
+                it = _checkpoints.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (std::unique_ptr<EmulationEngine>& engine : dropped)
+        {
+            ParkEngine(std::move(engine));
+        }
+    }
+}
+
+void SidDecoder::ParkEngine(std::unique_ptr<EmulationEngine> engine)
+{
+    const uint_least32_t timeMs = engine->player.timeMs();
+    const uint_least32_t slotTimeMs = timeMs - timeMs % _checkpointSpacingMs;
+
+    const bool isVacantSlot = slotTimeMs > 0 && timeMs - slotTimeMs <= CHECKPOINT_PARK_TOLERANCE_MS && slotTimeMs <= static_cast<uint_least64_t>(_maxCheckpoints) * _checkpointSpacingMs &&
+                              std::none_of(_checkpoints.begin(), _checkpoints.end(), [slotTimeMs](const SeekCheckpoint& checkpoint) { return checkpoint.slotTimeMs == slotTimeMs; });
+
+    if (isVacantSlot)
+    {
+        const auto it = std::find_if(_checkpoints.begin(), _checkpoints.end(), [slotTimeMs](const SeekCheckpoint& checkpoint) { return checkpoint.slotTimeMs > slotTimeMs; });
+        _checkpoints.insert(it, SeekCheckpoint{slotTimeMs, std::move(engine)});
+        return;
+    }
+
+    _idleEngines.emplace_back(std::move(engine));
+    if (_idleEngines.size() > MAX_IDLE_ENGINES)
+    {
+        _idleEngines.erase(_idleEngines.begin()); // Oldest one.
+    }
+}
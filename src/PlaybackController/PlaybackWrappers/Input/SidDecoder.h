@@ -27,7 +27,12 @@
 #include <sidplayfp/SidTune.h>
 #include <sidplayfp/builders/residfp.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 class SidDecoder : public IBufferWriter
@@ -64,10 +69,39 @@ public:
 
     using SidVoicesEnabledStatus = std::vector< std::vector<bool> >;
 
+    /// @brief Copy of the emulation engine's SidInfo (the engine itself may get swapped for a seek checkpoint's at any time).
+    struct EngineInfo
+    {
+        std::string name;
+        std::string version;
+        std::string speedString;
+        std::string kernalDesc;
+        std::string basicDesc;
+        std::string chargenDesc;
+    };
+
+private:
+    struct EmulationEngine
+    {
+        EmulationEngine();
+        EmulationEngine(EmulationEngine&) = delete;
+
+        sidplayfp player;
+        ReSIDfpBuilder builder;
+    };
+
+    struct SeekCheckpoint
+    {
+        uint_least32_t slotTimeMs; // Nominal time, the engine itself may be slightly past it.
+        std::unique_ptr<EmulationEngine> engine;
+    };
+
 public:
     SidDecoder();
     SidDecoder(SidDecoder&) = delete;
 
+    ~SidDecoder();
+
 public:
     bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override;
 
@@ -77,12 +111,21 @@ public:
 
     bool TryInitSidDatabase(const std::wstring& songlengthsFilename);
 
+    /// @brief Shares the (already initialized) Songlengths database of another instance rather than loading its own copy.
+    void UseSidDatabaseOf(const SidDecoder& other);
+
+    /// @brief Identifies the version of the loaded Songlengths database (0 if none).
+    uint_least64_t GetSidDatabaseStamp() const;
+
     RomUtil::RomStatus TrySetRoms(const std::wstring& pathKernal, const std::wstring& pathBasic, const std::wstring& pathChargen);
 
     // Unicode paths not supported for filepath variant, rather use the oneFileFormatSidtune variant and do custom file loading.
     bool TryLoadSong(const char* filepath, unsigned int subsong = 0);
     bool TryLoadSong(const uint_least8_t* oneFileFormatSidtune, uint_least32_t sidtuneLength, unsigned int subsong = 0);
 
+    /// @brief Info-only variant of TryLoadSong: just parses the tune (selecting its default subsong) without loading it into the emulation engine. Call TrySetSubsong before any playback.
+    bool TryLoadSongInfo(const uint_least8_t* oneFileFormatSidtune, uint_least32_t sidtuneLength);
+
     bool TrySetSubsong(unsigned int subsong);
     void Stop();
 
@@ -91,30 +134,74 @@ public:
     int GetDefaultSubsong() const;
     int GetTotalSubsongs() const;
     int_least32_t TryGetActiveSongDuration() const;
+
+    /// @brief Durations of all subsongs of the loaded tune (in subsong order, hashing the tune only once). Empty if unknown.
+    std::vector<uint_least32_t> GetAllSubsongDurations() const;
+
+    /// @brief Same as above but skips the hashing by using an already computed MD5 of the whole tune file.
+    std::vector<uint_least32_t> GetAllSubsongDurations(const Md5Lanes::Digest& precomputedMd5) const;
     std::string GetCurrentTuneInfoString(SongInfoCategory category) const;
     const SidTuneInfo& GetCurrentSongInfo() const;
     RomRequirement GetCurrentSongRomRequirement() const;
     int GetCurrentTuneSidChipsRequired() const;
 
-    const SidInfo& GetEngineInfo() const;
+    EngineInfo GetEngineInfo() const;
     const SidVoicesEnabledStatus& GetSidVoicesEnabledStatus() const;
     const SidConfig& GetSidConfig() const;
     const FilterConfig& GetFilterConfig() const;
 
     void SeekTo(uint_least32_t timeMs, const SeekStatusCallback& callback);
+
+    /// @brief Keeps restartable emulation checkpoints (parked at every intervalMs of the already played part, prepared in a background thread from the first seek on) so seeking doesn't need to re-emulate from the beginning. Pass 0 to disable.
+    /// Once the played part outgrows the maxCheckpoints, the interval doubles (dropping every other checkpoint), so the whole played part stays covered.
+    void SetSeekCheckpoints(uint_least32_t intervalMs, unsigned int maxCheckpoints);
     void ToggleVoice(unsigned int sidNum, unsigned int voice, bool enable);
 
+    /// @brief Copies the last values written to the registers of a SID chip (sidNum is 0-based). Returns false if there's no such chip.
+    bool TryGetSidRegisters(unsigned int sidNum, uint8_t (&outRegisters)[32]) const;
+
     void UnloadActiveTune();
 
 private:
     void PrepareLoadSong();
 
+    bool TryConfigureEngine(EmulationEngine& engine, const SidConfig& sidConfig) const;
+    void ApplyVoicesEnabledStatus(EmulationEngine& engine) const;
+
+    void StartCheckpointBuilder();
+    void StopCheckpointBuilder();
+    void RunCheckpointBuilder(const SidConfig sidConfig);
+    bool TryRestoreCheckpoint(uint_least32_t targetTimeMs, uint_least32_t mustExceedTimeMs);
+
+    /// @brief Doubles the _checkpointSpacingMs (dropping the checkpoints in between) until the slots cover the whole played part. Call while holding the _checkpointMutex.
+    void UpdateCheckpointSpacing();
+
+    /// @brief Keeps an engine displaced by a restore as a checkpoint if it's (nearly) at a vacant slot, otherwise as the builder's starting point for the next slot. Call while holding the _checkpointMutex.
+    void ParkEngine(std::unique_ptr<EmulationEngine> engine);
+
 private:
     SidConfig _sidConfigCache;
     std::unique_ptr<FilterConfig> _filterConfigCache;
     SidVoicesEnabledStatus _sidVoicesEnabledStatus;
-    sidplayfp _sidEngine;
+    std::unique_ptr<EmulationEngine> _engine; // Reminder: swapped (on seek) only while holding the _engineMutex, which the calls from the other (e.g., UI) threads hold as well.
+    mutable std::mutex _engineMutex;
     std::unique_ptr<SidTune> _tune;
-    ReSIDfpBuilder _rs;
-    Songlengths _sidDatabase;
+    std::shared_ptr<const Songlengths> _sidDatabase;
+
+    std::vector<uint8_t> _romKernal;
+    std::vector<uint8_t> _romBasic;
+    std::vector<uint8_t> _romChargen;
+
+    // Seek checkpoints
+    uint_least32_t _checkpointIntervalMs = 0;
+    unsigned int _maxCheckpoints = 0;
+    uint_least32_t _checkpointSpacingMs = 0; // Between the slots: the _checkpointIntervalMs doubled as many times as the played part needs.
+    std::vector<SeekCheckpoint> _checkpoints; // Sorted by time.
+    std::vector<std::unique_ptr<EmulationEngine>> _idleEngines; // Displaced by the restores, the builder continues these to the next missing slot rather than emulating from the beginning.
+    std::atomic_uint_least32_t _furthestTimeMs = 0;
+    bool _checkpointsRequested = false; // Set by the first seek of the song, the builder doesn't run before that.
+    std::thread _checkpointThread;
+    std::atomic_bool _abortCheckpointsFlag = false;
+    std::condition_variable _checkpointCv;
+    mutable std::mutex _checkpointMutex;
 };
@@ -18,10 +18,13 @@
 
 #include "Songlengths.h"
 #include "../../../Util/Const.h"
-#include "../../../Util/HelpersGeneral.h"
 #include <sidplayfp/SidTuneInfo.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <vector>
+#include <limits>
+#include <stdexcept>
 
 static constexpr uint_least8_t MD5_LEN = 32; // Standard length of MD5 hashes is 32 characters.
 
@@ -33,65 +36,67 @@ static constexpr const char CHAR_SUBSONG_DURATION_SEPARATOR = ' ';
 
 static constexpr const char* const INI_SECTION_DATABASE = "[Database]";
 
+static constexpr size_t INITIAL_TABLE_SIZE = 1024;
+
+static constexpr const wchar_t* const COMPILED_FILE_SUFFIX = L".bin";
+static constexpr const char COMPILED_MAGIC[8] = {'S', 'L', 'D', 'B', 'B', 'I', 'N', '\0'};
+static constexpr uint_least32_t COMPILED_VERSION = 1;
+
 // -----------------------------------------------------------
 
 bool Songlengths::TryLoad(const std::wstring& songlengthsMd5Filepath)
 {
 	Unload();
 
-	std::ifstream file(songlengthsMd5Filepath.c_str());
-
-	bool inDatabaseSection = false;
-	std::string line;
-
-	while (std::getline(file, line))
+	if (!TryLoadCompiled(songlengthsMd5Filepath))
 	{
-		const char& firstChar = line.front();
-
-		// Ignore comments
-		if (firstChar == CHAR_INI_COMMENT)
-		{
-			continue;
-		}
-
-		// Ignore if not within Database section(s)
-		if (firstChar == CHAR_INI_SECTION)
+		if (!TryLoadText(songlengthsMd5Filepath))
 		{
-			inDatabaseSection = line == INI_SECTION_DATABASE;
-			continue;
+			return false;
 		}
 
-		if (!inDatabaseSection)
-		{
-			continue;
-		}
+		TrySaveCompiled(songlengthsMd5Filepath); // Failure is not critical (e.g., read-only location), the text will just be parsed again next time.
+	}
 
-		// Ignore if the line doesn't appear to contain MD5 hash and duration
-		if (line.length() > MD5_LEN && line.at(MD5_LEN) != CHAR_HASH_DURATION_SEPARATOR)
-		{
-			continue;
-		}
+	uint_least64_t sourceSize = 0;
+	int_least64_t sourceModifiedTime = 0;
+	if (TryGetSourceStamp(songlengthsMd5Filepath, sourceSize, sourceModifiedTime))
+	{
+		_sourceStamp = (sourceSize * 0x9E3779B97F4A7C15ull) ^ static_cast<uint_least64_t>(sourceModifiedTime);
+	}
 
-		// ---------------------------------------------------
+	return true;
+}
 
-		const std::string& md5Value = line.substr(0, MD5_LEN);
-		const std::string& durations = line.substr(MD5_LEN + 1);
-		_database[md5Value] = durations;
+void Songlengths::Unload()
+{
+	{
+		std::lock_guard<std::mutex> lock(_durationsCacheMutex);
+		_durationsCache.clear();
 	}
 
-	file.close();
+	_table.clear();
+	_table.shrink_to_fit();
+	_entryCount = 0;
+	_file.Close();
 
-	return IsLoaded();
+	_compiledEntries = nullptr;
+	_compiledDurations = nullptr;
+	_compiledEntryCount = 0;
+	_compiledDurationCount = 0;
+	_compiledFile.Close();
+
+	_sourceStamp = 0;
 }
 
-void Songlengths::Unload()
+bool Songlengths::IsLoaded() const
 {
-	_database.clear();
+	return _entryCount != 0 || _compiledEntryCount != 0;
 }
 
-bool Songlengths::IsLoaded() const
+uint_least64_t Songlengths::GetSourceStamp() const
 {
-	return !_database.empty();
+	return (IsLoaded()) ? _sourceStamp : 0;
 }
 
 // mm:ss[.SSS]
@@ -106,63 +111,472 @@ bool Songlengths::IsLoaded() const
 //
 uint_least32_t Songlengths::GetDurationMs(const std::string& preformattedDuration)
 {
-	// Convert string duration to integers
-	std::vector<std::string> subsongDurationSliced = Helpers::General::SplitString(preformattedDuration, ':');
-	const std::string& secondsRaw = subsongDurationSliced.back();
-	const bool hasMillis = secondsRaw.find('.') != std::string::npos;
+	return ParseDurationMs(preformattedDuration.data(), preformattedDuration.data() + preformattedDuration.size());
+}
+
+uint_least32_t Songlengths::GetDurationMs(SidTune& tune) const
+{
+	if (!IsLoaded())
+	{
+		throw std::runtime_error("Database wasn't loaded!");
+	}
+
+	// Sanity checks
+	const char* md5String = tune.createMD5New();
+	Md5 md5;
+	if (md5String == 0 || !TryParseMd5(md5String, md5))
+	{
+		return 0; // Tune wasn't loaded.
+	}
 
-	int minutes = stoi(subsongDurationSliced.front());
-	int seconds = 0;
-	int extraMillis = 0;
+	const unsigned int subsongOrder = tune.getInfo()->currentSong();
+	if (subsongOrder == 0)
+	{
+		return 0; // Tune hasn't been initialized.
+	}
 
-	if (hasMillis)
+	if (_compiledEntryCount != 0)
 	{
-		std::vector<std::string> secondsMillis = Helpers::General::SplitString(secondsRaw, '.');
-		seconds = stoi(secondsMillis.front());
-		extraMillis = stoi(secondsMillis.back());
+		return GetCompiledDurationMs(md5, subsongOrder);
 	}
-	else
+
+	const Entry* entry = Find(md5);
+	if (entry == nullptr)
 	{
-		seconds = stoi(secondsRaw);
+		return 0; // No tune in database.
 	}
 
-	// Convert integer duration to milliseconds
-	return (minutes * Const::MILLISECONDS_IN_MINUTE) + (seconds * Const::MILLISECONDS_IN_SECOND) + extraMillis;
+	std::lock_guard<std::mutex> lock(_durationsCacheMutex);
+
+	const SubsongDurations& subsongsDurations = GetCachedSubsongDurations(*entry);
+	if (subsongsDurations.size() < subsongOrder)
+	{
+		return 0; // Database doesn't contain this subsong.
+	}
+
+	return subsongsDurations.at(subsongOrder - 1);
 }
 
-uint_least32_t Songlengths::GetDurationMs(SidTune& tune) const
+Songlengths::SubsongDurations Songlengths::GetSubsongDurationsMs(SidTune& tune) const
 {
-	if (_database.empty())
+	if (!IsLoaded())
 	{
 		throw std::runtime_error("Database wasn't loaded!");
 	}
 
-	// Sanity checks
-	const char* md5 = tune.createMD5New();
-	if (md5 == 0)
+	const char* md5String = tune.createMD5New();
+	Md5 md5;
+	if (md5String == 0 || !TryParseMd5(md5String, md5))
 	{
-		return 0; // Tune wasn't loaded.
+		return SubsongDurations(); // Tune wasn't loaded.
 	}
 
-	const auto& it = _database.find(md5);
-	if (it == _database.end())
+	return GetSubsongDurationsMs(md5);
+}
+
+Songlengths::SubsongDurations Songlengths::GetSubsongDurationsMs(const Md5Lanes::Digest& md5) const
+{
+	if (!IsLoaded())
 	{
-		return 0; // No tune in database.
+		throw std::runtime_error("Database wasn't loaded!");
 	}
 
-	const unsigned int subsongOrder = tune.getInfo()->currentSong();
-	if (subsongOrder == 0)
+	Md5 key;
+	for (size_t i = 0; i < md5.size(); ++i)
 	{
-		return 0; // Tune hasn't been initialized.
+		uint_least64_t& half = (i < md5.size() / 2) ? key.high : key.low;
+		half = (half << 8) | md5[i];
 	}
 
-	const std::string& durationsRaw = it->second;
-	std::vector<std::string> subsongsDurations = Helpers::General::SplitString(durationsRaw, CHAR_SUBSONG_DURATION_SEPARATOR);
-	if (subsongsDurations.size() < subsongOrder)
+	return GetSubsongDurationsMs(key);
+}
+
+Songlengths::SubsongDurations Songlengths::GetSubsongDurationsMs(const Md5& md5) const
+{
+	if (_compiledEntryCount != 0)
+	{
+		const CompiledEntry* entry = FindCompiled(md5);
+		if (entry == nullptr)
+		{
+			return SubsongDurations(); // No tune in database.
+		}
+
+		const uint_least32_t* const first = _compiledDurations + entry->firstDuration;
+		return SubsongDurations(first, first + entry->subsongCount);
+	}
+
+	const Entry* entry = Find(md5);
+	if (entry == nullptr)
+	{
+		return SubsongDurations(); // No tune in database.
+	}
+
+	std::lock_guard<std::mutex> lock(_durationsCacheMutex);
+	return GetCachedSubsongDurations(*entry);
+}
+
+bool Songlengths::TryLoadText(const std::wstring& songlengthsMd5Filepath)
+{
+	if (!_file.TryOpen(songlengthsMd5Filepath) || _file.GetSize() > std::numeric_limits<uint_least32_t>::max())
+	{
+		_file.Close();
+		return false;
+	}
+
+	_table.resize(INITIAL_TABLE_SIZE);
+
+	const char* const data = _file.GetData();
+	const char* const dataEnd = data + _file.GetSize();
+	bool inDatabaseSection = false;
+
+	for (const char* line = data; line < dataEnd;)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(line, '\n', dataEnd - line));
+		const char* const nextLine = (lineEnd == nullptr) ? dataEnd : lineEnd + 1;
+		if (lineEnd == nullptr)
+		{
+			lineEnd = dataEnd;
+		}
+
+		if (lineEnd > line && *(lineEnd - 1) == '\r')
+		{
+			--lineEnd;
+		}
+
+		const size_t lineLength = lineEnd - line;
+		const char firstChar = (lineLength > 0) ? line[0] : '\0';
+
+		// Ignore if not within Database section(s)
+		if (firstChar == CHAR_INI_SECTION)
+		{
+			const size_t sectionLength = strlen(INI_SECTION_DATABASE);
+			inDatabaseSection = lineLength == sectionLength && memcmp(line, INI_SECTION_DATABASE, sectionLength) == 0;
+		}
+		else if (inDatabaseSection && firstChar != CHAR_INI_COMMENT && lineLength > MD5_LEN && line[MD5_LEN] == CHAR_HASH_DURATION_SEPARATOR) // Ignore comments and lines which don't appear to contain MD5 hash and duration.
+		{
+			Md5 md5;
+			if (TryParseMd5(line, md5))
+			{
+				const char* const durations = line + MD5_LEN + 1;
+				Insert(md5, static_cast<uint_least32_t>(durations - data), static_cast<uint_least32_t>(lineEnd - durations));
+			}
+		}
+
+		line = nextLine;
+	}
+
+	if (!IsLoaded())
+	{
+		Unload();
+	}
+
+	return IsLoaded();
+}
+
+bool Songlengths::TryParseMd5(const char* hexString, Md5& out)
+{
+	out = Md5();
+	for (uint_least8_t i = 0; i < MD5_LEN; ++i)
+	{
+		const char c = hexString[i];
+		uint_least64_t nibble = 0;
+
+		if (c >= '0' && c <= '9')
+		{
+			nibble = c - '0';
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			nibble = c - 'a' + 10;
+		}
+		else if (c >= 'A' && c <= 'F')
+		{
+			nibble = c - 'A' + 10;
+		}
+		else
+		{
+			return false; // Also catches a premature null-terminator.
+		}
+
+		uint_least64_t& half = (i < MD5_LEN / 2) ? out.high : out.low;
+		half = (half << 4) | nibble;
+	}
+
+	return true;
+}
+
+uint_least32_t Songlengths::ParseDurationMs(const char* begin, const char* end)
+{
+	uint_least32_t fields[3] = {}; // Minutes, seconds, extra millis.
+	int field = 0;
+
+	for (const char* c = begin; c < end; ++c)
+	{
+		if (*c >= '0' && *c <= '9')
+		{
+			fields[field] = (fields[field] * 10) + (*c - '0');
+		}
+		else if (*c == ':' && field == 0)
+		{
+			field = 1;
+		}
+		else if (*c == '.' && field == 1)
+		{
+			field = 2;
+		}
+		else
+		{
+			break; // E.g., an old-style attribute suffix.
+		}
+	}
+
+	// Convert integer duration to milliseconds
+	return (fields[0] * Const::MILLISECONDS_IN_MINUTE) + (fields[1] * Const::MILLISECONDS_IN_SECOND) + fields[2];
+}
+
+std::wstring Songlengths::GetCompiledFilepath(const std::wstring& songlengthsMd5Filepath)
+{
+	return songlengthsMd5Filepath + COMPILED_FILE_SUFFIX;
+}
+
+bool Songlengths::TryGetSourceStamp(const std::wstring& songlengthsMd5Filepath, uint_least64_t& outSize, int_least64_t& outModifiedTime)
+{
+	std::error_code ec;
+	const std::filesystem::path source(songlengthsMd5Filepath);
+
+	outSize = std::filesystem::file_size(source, ec);
+	if (ec)
+	{
+		return false;
+	}
+
+	const std::filesystem::file_time_type modifiedTime = std::filesystem::last_write_time(source, ec);
+	outModifiedTime = static_cast<int_least64_t>(modifiedTime.time_since_epoch().count());
+	return !ec;
+}
+
+bool Songlengths::TryLoadCompiled(const std::wstring& songlengthsMd5Filepath)
+{
+	static_assert(sizeof(CompiledHeader) % alignof(CompiledEntry) == 0 && sizeof(CompiledEntry) % alignof(uint_least32_t) == 0);
+
+	uint_least64_t sourceSize = 0;
+	int_least64_t sourceModifiedTime = 0;
+	if (!TryGetSourceStamp(songlengthsMd5Filepath, sourceSize, sourceModifiedTime) || !_compiledFile.TryOpen(GetCompiledFilepath(songlengthsMd5Filepath)))
+	{
+		return false;
+	}
+
+	CompiledHeader header{};
+	const bool hasHeader = _compiledFile.GetSize() >= sizeof(CompiledHeader);
+	if (hasHeader)
+	{
+		memcpy(&header, _compiledFile.GetData(), sizeof(CompiledHeader));
+	}
+
+	const uint_least64_t expectedSize = sizeof(CompiledHeader) + static_cast<uint_least64_t>(header.entryCount) * sizeof(CompiledEntry) + static_cast<uint_least64_t>(header.durationCount) * sizeof(uint_least32_t);
+	const bool isValid = hasHeader &&
+		memcmp(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC)) == 0 &&
+		header.version == COMPILED_VERSION &&
+		header.sourceSize == sourceSize &&
+		header.sourceModifiedTime == sourceModifiedTime && // Source changed otherwise, so it'll be regenerated.
+		header.entryCount != 0 &&
+		_compiledFile.GetSize() == expectedSize;
+
+	if (!isValid)
+	{
+		_compiledFile.Close();
+		return false;
+	}
+
+	_compiledEntries = reinterpret_cast<const CompiledEntry*>(_compiledFile.GetData() + sizeof(CompiledHeader));
+	_compiledDurations = reinterpret_cast<const uint_least32_t*>(_compiledEntries + header.entryCount);
+	_compiledEntryCount = header.entryCount;
+	_compiledDurationCount = header.durationCount;
+	return true;
+}
+
+bool Songlengths::TrySaveCompiled(const std::wstring& songlengthsMd5Filepath) const
+{
+	CompiledHeader header{};
+	if (!TryGetSourceStamp(songlengthsMd5Filepath, header.sourceSize, header.sourceModifiedTime))
+	{
+		return false;
+	}
+
+	// Parse everything
+	std::vector<CompiledEntry> entries;
+	std::vector<uint_least32_t> durations;
+	entries.reserve(_entryCount);
+
+	for (const Entry& entry : _table)
+	{
+		if (entry.durationsOffset != 0)
+		{
+			const SubsongDurations subsongsDurations = ParseSubsongDurations(entry);
+			entries.push_back({entry.md5.high, entry.md5.low, static_cast<uint_least32_t>(durations.size()), static_cast<uint_least32_t>(subsongsDurations.size())});
+			durations.insert(durations.end(), subsongsDurations.begin(), subsongsDurations.end());
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const CompiledEntry& a, const CompiledEntry& b)
+	{
+		return (a.md5High != b.md5High) ? a.md5High < b.md5High : a.md5Low < b.md5Low;
+	});
+
+	memcpy(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+	header.version = COMPILED_VERSION;
+	header.entryCount = static_cast<uint_least32_t>(entries.size());
+	header.durationCount = static_cast<uint_least32_t>(durations.size());
+
+	// Write into a temporary file first, so a partially written one is never picked up
+	const std::filesystem::path compiledFilepath(GetCompiledFilepath(songlengthsMd5Filepath));
+	std::filesystem::path tempFilepath(compiledFilepath);
+	tempFilepath += L".tmp";
+
+	std::error_code ec;
+	{
+		std::ofstream file(tempFilepath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CompiledHeader));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CompiledEntry));
+		file.write(reinterpret_cast<const char*>(durations.data()), durations.size() * sizeof(uint_least32_t));
+
+		if (!file)
+		{
+			file.close();
+			std::filesystem::remove(tempFilepath, ec);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempFilepath, compiledFilepath, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tempFilepath, ec);
+		return false;
+	}
+
+	return true;
+}
+
+Songlengths::SubsongDurations Songlengths::ParseSubsongDurations(const Entry& entry) const
+{
+	SubsongDurations subsongsDurations;
+	const char* const durationsEnd = _file.GetData() + entry.durationsOffset + entry.durationsLength;
+	const char* duration = _file.GetData() + entry.durationsOffset;
+
+	while (duration < durationsEnd)
+	{
+		const char* separator = static_cast<const char*>(memchr(duration, CHAR_SUBSONG_DURATION_SEPARATOR, durationsEnd - duration));
+		if (separator == nullptr)
+		{
+			separator = durationsEnd;
+		}
+
+		if (separator > duration) // Skip repeated separators.
+		{
+			subsongsDurations.emplace_back(ParseDurationMs(duration, separator));
+		}
+
+		duration = separator + 1;
+	}
+
+	return subsongsDurations;
+}
+
+const Songlengths::SubsongDurations& Songlengths::GetCachedSubsongDurations(const Entry& entry) const
+{
+	auto it = _durationsCache.find(&entry - _table.data());
+	if (it == _durationsCache.end())
+	{
+		it = _durationsCache.emplace(&entry - _table.data(), ParseSubsongDurations(entry)).first;
+	}
+
+	return it->second;
+}
+
+const Songlengths::CompiledEntry* Songlengths::FindCompiled(const Md5& md5) const
+{
+	const CompiledEntry* const entriesEnd = _compiledEntries + _compiledEntryCount;
+	const CompiledEntry* const entry = std::lower_bound(_compiledEntries, entriesEnd, md5, [](const CompiledEntry& a, const Md5& b)
+	{
+		return (a.md5High != b.high) ? a.md5High < b.high : a.md5Low < b.low;
+	});
+
+	if (entry == entriesEnd || entry->md5High != md5.high || entry->md5Low != md5.low)
+	{
+		return nullptr;
+	}
+
+	if (static_cast<uint_least64_t>(entry->firstDuration) + entry->subsongCount > _compiledDurationCount)
+	{
+		return nullptr; // Corrupt entry.
+	}
+
+	return entry;
+}
+
+uint_least32_t Songlengths::GetCompiledDurationMs(const Md5& md5, unsigned int subsongOrder) const
+{
+	const CompiledEntry* const entry = FindCompiled(md5);
+	if (entry == nullptr)
+	{
+		return 0; // No tune in database.
+	}
+
+	if (entry->subsongCount < subsongOrder)
 	{
 		return 0; // Database doesn't contain this subsong.
 	}
 
-	const std::string& preformattedDuration = subsongsDurations.at(subsongOrder - 1);
-	return GetDurationMs(preformattedDuration);
+	return _compiledDurations[entry->firstDuration + subsongOrder - 1];
+}
+
+void Songlengths::Insert(const Md5& md5, uint_least32_t durationsOffset, uint_least32_t durationsLength)
+{
+	// Keep the load factor at 50% at most
+	if ((_entryCount + 1) * 2 > _table.size())
+	{
+		std::vector<Entry> oldTable(_table.size() * 2);
+		oldTable.swap(_table);
+		_entryCount = 0;
+
+		for (const Entry& entry : oldTable)
+		{
+			if (entry.durationsOffset != 0)
+			{
+				Insert(entry.md5, entry.durationsOffset, entry.durationsLength);
+			}
+		}
+	}
+
+	// Linear probing (MD5 is uniformly distributed, so its bits are the hash)
+	const size_t mask = _table.size() - 1;
+	for (size_t slot = md5.low & mask;; slot = (slot + 1) & mask)
+	{
+		Entry& entry = _table[slot];
+		if (entry.durationsOffset == 0 || entry.md5 == md5) // Reminder: duplicate entries are overwritten (last one wins).
+		{
+			_entryCount += (entry.durationsOffset == 0) ? 1 : 0;
+			entry = {md5, durationsOffset, durationsLength};
+			return;
+		}
+	}
+}
+
+const Songlengths::Entry* Songlengths::Find(const Md5& md5) const
+{
+	const size_t mask = _table.size() - 1;
+	for (size_t slot = md5.low & mask;; slot = (slot + 1) & mask)
+	{
+		const Entry& entry = _table[slot];
+		if (entry.durationsOffset == 0)
+		{
+			return nullptr;
+		}
+
+		if (entry.md5 == md5)
+		{
+			return &entry;
+		}
+	}
 }
@@ -20,14 +20,23 @@
 
 // This is used instead of the libsidplayfp's SidDatabase which unfortunately segfaults when rapidly reading songlengths of huge amount of tunes from the Zip files (data from buffer).
 
+#include "../../Util/Md5Lanes.h"
+#include "../../../Util/MappedFile.h"
 #include <sidplayfp/SidTune.h>
 
 #include <cstdint>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+/// @brief Songlengths.md5 database. The file stays memory-mapped and is indexed by binary MD5 in an open-addressing table, subsong durations are parsed only when first needed.
+/// A compiled binary sidecar (sorted MD5 keys and packed durations) is written next to it, so the subsequent loads just map and binary-search that one (until the source file changes).
 class Songlengths
 {
+public:
+	using SubsongDurations = std::vector<uint_least32_t>;
+
 public:
     Songlengths() = default;
 
@@ -37,12 +46,87 @@ public:
 
     bool IsLoaded() const;
 
+	/// @brief Identifies the version (size & modification time) of the loaded database file. Returns 0 if not loaded.
+	uint_least64_t GetSourceStamp() const;
+
     static uint_least32_t GetDurationMs(const std::string& preformattedDuration);
     uint_least32_t GetDurationMs(SidTune& tune) const;
 
+	/// @brief Durations of all subsongs of the tune (in subsong order) computing its MD5 just once. Returns an empty vector if the tune isn't in the database.
+	SubsongDurations GetSubsongDurationsMs(SidTune& tune) const;
+
+	/// @brief Same as above but with an already computed MD5 of the whole tune file (e.g., by the batch hashing).
+	SubsongDurations GetSubsongDurationsMs(const Md5Lanes::Digest& md5) const;
+
 private:
-	using MD5 = std::string;
-	using DurationString = std::string;
+	struct Md5
+	{
+		uint_least64_t high = 0;
+		uint_least64_t low = 0;
+
+		bool operator==(const Md5& other) const { return high == other.high && low == other.low; }
+	};
+
+	struct Entry
+	{
+		Md5 md5;
+		uint_least32_t durationsOffset = 0; // Offset of the durations text within the mapped file. Reminder: 0 means an empty slot (can't be valid since a line starts with an MD5).
+		uint_least32_t durationsLength = 0;
+	};
+
+	// Compiled sidecar file layout: header, entries (sorted by MD5), packed durations.
+	struct CompiledHeader
+	{
+		char magic[8];
+		uint_least32_t version;
+		uint_least32_t entryCount;
+		uint_least64_t sourceSize;
+		int_least64_t sourceModifiedTime;
+		uint_least32_t durationCount;
+		uint_least32_t reserved;
+	};
+
+	struct CompiledEntry
+	{
+		uint_least64_t md5High;
+		uint_least64_t md5Low;
+		uint_least32_t firstDuration; // Index into the packed durations.
+		uint_least32_t subsongCount;
+	};
+
+private:
+	static bool TryParseMd5(const char* hexString, Md5& out);
+	static uint_least32_t ParseDurationMs(const char* begin, const char* end);
+	static std::wstring GetCompiledFilepath(const std::wstring& songlengthsMd5Filepath);
+	static bool TryGetSourceStamp(const std::wstring& songlengthsMd5Filepath, uint_least64_t& outSize, int_least64_t& outModifiedTime);
+
+	bool TryLoadText(const std::wstring& songlengthsMd5Filepath);
+	bool TryLoadCompiled(const std::wstring& songlengthsMd5Filepath);
+	bool TrySaveCompiled(const std::wstring& songlengthsMd5Filepath) const;
+
+	SubsongDurations GetSubsongDurationsMs(const Md5& md5) const;
+	SubsongDurations ParseSubsongDurations(const Entry& entry) const;
+	const SubsongDurations& GetCachedSubsongDurations(const Entry& entry) const; // Reminder: _durationsCacheMutex must be held.
+
+	const CompiledEntry* FindCompiled(const Md5& md5) const;
+	uint_least32_t GetCompiledDurationMs(const Md5& md5, unsigned int subsongOrder) const;
+
+	void Insert(const Md5& md5, uint_least32_t durationsOffset, uint_least32_t durationsLength);
+	const Entry* Find(const Md5& md5) const;
+
+private:
+	uint_least64_t _sourceStamp = 0;
+
+	MappedFile _file;
+	std::vector<Entry> _table; // Reminder: size is always a power of two.
+	size_t _entryCount = 0;
+
+	MappedFile _compiledFile;
+	const CompiledEntry* _compiledEntries = nullptr;
+	const uint_least32_t* _compiledDurations = nullptr;
+	size_t _compiledEntryCount = 0;
+	size_t _compiledDurationCount = 0;
 
-	std::unordered_map<MD5, DurationString> _database;
+	mutable std::mutex _durationsCacheMutex;
+	mutable std::unordered_map<size_t, SubsongDurations> _durationsCache; // Per table slot.
 };
@@ -17,12 +17,20 @@
  */
 
 #include "PortAudioOutput.h"
+#include "../../Util/RealtimeUtil.h"
 #include <assert.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 
+static constexpr size_t VISUALIZATION_MAX_DELAY_LENGTH = 48000; // In samples: enough for the output latency of any sane configuration (e.g., 0.5 s of 48 kHz stereo).
+static constexpr uint_least32_t LOAD_HISTOGRAM_STEP_PERMILLE = 50;
+static constexpr size_t LOAD_HISTOGRAM_SIZE = 21; // The last one is for 100 % and beyond.
+static constexpr double HIGH_LOAD_PERCENTILE = 0.99;
+
 class VisualizationBuffer
 {
 public:
@@ -30,81 +38,135 @@ public:
     VisualizationBuffer(VisualizationBuffer&) = delete;
 	VisualizationBuffer& operator=(const VisualizationBuffer&) = delete;
 
-    explicit VisualizationBuffer(size_t aLength) :
-        maxLength(aLength)
+    VisualizationBuffer(size_t aLength, bool lockMemory) :
+        maxLength(aLength),
+        _capacity(aLength + VISUALIZATION_MAX_DELAY_LENGTH)
     {
-        _first = new std::atomic_short[maxLength];
-        _second = new std::atomic_short[maxLength];
+        _ring = new std::atomic_short[_capacity];
+        _locked = lockMemory && RealtimeUtil::TryPrefaultAndLock(_ring, _capacity * sizeof(std::atomic_short));
     }
 
     ~VisualizationBuffer()
     {
-        delete[] _first;
-        _first = nullptr;
+        if (_locked)
+        {
+            RealtimeUtil::Unlock(_ring, _capacity * sizeof(std::atomic_short));
+        }
 
-        delete[] _second;
-        _second = nullptr;
+        delete[] _ring;
+        _ring = nullptr;
     }
 
 public:
-    /// @brief Copies front-buffer data with an initialized constant maxLength size and returns maxLength. If no initial data is ready yet, doesn't copy anything and returns 0.
-    size_t Read(short* out) const
+    /// @brief Copies maxLength samples preceding the latest delayLength ones (the delay gets clamped to the retained history) and returns maxLength. If not enough data was written yet, doesn't copy anything and returns 0.
+    size_t Read(short* out, size_t delayLength) const
     {
-        if (!_ready)
+        const uint_least64_t written = _written;
+        const uint_least64_t end = written - std::min<uint_least64_t>({delayLength, written, _capacity - maxLength});
+        if (end < maxLength)
         {
             return 0;
         }
 
-        const std::atomic_short* const buffer = (_flipped) ? _second : _first;
-        memcpy(out, buffer, maxLength * sizeof(short));
+        const uint_least64_t start = end - maxLength;
+        for (size_t i = 0; i < maxLength; ++i)
+        {
+            out[i] = _ring[(start + i) % _capacity];
+        }
+
         return maxLength;
     }
 
-    void Write(const short* const data, size_t dataLength)
+    bool IsLocked() const
     {
-        const size_t remaining = maxLength - _level;
-        const size_t overflow = (dataLength > remaining) ? (dataLength - remaining) : 0;
+        return _locked;
+    }
 
-        // Fill the active back-buffer up to its maximum
-        const size_t amount = (overflow == 0) ? dataLength : remaining;
-        std::atomic_short* buffer = (_flipped) ? _first : _second;
-        for (int i = 0; i < amount; ++i)
+    void Write(const short* const data, size_t dataLength)
+    {
+        // Keep overwriting the oldest data (so only the latest portion is retained if the dataLength exceeds the capacity).
+        const uint_least64_t written = _written;
+        for (size_t i = 0; i < dataLength; ++i)
         {
-            buffer[_level + i] = data[i];
+            _ring[(written + i) % _capacity] = data[i];
         }
 
-        _level += amount;
-
-        // Flip the front/back buffer roles if the current back-buffer is maxed out
-        if (_level >= maxLength)
-        {
-            _flipped = !_flipped;
-            _level = 0;
-            _ready = true;
-
-            // Keep overwriting any previous data until we're left with only the latest data portion stored across both buffers
-            if (overflow != 0)
-            {
-                Write(&data[amount], dataLength - amount);
-            }
-        }
+        _written = written + dataLength;
     }
 
 public:
     const size_t maxLength;
 
 private:
-    std::atomic_bool _ready = false; // Whether the front-buffer is ready (remains true permanently).
-    std::atomic_bool _flipped = false; // Indicates a front-buffer and back-buffer role inversion.
-    std::atomic_size_t _level = 0; // Fill-level of the active back-buffer.
+    const size_t _capacity; // Also retains enough of the history to compensate for the output latency.
+    std::atomic_uint_least64_t _written = 0; // Total amount of samples written so far.
+    std::atomic_short* _ring;
+    bool _locked = false; // In RAM.
+};
+
+/// @brief Timestamps the playback buffers (seqlock-style, so the audio callback never waits for the readers).
+class OutputClock
+{
+public:
+    struct Snapshot
+    {
+        unsigned long bufferFrames; // 0 if nothing was handed out yet.
+        double bufferDacTime; // Stream time at which the first frame of the latest buffer becomes audible (0 if the host API doesn't know).
+    };
+
+public:
+    void Reset()
+    {
+        BeginBuffer();
+        EndBuffer(0, 0.0);
+    }
 
-    std::atomic_short* _first; // Front/back buffer #1.
-    std::atomic_short* _second; // Front/back buffer #2.
+    void BeginBuffer()
+    {
+        ++_sequence; // Becomes odd.
+    }
+
+    void EndBuffer(unsigned long frames, double dacTime)
+    {
+        _bufferFrames = frames;
+        _bufferDacTime = dacTime;
+        ++_sequence; // Becomes even.
+    }
+
+    uint_least32_t GetSequence() const
+    {
+        return _sequence;
+    }
+
+    /// @brief Returns the sequence the snapshot is consistent with (odd if it's not, i.e., a buffer is being filled at the moment).
+    uint_least32_t Read(Snapshot& out) const
+    {
+        const uint_least32_t sequence = _sequence;
+        out = {_bufferFrames, _bufferDacTime};
+        return (_sequence == sequence) ? sequence : (sequence | 1);
+    }
+
+private:
+    std::atomic_uint_least32_t _sequence = 0;
+    std::atomic_ulong _bufferFrames = 0;
+    std::atomic<double> _bufferDacTime = 0.0;
 };
 
 
 static PortAudioOutput::TPortAudioConfig currentAudioConfig; // Must be static because the PlaybackCallback is static (PortAudio works that way).
 static std::unique_ptr<VisualizationBuffer> visBuffer = nullptr;
+static bool lockVisualizationMemory = false;
+static OutputClock outputClock;
+static std::atomic_ulong largestCallbackFrames = 0; // Since the stream was opened.
+
+static struct
+{
+    std::atomic_uint_least64_t frames = 0;
+    std::atomic_uint_least32_t underruns = 0;
+    std::atomic_uint_least32_t peakLoadPermille = 0;
+    std::atomic_uint_least32_t loadHistogram[LOAD_HISTOGRAM_SIZE] = {}; // Callback counts per load step.
+    std::atomic_bool primed = false; // Some host APIs report an underflow on the first callback after the stream start.
+} outputStats;
 
 PortAudioOutput::~PortAudioOutput()
 {
@@ -133,10 +195,24 @@ void PortAudioOutput::InitVisualizationBuffer(size_t length)
     }
     else
     {
-        visBuffer = std::make_unique<VisualizationBuffer>(length);
+        visBuffer = std::make_unique<VisualizationBuffer>(length, lockVisualizationMemory);
+    }
+}
+
+void PortAudioOutput::SetMemoryLocking(bool enable)
+{
+    lockVisualizationMemory = enable;
+    if (visBuffer != nullptr && visBuffer->IsLocked() != enable)
+    {
+        InitVisualizationBuffer(visBuffer->maxLength);
     }
 }
 
+bool PortAudioOutput::IsMemoryLocked() const
+{
+    return lockVisualizationMemory && (visBuffer == nullptr || visBuffer->IsLocked());
+}
+
 size_t PortAudioOutput::GetVisualizationWaveform(short* out) const
 {
     if (visBuffer == nullptr)
@@ -144,7 +220,36 @@ size_t PortAudioOutput::GetVisualizationWaveform(short* out) const
         return 0;
     }
 
-    return visBuffer->Read(out);
+    uint_least32_t clockSequence = 0;
+    const double lagSeconds = GetOutputLagSeconds(clockSequence);
+    const size_t delayLength = static_cast<size_t>(lagSeconds * currentAudioConfig.sampleRate) * currentAudioConfig.channelCount;
+    return visBuffer->Read(out, delayLength);
+}
+
+uint_least32_t PortAudioOutput::GetClockSequence() const
+{
+    return outputClock.GetSequence();
+}
+
+double PortAudioOutput::GetOutputLagSeconds(uint_least32_t& outClockSequence) const
+{
+    OutputClock::Snapshot snapshot{};
+    outClockSequence = outputClock.Read(snapshot);
+
+    if (_stream == nullptr || snapshot.bufferFrames == 0 || Pa_IsStreamActive(_stream) != 1)
+    {
+        return 0.0; // Nothing is pending (a stopped stream has already played out everything).
+    }
+
+    if (snapshot.bufferDacTime <= 0.0)
+    {
+        // The host API doesn't timestamp the buffers: settle for the nominal latency.
+        const PaStreamInfo* streamInfo = Pa_GetStreamInfo(_stream);
+        return (streamInfo == nullptr) ? 0.0 : streamInfo->outputLatency;
+    }
+
+    const double bufferEndDacTime = snapshot.bufferDacTime + snapshot.bufferFrames / currentAudioConfig.sampleRate;
+    return std::max(0.0, bufferEndDacTime - Pa_GetStreamTime(_stream));
 }
 
 bool PortAudioOutput::PreInitPortAudioLibrary()
@@ -173,12 +278,12 @@ bool PortAudioOutput::TryInit(const AudioConfig& audioConfig, IBufferWriter* buf
             return false;
         }
 
-        const PaDeviceInfo& deviceInfo = *Pa_GetDeviceInfo(outputDevice);
         currentAudioConfig = AudioConfig(audioConfig);
         currentAudioConfig.hostApiSpecificStreamInfo = NULL; // Without this you get an error in the release mode.
         currentAudioConfig.device = outputDevice;
         currentAudioConfig.sampleFormat = paInt16; // Must be 16 bit (libsidplayfp expects 16 bit buffer).
-        currentAudioConfig.suggestedLatency = (currentAudioConfig.lowLatency) ? deviceInfo.defaultLowOutputLatency : deviceInfo.defaultHighOutputLatency;
+        currentAudioConfig.suggestedLatency = GetDefaultSuggestedLatency();
+        _framesPerBuffer = paFramesPerBufferUnspecified;
 
         // Open an audio I/O stream.
         assert(currentAudioConfig.sampleRate > 8000); // libsidplayfp supports sample rates *above* 8kHz only.
@@ -190,6 +295,8 @@ bool PortAudioOutput::TryInit(const AudioConfig& audioConfig, IBufferWriter* buf
 
 bool PortAudioOutput::TryStartStream()
 {
+    outputClock.Reset();
+    outputStats.primed = false;
     PaError err = Pa_StartStream(_stream);
     return !LogAnyError("TryStartStream", err);
 }
@@ -202,7 +309,7 @@ void PortAudioOutput::StopStream(bool immediate)
 
 PaError PortAudioOutput::ResetStream(double samplerate)
 {
-    if (_stream != nullptr && Pa_IsStreamActive(_stream))
+    if (_stream != nullptr) // Reminder: a stopped stream must be closed too.
     {
         PaError err = Pa_CloseStream(_stream);
         if (LogAnyError("ResetStream: Pa_CloseStream", err))
@@ -213,11 +320,12 @@ PaError PortAudioOutput::ResetStream(double samplerate)
 
     // Open an audio I/O stream.
     PaError err = Pa_OpenStream(&_stream, NULL, &currentAudioConfig, samplerate,
-                                paFramesPerBufferUnspecified,
+                                _framesPerBuffer,
                                 paNoFlag,
                                 PlaybackCallback,
                                 _bufferWriter);
 
+    largestCallbackFrames = 0;
     const bool failed = LogAnyError("ResetStream: Pa_OpenStream", err);
     if (failed)
     {
@@ -227,14 +335,69 @@ PaError PortAudioOutput::ResetStream(double samplerate)
     return err;
 }
 
-const PortAudioOutput::AudioConfig& PortAudioOutput::GetAudioConfig() const
+PaError PortAudioOutput::ReopenStream(unsigned long framesPerBuffer, double suggestedLatency)
 {
-    return currentAudioConfig;
+    const double effectiveSuggestedLatency = (suggestedLatency > 0.0) ? suggestedLatency : GetDefaultSuggestedLatency();
+    if (_stream != nullptr && framesPerBuffer == _framesPerBuffer && effectiveSuggestedLatency == currentAudioConfig.suggestedLatency)
+    {
+        return paNoError; // Already in effect.
+    }
+
+    _framesPerBuffer = framesPerBuffer;
+    currentAudioConfig.suggestedLatency = effectiveSuggestedLatency;
+    return ResetStream(currentAudioConfig.sampleRate);
+}
+
+unsigned long PortAudioOutput::GetFramesPerBuffer() const
+{
+    return (_framesPerBuffer != paFramesPerBufferUnspecified) ? _framesPerBuffer : largestCallbackFrames.load();
+}
+
+double PortAudioOutput::GetDefaultSuggestedLatency() const
+{
+    const PaDeviceInfo& deviceInfo = *Pa_GetDeviceInfo(currentAudioConfig.device);
+    return (currentAudioConfig.lowLatency) ? deviceInfo.defaultLowOutputLatency : deviceInfo.defaultHighOutputLatency;
+}
+
+PortAudioOutput::OutputStats PortAudioOutput::TakeOutputStats()
+{
+    OutputStats stats;
+    stats.playedSeconds = outputStats.frames.exchange(0) / currentAudioConfig.sampleRate;
+    stats.underruns = outputStats.underruns.exchange(0);
+    stats.peakLoad = outputStats.peakLoadPermille.exchange(0) / 1000.0;
+
+    uint_least32_t histogram[LOAD_HISTOGRAM_SIZE];
+    uint_least64_t callbacks = 0;
+    for (size_t step = 0; step < LOAD_HISTOGRAM_SIZE; ++step)
+    {
+        histogram[step] = outputStats.loadHistogram[step].exchange(0);
+        callbacks += histogram[step];
+    }
+
+    uint_least64_t counted = 0;
+    for (size_t step = 0; step < LOAD_HISTOGRAM_SIZE && callbacks > 0; ++step)
+    {
+        counted += histogram[step];
+        if (counted >= callbacks * HIGH_LOAD_PERCENTILE)
+        {
+            stats.highLoad = (step + 1) * LOAD_HISTOGRAM_STEP_PERMILLE / 1000.0; // Upper bound of the step.
+            break;
+        }
+    }
+
+    return stats;
+}
+
+std::string PortAudioOutput::GetDeviceIdentity() const
+{
+    const PaDeviceInfo& deviceInfo = *Pa_GetDeviceInfo(currentAudioConfig.device);
+    const PaHostApiInfo* const hostApiInfo = Pa_GetHostApiInfo(deviceInfo.hostApi);
+    return std::string((hostApiInfo == nullptr) ? "" : hostApiInfo->name) + ": " + deviceInfo.name;
 }
 
-bool PortAudioOutput::IsOutputSampleRateSupported(double samplerate) const
+const PortAudioOutput::AudioConfig& PortAudioOutput::GetAudioConfig() const
 {
-    return Pa_IsFormatSupported(NULL, &currentAudioConfig, samplerate) == paFormatIsSupported;
+    return currentAudioConfig;
 }
 
 bool PortAudioOutput::LogAnyError(const char* tag, const PaError& err)
@@ -250,13 +413,23 @@ bool PortAudioOutput::LogAnyError(const char* tag, const PaError& err)
 
 int PortAudioOutput::PlaybackCallback(const void* /*inputBuffer*/, void* outputBuffer,
                                       unsigned long framesPerBuffer,
-                                      const PaStreamCallbackTimeInfo* /*timeInfo*/,
-                                      PaStreamCallbackFlags /*statusFlags*/,
+                                      const PaStreamCallbackTimeInfo* timeInfo,
+                                      PaStreamCallbackFlags statusFlags,
                                       void* userData)
 {
+    const std::chrono::steady_clock::time_point callbackStart = std::chrono::steady_clock::now();
+    if ((statusFlags & paOutputUnderflow) != 0 && outputStats.primed)
+    {
+        ++outputStats.underruns;
+    }
+
+    outputStats.primed = true;
+
     // Write to output device
+    outputClock.BeginBuffer();
     IBufferWriter* externalSource = static_cast<IBufferWriter*>(userData);
     const bool successful = externalSource->TryFillBuffer(outputBuffer, framesPerBuffer);
+    outputClock.EndBuffer((successful) ? framesPerBuffer : 0, timeInfo->outputBufferDacTime);
 
     // Common
     short* const out = static_cast<short*>(outputBuffer);
@@ -281,5 +454,22 @@ int PortAudioOutput::PlaybackCallback(const void* /*inputBuffer*/, void* outputB
         }
     }
 
+    // Update the stats
+    const double callbackSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - callbackStart).count();
+    const uint_least32_t loadPermille = static_cast<uint_least32_t>(callbackSeconds * currentAudioConfig.sampleRate * 1000.0 / framesPerBuffer);
+    uint_least32_t peakLoadPermille = outputStats.peakLoadPermille;
+    while (loadPermille > peakLoadPermille && !outputStats.peakLoadPermille.compare_exchange_weak(peakLoadPermille, loadPermille))
+    {
+    }
+
+    ++outputStats.loadHistogram[std::min<size_t>(loadPermille / LOAD_HISTOGRAM_STEP_PERMILLE, LOAD_HISTOGRAM_SIZE - 1)];
+
+    outputStats.frames += framesPerBuffer;
+
+    unsigned long largestFrames = largestCallbackFrames;
+    while (framesPerBuffer > largestFrames && !largestCallbackFrames.compare_exchange_weak(largestFrames, framesPerBuffer))
+    {
+    }
+
     return (successful) ? paContinue : paAbort; // Reminder: there is also paComplete, so see about it when we reach the end maybe
 }
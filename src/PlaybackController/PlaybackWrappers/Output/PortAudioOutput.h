@@ -20,6 +20,8 @@
 
 #include "../IBufferWriter.h"
 #include <portaudio.h>
+#include <cstdint>
+#include <string>
 
 class PortAudioOutput
 {
@@ -32,6 +34,14 @@ public:
         PaDeviceIndex preferredOutputDevice = paNoDevice;
     } AudioConfig;
 
+    struct OutputStats
+    {
+        double playedSeconds = 0.0;
+        uint_least32_t underruns = 0;
+        double peakLoad = 0.0; // Longest time spent in the audio callback, relative to the buffer period.
+        double highLoad = 0.0; // Same but the 99th percentile (so a single hiccup doesn't count), rounded up to 5 %.
+    };
+
 public:
     ~PortAudioOutput();
 
@@ -45,9 +55,21 @@ public:
      */
     void InitVisualizationBuffer(size_t length);
 
-    /// @brief Copies the latest waveform data (playback buffer size affects latency). Returns size of data (can be 0 if not ready or disabled).
+    /// @brief Keeps the visualization buffer pre-faulted and locked in RAM (see RealtimeUtil), since the audio callback writes to it.
+    void SetMemoryLocking(bool enable);
+
+    /// @brief Whether the visualization buffer (if any) got locked in RAM.
+    bool IsMemoryLocked() const;
+
+    /// @brief Copies the waveform data which is audible right now (i.e., compensated for the output latency). Returns size of data (can be 0 if not ready or disabled).
     size_t GetVisualizationWaveform(short* out) const;
 
+    /// @brief Changes whenever the playback callback requests a buffer (odd while the buffer is being filled). Lets a reader detect that whatever it read along with the GetOutputLagSeconds got torn by a concurrent callback.
+    uint_least32_t GetClockSequence() const;
+
+    /// @brief Time remaining until everything handed out to the device so far becomes audible, interpolated between the playback buffers by the stream clock. Also returns the clock sequence the value is consistent with.
+    double GetOutputLagSeconds(uint_least32_t& outClockSequence) const;
+
 public:
     bool PreInitPortAudioLibrary();
     bool TryInit(const AudioConfig& audioConfig, IBufferWriter* bufferWriter);
@@ -55,8 +77,22 @@ public:
     void StopStream(bool immediate);
     PaError ResetStream(double samplerate);
 
+    /// @brief Reopens the (stopped) stream with the given buffer size and suggested latency (in seconds), unless they're already in effect. Pass paFramesPerBufferUnspecified and 0 to go back to the defaults (as per the lowLatency).
+    PaError ReopenStream(unsigned long framesPerBuffer, double suggestedLatency);
+
+    /// @brief Largest amount of frames a playback callback requests: the fixed buffer size if set, otherwise the largest request since the stream was opened (0 if none yet).
+    unsigned long GetFramesPerBuffer() const;
+
+    /// @brief The suggested latency (in seconds) the stream is opened with by default (as per the lowLatency).
+    double GetDefaultSuggestedLatency() const;
+
+    /// @brief Returns the playback statistics gathered since the previous call (and starts anew).
+    OutputStats TakeOutputStats();
+
+    /// @brief Identifies the output device across sessions (its index may not be stable).
+    std::string GetDeviceIdentity() const;
+
     const AudioConfig& GetAudioConfig() const;
-    bool IsOutputSampleRateSupported(double samplerate) const;
 
 private:
     static bool LogAnyError(const char* tag, const PaError& err);
@@ -70,6 +106,7 @@ private:
 
 private:
     PaStream* _stream = nullptr;
+    unsigned long _framesPerBuffer = paFramesPerBufferUnspecified;
     IBufferWriter* _bufferWriter = nullptr;
     bool _paInitialized = false;
 };
@@ -0,0 +1,117 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "WavFileWriter.h"
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+namespace
+{
+    constexpr uint_least32_t WAV_HEADER_SIZE = 44;
+    constexpr uint_least16_t WAV_FORMAT_PCM = 1;
+    constexpr uint_least16_t BITS_PER_SAMPLE = 16;
+
+    constexpr uint_least64_t MAX_DATA_SIZE = std::numeric_limits<uint_least32_t>::max() - WAV_HEADER_SIZE; // RIFF size field limit.
+
+    void PutLittleEndian(char*& out, uint_least32_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            *out++ = static_cast<char>((value >> (i * 8)) & 0xff);
+        }
+    }
+}
+
+WavFileWriter::~WavFileWriter()
+{
+    TryClose();
+}
+
+bool WavFileWriter::TryOpen(const std::wstring& filepath, int sampleRate, int numChannels)
+{
+    TryClose();
+
+    _stream.open(std::filesystem::path(filepath), std::ios::binary | std::ios::trunc);
+    _sampleRate = sampleRate;
+    _numChannels = numChannels;
+    _dataSize = 0;
+
+    return _stream.is_open() && TryWriteHeader(0); // Placeholder sizes until closed.
+}
+
+bool WavFileWriter::TryWrite(const short* samples, size_t sampleCount)
+{
+    const uint_least64_t bytes = static_cast<uint_least64_t>(sampleCount) * sizeof(short);
+    if (!_stream.is_open() || _dataSize + bytes > MAX_DATA_SIZE)
+    {
+        return false;
+    }
+
+    // Reminder: WAV is little-endian, same as all of our target platforms so the samples are written as-is.
+    _stream.write(reinterpret_cast<const char*>(samples), bytes);
+    _dataSize += bytes;
+
+    return _stream.good();
+}
+
+bool WavFileWriter::TryClose()
+{
+    if (!_stream.is_open())
+    {
+        return false;
+    }
+
+    _stream.seekp(0);
+    const bool success = TryWriteHeader(static_cast<uint_least32_t>(_dataSize));
+    _stream.close();
+
+    return success && !_stream.fail();
+}
+
+bool WavFileWriter::IsOpen() const
+{
+    return _stream.is_open();
+}
+
+bool WavFileWriter::TryWriteHeader(uint_least32_t dataSize)
+{
+    const uint_least32_t blockAlign = _numChannels * (BITS_PER_SAMPLE / 8);
+
+    char header[WAV_HEADER_SIZE];
+    char* out = header;
+
+    memcpy(out, "RIFF", 4); out += 4;
+    PutLittleEndian(out, WAV_HEADER_SIZE - 8 + dataSize, 4);
+    memcpy(out, "WAVE", 4); out += 4;
+
+    memcpy(out, "fmt ", 4); out += 4;
+    PutLittleEndian(out, 16, 4);
+    PutLittleEndian(out, WAV_FORMAT_PCM, 2);
+    PutLittleEndian(out, _numChannels, 2);
+    PutLittleEndian(out, _sampleRate, 4);
+    PutLittleEndian(out, _sampleRate * blockAlign, 4);
+    PutLittleEndian(out, blockAlign, 2);
+    PutLittleEndian(out, BITS_PER_SAMPLE, 2);
+
+    memcpy(out, "data", 4); out += 4;
+    PutLittleEndian(out, dataSize, 4);
+
+    _stream.write(header, WAV_HEADER_SIZE);
+    return _stream.good();
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/// @brief Streams 16-bit PCM samples into a WAV file (the header sizes are patched in on close).
+class WavFileWriter
+{
+public:
+    WavFileWriter() = default;
+    WavFileWriter(WavFileWriter&) = delete;
+
+    ~WavFileWriter();
+
+public:
+    bool TryOpen(const std::wstring& filepath, int sampleRate, int numChannels);
+    bool TryWrite(const short* samples, size_t sampleCount);
+
+    /// @brief Finalizes the header and closes the file. Returns false if anything failed since opening.
+    bool TryClose();
+
+    bool IsOpen() const;
+
+private:
+    bool TryWriteHeader(uint_least32_t dataSize);
+
+private:
+    std::ofstream _stream;
+    int _sampleRate = 0;
+    int _numChannels = 0;
+    uint_least64_t _dataSize = 0;
+};
@@ -17,86 +17,254 @@
  */
 
 #include "PreRender.h"
+#include "Util/RealtimeUtil.h"
+#include <algorithm>
+#include <chrono>
 #include <math.h>
 #include <stdexcept>
 #include <string.h>
 
-static size_t GRANULARITY = 4096; // Buffer granularity in thread fill-loop.
+static size_t GRANULARITY = 4096; // Buffer granularity (in frames) in thread fill-loop.
+static constexpr size_t NO_REANCHOR_REQUEST = SIZE_MAX;
+static constexpr size_t NO_SEEK_TARGET = SIZE_MAX;
+static constexpr std::chrono::milliseconds WINDOW_IDLE_SLEEP(5);
+static constexpr std::chrono::milliseconds PROGRESS_WAIT_TIMEOUT(20); // Lets the seek waits still check for their abort requests.
+static constexpr uint_least32_t RESYNC_MARGIN_MS = 200; // Well over a renderer's seek step (an emulation frame).
+static constexpr size_t NO_JUMP = SIZE_MAX;
+static constexpr int JUMP_MIN_DISTANCE_MS = 5000;
+static constexpr size_t FAST_FORWARD_SPEEDUP = 4; // Conservative estimate of how much faster the renderer can seek (from the start at worst) than render.
 
 PreRender::~PreRender()
 {
 	DestroyData();
 }
 
-void PreRender::DoPreRender(IBufferWriter& renderer, int sampleRate, int numChannels, int durationMs)
+void PreRender::DoPreRender(IBufferWriter& renderer, int sampleRate, int numChannels, int durationMs, int windowMs, const AbortableRendererSeeker& seekRenderer)
 {
-	AbortPreRender();
-
-	const double sampleRatePerMs = sampleRate / 1000.0;
-	_numChannels = numChannels;
-	_stridePerMs = sampleRatePerMs * numChannels;
-
-	const int frames = std::ceil(durationMs * sampleRatePerMs);
-	const size_t size = frames * _numChannels * sizeof(short);
-
-	short* result = static_cast<short*>(realloc(_waveBufferContent, size));
-	if (result == nullptr)
+	if (!TryPrepare(sampleRate, numChannels, durationMs, windowMs, seekRenderer))
 	{
-		DestroyData();
 		return; // Out of memory. Should probably throw an exception rather than refusing to play?
 	}
 
-	_waveBufferContent = result;
-	_waveBufferSize = size;
-
-	_playbackPosition = 0;
-	_preRenderedSize = 0;
-	_abortPreRenderFlag = false;
+	StartRenderThread(renderer);
+}
 
-	_thread = std::thread([this, size, &renderer]
-    {
-		const size_t maxFramesPerBuffer = std::min(GRANULARITY, size);
+void PreRender::StartRenderThread(IBufferWriter& renderer)
+{
+	const size_t granuleSize = GRANULARITY * _numChannels;
+	_thread = std::thread([this, granuleSize, &renderer]
+	{
+		const size_t keepBehindSize = _ringSize / 4; // Windowed mode: rest of the ring is for rendering ahead.
+		bool rendererInSync = true;
 
-		while (!_abortPreRenderFlag && _preRenderedSize < size)
+		while (!_abortPreRenderFlag)
 		{
-			size_t chunk = maxFramesPerBuffer;
+			const size_t reanchorRequest = _reanchorRequest.exchange(NO_REANCHOR_REQUEST);
+			if (reanchorRequest != NO_REANCHOR_REQUEST)
+			{
+				rendererInSync = TryReanchor(reanchorRequest);
+				continue;
+			}
 
-			// Ensure the last one is trimmed-down
-			const size_t payloadSize = chunk * _numChannels * sizeof(short);
-			size_t newSize = _preRenderedSize + payloadSize;
-			if (newSize > size)
+			if (!rendererInSync)
 			{
-				chunk = (size - _preRenderedSize) / _numChannels / sizeof(short);
-				newSize = size;
+				rendererInSync = TryResyncRenderer(renderer);
+				continue;
 			}
 
-			const bool success = renderer.TryFillBuffer(static_cast<short*>(_waveBufferContent) + (_preRenderedSize / sizeof(short)), chunk); // Reminder: calls SidDecoder's TryFillBuffer(), not ours.
-			if (success)
+			const size_t renderedEnd = _renderedEnd;
+			if (renderedEnd >= _totalSize)
 			{
-				_preRenderedSize = newSize;
+				if (!IsWindowed())
+				{
+					break; // Done.
+				}
+
+				std::this_thread::sleep_for(WINDOW_IDLE_SLEEP); // Stay around for the re-anchoring requests.
+				continue;
 			}
-			else
+
+			const size_t ringPosition = renderedEnd % _ringSize;
+			const size_t chunk = std::min({granuleSize, _totalSize - renderedEnd, _ringSize - ringPosition}); // Ensure the last one is trimmed-down.
+
+			// Don't overwrite what's still needed around the play head (never the case if not windowed).
+			// Reminder: a pending seek's target already counts as the play head, otherwise the seek would wait for the renderer and the renderer for the playback.
+			const size_t seekTarget = _seekTarget;
+			const size_t playbackPosition = std::min<size_t>((seekTarget != NO_SEEK_TARGET) ? seekTarget : _playbackPosition.load(), renderedEnd);
+			const size_t keepFrom = std::max<size_t>(_validStart, (playbackPosition > keepBehindSize) ? playbackPosition - keepBehindSize : 0);
+			if (renderedEnd + chunk > keepFrom + _ringSize)
 			{
-				DestroyData();
-				break;
+				std::this_thread::sleep_for(WINDOW_IDLE_SLEEP);
+				continue;
+			}
+
+			if (renderedEnd + chunk > _ringSize)
+			{
+				_validStart = renderedEnd + chunk - _ringSize; // About to be overwritten.
 			}
+
+			const bool success = renderer.TryFillBuffer(_waveBufferContent + ringPosition, chunk / _numChannels); // Reminder: calls SidDecoder's TryFillBuffer(), not ours.
+			if (!success)
+			{
+				break; // Leave the rest silent.
+			}
+
+			_renderedEnd = renderedEnd + chunk;
+			PublishProgress();
 		}
 	});
 }
 
+void PreRender::DoPreRenderSeekPriority(const Lane& first, const Lane& second, int sampleRate, int numChannels, int durationMs)
+{
+	if (!TryPrepare(sampleRate, numChannels, durationMs, 0, nullptr))
+	{
+		return; // Out of memory.
+	}
+
+	_lanes[0] = first;
+	_lanes[1] = second;
+	_laneThreads[0] = std::thread([this] { RenderLane(0, 0); });
+}
+
+void PreRender::DoPreRenderStems(const std::vector<StemSource>& stems, int sampleRate, int numChannels, int durationMs)
+{
+	DestroyData();
+
+	_numChannels = numChannels;
+	_stridePerMs = sampleRate / 1000.0 * numChannels;
+	_playbackPosition = 0;
+
+	_stemGains = std::make_unique<std::atomic<float>[]>(stems.size());
+	for (const StemSource& stem : stems)
+	{
+		_stemGains[_stems.size()] = 1.0f;
+		_stems.emplace_back(std::make_unique<PreRender>());
+		_stems.back()->SetMemoryLocking(_memoryLocking);
+		_stems.back()->DoPreRender(*stem.renderer, sampleRate, stem.numChannels, durationMs); // Each one renders in its own thread.
+	}
+
+	_stemScratch.resize(GRANULARITY * numChannels);
+	_mixScratch.resize(GRANULARITY * numChannels);
+}
+
+void PreRender::SetStemGain(size_t stemIndex, float gain)
+{
+	if (stemIndex < _stems.size())
+	{
+		_stemGains[stemIndex] = gain;
+	}
+}
+
+bool PreRender::HasStems() const
+{
+	return !_stems.empty();
+}
+
+bool PreRender::TryAdoptCompleted(PreRender& source)
+{
+	if (&source == this || !source.IsFullyAvailable())
+	{
+		return false;
+	}
+
+	source.AbortPreRender(); // Just joins the (already finished) thread(s).
+	source.UnlockMemory(); // Locks are never handed over (e.g., into the cache).
+	DestroyData();
+
+	_numChannels = source._numChannels;
+	_stridePerMs = source._stridePerMs;
+	_stems = std::move(source._stems);
+	_stemGains = std::move(source._stemGains);
+	_stemScratch = std::move(source._stemScratch);
+	_mixScratch = std::move(source._mixScratch);
+	source._stems.clear();
+
+	for (std::unique_ptr<PreRender>& stem : _stems)
+	{
+		stem->_playbackPosition = 0;
+		stem->UnlockMemory();
+		stem->SetMemoryLocking(_memoryLocking);
+		stem->LockMemory();
+	}
+
+	_waveBufferContent = source._waveBufferContent.exchange(nullptr);
+	_ringSize = source._ringSize.exchange(0);
+	_totalSize = source._totalSize.exchange(0);
+	_renderedEnd = source._renderedEnd.exchange(0);
+	_validStart = 0;
+	_playbackPosition = 0;
+	LockMemory();
+
+	return true;
+}
+
+bool PreRender::TryAdoptRunning(PreRender& source, IBufferWriter& sourceRenderer)
+{
+	if (&source == this || source.HasStems() || source.IsSeekPriority() || source.IsWindowed() || source._totalSize == 0)
+	{
+		return false;
+	}
+
+	source.AbortPreRender(); // Reminder: its thread stops between the chunks, so the renderer is right at the source's _renderedEnd.
+	source.UnlockMemory();
+	DestroyData();
+
+	_numChannels = source._numChannels;
+	_stridePerMs = source._stridePerMs;
+	_waveBufferContent = source._waveBufferContent.exchange(nullptr);
+	_ringSize = source._ringSize.exchange(0);
+	_totalSize = source._totalSize.exchange(0);
+	_renderedEnd = source._renderedEnd.exchange(0);
+	_validStart = 0;
+	_playbackPosition = 0;
+	_seekRenderer = nullptr;
+	_reanchorRequest = SIZE_MAX;
+	_seekTarget = SIZE_MAX;
+	LockMemory();
+
+	if (_renderedEnd < _totalSize)
+	{
+		StartRenderThread(sourceRenderer);
+	}
+
+	return true;
+}
+
+void PreRender::SetMemoryLocking(bool enable)
+{
+	_memoryLocking = enable;
+}
+
+bool PreRender::IsMemoryLocked() const
+{
+	const bool stemsLocked = std::all_of(_stems.begin(), _stems.end(), [](const std::unique_ptr<PreRender>& stem) { return stem->IsMemoryLocked(); });
+	return _memoryLocking && stemsLocked && (_waveBufferContent == nullptr || _lockedSize > 0);
+}
+
 bool PreRender::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
 {
+	short* const out = static_cast<short*>(buffer);
+	if (HasStems())
+	{
+		return TryMixStems(out, framesPerBuffer);
+	}
+
 	const size_t length = framesPerBuffer * _numChannels;
-	const size_t framesTo = length * sizeof(short);
-	_playbackPosition += length;
+	const size_t position = _playbackPosition;
+	_playbackPosition = position + length;
 
-	if ((_playbackPosition * _numChannels) + framesTo > _preRenderedSize)
+	if (_ringSize == 0 || !IsRendered(position, length))
 	{
-		memset(buffer, 0, framesTo);
+		memset(out, 0, length * sizeof(short));
 		return true;
 	}
 
-	memcpy(buffer, _waveBufferContent + _playbackPosition, framesTo);
+	// Copy (in up to two parts due to wrap-around)
+	const size_t ringPosition = position % _ringSize;
+	const size_t firstPart = std::min(length, _ringSize - ringPosition);
+	memcpy(out, _waveBufferContent + ringPosition, firstPart * sizeof(short));
+	memcpy(out + firstPart, _waveBufferContent, (length - firstPart) * sizeof(short));
 	return true;
 }
 
@@ -107,44 +275,537 @@ int PreRender::GetCurrentSongTimeMs() const
 
 double PreRender::GetPreRenderProgressFactor() const
 {
-	if (_waveBufferSize == 0)
+	if (HasStems())
+	{
+		double minFactor = 1.0;
+		for (const std::unique_ptr<PreRender>& stem : _stems)
+		{
+			minFactor = std::min(minFactor, stem->GetPreRenderProgressFactor());
+		}
+
+		return minFactor;
+	}
+
+	if (_totalSize == 0)
 	{
 		return 0.0;
 	}
 
-	return std::clamp(static_cast<double>(_preRenderedSize) / _waveBufferSize, 0.0, 1.0);
+	const size_t jumpStart = _jumpStart;
+	const size_t jumpEnd = _jumpEnd;
+	const size_t jumpedSize = (jumpStart != NO_JUMP && jumpEnd > jumpStart) ? jumpEnd - jumpStart : 0;
+	return std::clamp(static_cast<double>(_renderedEnd + jumpedSize) / _totalSize, 0.0, 1.0);
+}
+
+bool PreRender::IsFullyAvailable() const
+{
+	if (HasStems())
+	{
+		return std::all_of(_stems.begin(), _stems.end(), [](const std::unique_ptr<PreRender>& stem) { return stem->IsFullyAvailable(); });
+	}
+
+	return _totalSize != 0 && _validStart == 0 && _renderedEnd == _totalSize;
+}
+
+size_t PreRender::GetMemorySize() const
+{
+	size_t size = _ringSize * sizeof(short);
+	for (const std::unique_ptr<PreRender>& stem : _stems)
+	{
+		size += stem->GetMemorySize();
+	}
+
+	return size;
 }
 
 void PreRender::Stop()
 {
 	AbortPreRender();
 	_playbackPosition = 0;
+
+	for (std::unique_ptr<PreRender>& stem : _stems)
+	{
+		stem->Stop();
+	}
 }
 
 void PreRender::SeekTo(int timeMs, const SeekStatusCallback& callback)
 {
-	int availTimeMs = (_preRenderedSize / sizeof(short)) / _stridePerMs;
-	while (availTimeMs < timeMs)
+	if (HasStems())
+	{
+		// Wait for each stem in turn (they're all rendered in parallel anyway), reporting just the completion of the last one.
+		bool aborted = false;
+		for (std::unique_ptr<PreRender>& stem : _stems)
+		{
+			stem->SeekTo(timeMs, [&callback, &aborted](int cTimeMs, bool done) -> bool
+			{
+				aborted = !done && callback(cTimeMs, false);
+				return aborted;
+			});
+
+			if (aborted)
+			{
+				return;
+			}
+		}
+
+		const PreRender& leadStem = *_stems.front();
+		_playbackPosition = leadStem._playbackPosition / leadStem._numChannels * _numChannels;
+		callback(GetCurrentSongTimeMs(), true);
+		return;
+	}
+
+	size_t target = std::min(ToSamplePosition(timeMs), static_cast<size_t>(_totalSize));
+	const unsigned int initialAnchorGeneration = _anchorGeneration;
+	bool reanchorRequested = false;
+	bool jumpRequested = false;
+	uint_least64_t seenGeneration = _progressGeneration;
+	_seekTarget = (IsWindowed()) ? target : NO_SEEK_TARGET;
+
+	while (!IsRendered(target, 0) || (reanchorRequested && _anchorGeneration == initialAnchorGeneration))
 	{
+		if (IsWindowed())
+		{
+			if (!reanchorRequested)
+			{
+				// Re-render from the renderer's nearest seek anchor instead of waiting for (or having lost) the target.
+				const bool isFarAhead = target > _renderedEnd + _ringSize / 2;
+				if (target < _validStart || isFarAhead)
+				{
+					_reanchorRequest = target;
+					reanchorRequested = true;
+				}
+			}
+			else if (_anchorGeneration != initialAnchorGeneration)
+			{
+				target = std::max<size_t>(target, _validStart); // Renderer may have landed slightly past the target.
+				_seekTarget = target;
+			}
+		}
+		else if (IsSeekPriority())
+		{
+			const size_t jumpStart = _jumpStart;
+			if (jumpRequested && jumpStart != NO_JUMP && target < jumpStart && target > _renderedEnd)
+			{
+				target = jumpStart; // Jumping renderer may have landed slightly past the target.
+				continue;
+			}
+
+			if (!jumpRequested && IsWorthJumping(target))
+			{
+				StartJump(target);
+				jumpRequested = true;
+			}
+		}
+
+		const int availTimeMs = _renderedEnd / _stridePerMs;
 		if (callback(availTimeMs, false))
 		{
+			_seekTarget = SIZE_MAX;
 			return;
 		}
 
-		availTimeMs = (_preRenderedSize / sizeof(short)) / _stridePerMs;
+		seenGeneration = WaitForProgress(seenGeneration);
+	}
+
+	_playbackPosition = target;
+	_seekTarget = SIZE_MAX;
+	callback(static_cast<int>(target / _stridePerMs), true);
+}
+
+bool PreRender::TryPrepare(int sampleRate, int numChannels, int durationMs, int windowMs, const AbortableRendererSeeker& seekRenderer)
+{
+	AbortPreRender();
+	_stems.clear();
+
+	const double sampleRatePerMs = sampleRate / 1000.0;
+	_numChannels = numChannels;
+	_stridePerMs = sampleRatePerMs * numChannels;
+
+	const size_t granuleSize = GRANULARITY * _numChannels;
+	const size_t totalSize = static_cast<size_t>(std::ceil(durationMs * sampleRatePerMs)) * _numChannels;
+	size_t ringSize = totalSize;
+
+	if (windowMs > 0 && seekRenderer != nullptr)
+	{
+		// Whole granules only, so the ring wraps around as little as possible (and at least two, so a granule always fits in front of the kept part behind the play head).
+		const size_t windowSize = static_cast<size_t>(std::ceil(windowMs * sampleRatePerMs)) * _numChannels;
+		ringSize = std::min(totalSize, std::max<size_t>(2, windowSize / granuleSize) * granuleSize);
+	}
+
+	UnlockMemory();
+	short* result = static_cast<short*>(realloc(_waveBufferContent, ringSize * sizeof(short)));
+	if (result == nullptr)
+	{
+		DestroyData();
+		return false;
+	}
+
+	_waveBufferContent = result;
+	_ringSize = ringSize;
+	_totalSize = totalSize;
+	_seekRenderer = (ringSize < totalSize) ? seekRenderer : nullptr;
+
+	_playbackPosition = 0;
+	_validStart = 0;
+	_renderedEnd = 0;
+	_reanchorRequest = SIZE_MAX;
+	_seekTarget = SIZE_MAX;
+	_abortPreRenderFlag = false;
+
+	_lanes[0] = {};
+	_lanes[1] = {};
+	_frontLane = 0;
+	_jumpStart = NO_JUMP;
+	_jumpEnd = 0;
+	_abortJumpFlag = false;
+
+	LockMemory(); // Reminder: before any rendering starts.
+	return true;
+}
+
+bool PreRender::TryMixStems(short* out, unsigned long framesPerBuffer)
+{
+	const size_t length = framesPerBuffer * _numChannels;
+	_playbackPosition += length;
+
+	if (_mixScratch.size() < length)
+	{
+		_mixScratch.resize(length); // Shouldn't happen, audio buffers are normally much smaller than the granule.
+		_stemScratch.resize(length);
+	}
+
+	std::fill_n(_mixScratch.begin(), length, 0.0f);
+	for (size_t i = 0; i < _stems.size(); ++i)
+	{
+		PreRender& stem = *_stems[i];
+		stem.TryFillBuffer(_stemScratch.data(), framesPerBuffer); // Reminder: always, to keep all the stems in sync.
+
+		const float gain = _stemGains[i];
+		if (gain == 0.0f)
+		{
+			continue;
+		}
+
+		if (stem._numChannels == _numChannels)
+		{
+			for (size_t pos = 0; pos < length; ++pos)
+			{
+				_mixScratch[pos] += gain * _stemScratch[pos];
+			}
+		}
+		else // Mono stem
+		{
+			for (size_t frame = 0; frame < framesPerBuffer; ++frame)
+			{
+				const float sample = gain * _stemScratch[frame];
+				for (int channel = 0; channel < _numChannels; ++channel)
+				{
+					_mixScratch[frame * _numChannels + channel] += sample;
+				}
+			}
+		}
+	}
+
+	for (size_t pos = 0; pos < length; ++pos)
+	{
+		out[pos] = static_cast<short>(std::clamp(std::round(_mixScratch[pos]), -32768.0f, 32767.0f));
+	}
+
+	return true;
+}
+
+bool PreRender::IsWindowed() const
+{
+	return _ringSize < _totalSize;
+}
+
+bool PreRender::IsRendered(size_t position, size_t length) const
+{
+	// Reminder: read the jump range first, since the front lane takes it over by extending the _renderedEnd before discarding it.
+	const size_t jumpStart = _jumpStart;
+	const size_t jumpEnd = _jumpEnd;
+	if (position >= _validStart && position + length <= _renderedEnd)
+	{
+		return true;
+	}
+
+	return jumpStart != NO_JUMP && position >= jumpStart && position + length <= jumpEnd;
+}
+
+bool PreRender::IsSeekPriority() const
+{
+	return _lanes[1].renderer != nullptr;
+}
+
+bool PreRender::IsWorthJumping(size_t target) const
+{
+	const size_t renderedEnd = _renderedEnd;
+	const size_t minDistance = static_cast<size_t>(JUMP_MIN_DISTANCE_MS * _stridePerMs);
+	return target >= renderedEnd + minDistance && (target - renderedEnd) * FAST_FORWARD_SPEEDUP > target;
+}
+
+void PreRender::StartJump(size_t target)
+{
+	// Reuse the other lane, dropping its previous jump (if any).
+	int jumpLane = 0;
+	{
+		std::lock_guard<std::mutex> lock(_laneMutex);
+		jumpLane = 1 - _frontLane;
+		_abortJumpFlag = true; // Also holds the front lane back from taking over the range of the dropped jump.
+	}
+
+	if (_laneThreads[jumpLane].joinable())
+	{
+		_laneThreads[jumpLane].join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_laneMutex);
+		_jumpStart = NO_JUMP;
+		_abortJumpFlag = false;
+	}
+
+	PublishProgress(); // Releases the front lane if it was held back by the dropped jump.
+	_laneThreads[jumpLane] = std::thread([this, jumpLane, target] { RunJumpLane(jumpLane, target); });
+}
+
+void PreRender::RunJumpLane(int lane, size_t target)
+{
+	const uint_least32_t reachedTimeMs = _lanes[lane].seeker(static_cast<uint_least32_t>(target / _stridePerMs), [this](int /*cTimeMs*/, bool /*done*/) -> bool
+	{
+		return _abortPreRenderFlag || _abortJumpFlag;
+	});
+
+	const size_t start = ToSamplePosition(reachedTimeMs);
+	{
+		std::lock_guard<std::mutex> lock(_laneMutex);
+
+		// The front lane's chunk in progress must not reach into the jump range.
+		if (_abortPreRenderFlag || _abortJumpFlag || start >= _totalSize || start < _renderedEnd + GRANULARITY * _numChannels)
+		{
+			return; // Aborted, or the front lane got there first anyway.
+		}
+
+		_jumpEnd = start;
+		_jumpStart = start;
+	}
+
+	PublishProgress();
+	RenderLane(lane, start);
+}
+
+void PreRender::RenderLane(int lane, size_t position)
+{
+	const size_t granuleSize = GRANULARITY * _numChannels;
+
+	while (!_abortPreRenderFlag)
+	{
+		const uint_least64_t seenGeneration = _progressGeneration; // Reminder: before checking the jump, so dropping it in the meantime isn't missed.
+		size_t limit = _totalSize;
+		bool holdBack = false;
+		{
+			std::lock_guard<std::mutex> lock(_laneMutex);
+			if (_frontLane != lane)
+			{
+				if (_abortJumpFlag)
+				{
+					return;
+				}
+			}
+			else if (_jumpStart != NO_JUMP)
+			{
+				if (position >= _jumpStart)
+				{
+					if (!_abortJumpFlag)
+					{
+						// Caught up with the jump: the other lane is the front one from now on, this one's renderer is free for the next jump.
+						_renderedEnd = _jumpEnd.load();
+						_jumpStart = NO_JUMP;
+						_frontLane = 1 - lane;
+						break;
+					}
+
+					holdBack = true; // Until the jump is dropped (then continue past it).
+				}
+
+				limit = _jumpStart;
+			}
+		}
+
+		if (holdBack)
+		{
+			WaitForProgress(seenGeneration);
+			continue;
+		}
+
+		if (position >= limit)
+		{
+			return; // Done.
+		}
+
+		const size_t chunk = std::min(granuleSize, limit - position);
+		const bool success = _lanes[lane].renderer->TryFillBuffer(_waveBufferContent + position, chunk / _numChannels);
+		if (!success)
+		{
+			std::lock_guard<std::mutex> lock(_laneMutex);
+			if (_frontLane != lane)
+			{
+				_jumpStart = NO_JUMP; // Drop the jump (as an abort does), so the front lane renders past it rather than taking it over.
+				break;
+			}
+
+			return; // Leave the rest silent.
+		}
+
+		position += chunk;
+
+		{
+			std::lock_guard<std::mutex> lock(_laneMutex);
+			if (_frontLane == lane)
+			{
+				_renderedEnd = position;
+			}
+			else
+			{
+				_jumpEnd = position;
+			}
+		}
+
+		PublishProgress();
+	}
+
+	PublishProgress(); // Merged with the jump (or dropped, or aborted).
+}
+
+void PreRender::LockMemory()
+{
+	if (_memoryLocking && _lockedSize == 0 && _waveBufferContent != nullptr)
+	{
+		const size_t size = _ringSize * sizeof(short);
+		_lockedSize = (RealtimeUtil::TryPrefaultAndLock(_waveBufferContent, size)) ? size : 0;
+	}
+}
+
+void PreRender::UnlockMemory()
+{
+	if (_lockedSize != 0)
+	{
+		RealtimeUtil::Unlock(_waveBufferContent, _lockedSize);
+		_lockedSize = 0;
+	}
+}
+
+size_t PreRender::ToSamplePosition(uint_least32_t timeMs) const
+{
+	const size_t position = static_cast<size_t>(timeMs * _stridePerMs);
+	return position - position % _numChannels;
+}
+
+bool PreRender::TryReanchor(size_t targetPosition)
+{
+	// Reminder: a far seek can take a while (fast-forwarding past the last seek anchor), so don't hold up the stopping, nor the newer seeks (repeated scrubbing would queue up the fast-forwards otherwise).
+	const auto isObsolete = [this, targetPosition]()
+	{
+		return _abortPreRenderFlag || IsReanchoringSuperseded() || _seekTarget != targetPosition;
+	};
+
+	const uint_least32_t reachedTimeMs = _seekRenderer(static_cast<uint_least32_t>(targetPosition / _stridePerMs), [&isObsolete](int /*cTimeMs*/, bool /*done*/) -> bool
+	{
+		return isObsolete();
+	});
+
+	if (isObsolete())
+	{
+		return false; // Anchor left as it is.
+	}
+
+	const size_t origin = std::min(ToSamplePosition(reachedTimeMs), static_cast<size_t>(_totalSize));
+
+	_renderedEnd = origin;
+	_validStart = origin;
+	_playbackPosition = origin;
+	++_anchorGeneration;
+	PublishProgress();
+	return true;
+}
+
+bool PreRender::TryResyncRenderer(IBufferWriter& renderer)
+{
+	// Seek a bit earlier (the renderer lands on its own seek step, i.e., likely past the target) and render the rest of the way to nowhere.
+	const size_t renderedEnd = _renderedEnd;
+	size_t position = 0;
+	for (const size_t margin : {ToSamplePosition(RESYNC_MARGIN_MS), renderedEnd}) // From the very start as the last resort.
+	{
+		const size_t from = (renderedEnd > margin) ? renderedEnd - margin : 0;
+		const uint_least32_t reachedTimeMs = _seekRenderer(static_cast<uint_least32_t>(from / _stridePerMs), [this](int /*cTimeMs*/, bool /*done*/) -> bool
+		{
+			return _abortPreRenderFlag || IsReanchoringSuperseded();
+		});
+
+		if (_abortPreRenderFlag || IsReanchoringSuperseded())
+		{
+			return false;
+		}
+
+		position = ToSamplePosition(reachedTimeMs);
+		if (position <= renderedEnd)
+		{
+			break;
+		}
+	}
+
+	std::vector<short> discarded(GRANULARITY * _numChannels);
+	while (position < renderedEnd && !_abortPreRenderFlag)
+	{
+		const size_t chunk = std::min(discarded.size(), renderedEnd - position);
+		if (!renderer.TryFillBuffer(discarded.data(), chunk / _numChannels))
+		{
+			break; // Let the render loop find out.
+		}
+
+		position += chunk;
 	}
 
-	const size_t wantedPlaybackPosition = timeMs * _stridePerMs;
-	_playbackPosition = std::min(wantedPlaybackPosition, static_cast<size_t>(_waveBufferSize) / sizeof(short));
-	callback(timeMs, true);
+	return true;
+}
+
+bool PreRender::IsReanchoringSuperseded() const
+{
+	return _reanchorRequest != NO_REANCHOR_REQUEST;
+}
+
+void PreRender::PublishProgress()
+{
+	{
+		std::lock_guard<std::mutex> lock(_progressMutex);
+		++_progressGeneration;
+	}
+
+	_progressCv.notify_all();
+}
+
+uint_least64_t PreRender::WaitForProgress(uint_least64_t seenGeneration)
+{
+	std::unique_lock<std::mutex> lock(_progressMutex);
+	_progressCv.wait_for(lock, PROGRESS_WAIT_TIMEOUT, [this, seenGeneration] { return _progressGeneration != seenGeneration; });
+	return _progressGeneration;
 }
 
 void PreRender::AbortPreRender()
 {
-	if (_thread.joinable())
+	for (std::unique_ptr<PreRender>& stem : _stems)
+	{
+		stem->AbortPreRender();
+	}
+
+	_abortPreRenderFlag = true;
+	for (std::thread* thread : {&_thread, &_laneThreads[0], &_laneThreads[1]})
 	{
-		_abortPreRenderFlag = true;
-		_thread.join();
+		if (thread->joinable())
+		{
+			thread->join();
+		}
 	}
 
 	_abortPreRenderFlag = false;
@@ -154,8 +815,18 @@ void PreRender::DestroyData()
 {
 	AbortPreRender();
 
+	_stems.clear();
+	_stemGains = nullptr;
+	_lanes[0] = {};
+	_lanes[1] = {};
+	_jumpStart = NO_JUMP;
+	_jumpEnd = 0;
+
+	UnlockMemory();
 	free(_waveBufferContent);
 	_waveBufferContent = nullptr;
-	_waveBufferSize = 0;
-	_preRenderedSize = 0;
+	_ringSize = 0;
+	_totalSize = 0;
+	_validStart = 0;
+	_renderedEnd = 0;
 }
@@ -20,11 +20,32 @@
 
 #include "PlaybackWrappers\IBufferWriter.h"
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 class PreRender : public IBufferWriter
 {
+public:
+	/// @brief Seeks the renderer (e.g., via its nearest seek anchor) and returns its actual resulting time, giving up as soon as the callback returns true.
+	using AbortableRendererSeeker = std::function<uint_least32_t(uint_least32_t timeMs, const SeekStatusCallback& callback)>;
+
+	struct Lane
+	{
+		IBufferWriter* renderer;
+		AbortableRendererSeeker seeker;
+	};
+
+	struct StemSource
+	{
+		IBufferWriter* renderer;
+		int numChannels; // Either 1 (spread to all output channels) or the output channel count.
+	};
+
 public:
 	PreRender() = default;
 	PreRender(PreRender&) = delete;
@@ -32,17 +53,79 @@ public:
 	~PreRender();
 
 public:
-	void DoPreRender(IBufferWriter& renderer, int sampleRate, int numChannels, int durationMs);
+	/// @brief Pre-renders the whole duration, or just a bounded window of it around the play head if windowMs (and a seeker) is provided and the duration exceeds it.
+	void DoPreRender(IBufferWriter& renderer, int sampleRate, int numChannels, int durationMs, int windowMs = 0, const AbortableRendererSeeker& seekRenderer = nullptr);
+
+	/// @brief Seek-priority variant of the (non-windowed) DoPreRender: seeking far ahead of the rendered part makes the other lane's renderer jump straight there and continue from that point,
+	/// while the one behind just fills in the gap up to it (then it's free for the next jump).
+	void DoPreRenderSeekPriority(const Lane& first, const Lane& second, int sampleRate, int numChannels, int durationMs);
+
+	/// @brief Pre-renders the whole duration of each stem (in parallel, never windowed) and mixes them on playback according to the stem gains (all 1.0 initially).
+	void DoPreRenderStems(const std::vector<StemSource>& stems, int sampleRate, int numChannels, int durationMs);
+
+	/// @brief Takes effect immediately (from the next audio buffer). Stem mode only.
+	void SetStemGain(size_t stemIndex, float gain);
+	bool HasStems() const;
+
+	/// @brief Takes over the complete pre-rendered content of another instance (which is left empty). Returns false if the source's pre-render is not yet complete.
+	bool TryAdoptCompleted(PreRender& source);
+
+	/// @brief Like TryAdoptCompleted but the source's (plain, non-windowed) pre-render may still be in progress: it's stopped and the rest is rendered here, continuing from the sourceRenderer (which must outlive this rendering).
+	bool TryAdoptRunning(PreRender& source, IBufferWriter& sourceRenderer);
+
+	/// @brief Keeps the content pre-faulted and locked in RAM (see RealtimeUtil) so the playback never page-faults. Takes effect from the next DoPreRender* or TryAdoptCompleted.
+	void SetMemoryLocking(bool enable);
+
+	/// @brief Whether all of the held content (including all the stems) got locked in RAM.
+	bool IsMemoryLocked() const;
+
 	bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override;
 
 public:
 	int GetCurrentSongTimeMs() const;
 	double GetPreRenderProgressFactor() const;
 
+	/// @brief Whether the entire duration is rendered and held in memory (never the case in windowed mode).
+	bool IsFullyAvailable() const;
+
+	/// @brief Size of the held content (including all the stems) in bytes.
+	size_t GetMemorySize() const;
+
 	void Stop();
 	void SeekTo(int timeMs, const SeekStatusCallback& callback);
 
 private:
+	bool TryPrepare(int sampleRate, int numChannels, int durationMs, int windowMs, const AbortableRendererSeeker& seekRenderer);
+	void StartRenderThread(IBufferWriter& renderer);
+	bool TryMixStems(short* out, unsigned long framesPerBuffer);
+
+	bool IsWindowed() const;
+	bool IsRendered(size_t position, size_t length) const;
+
+	bool IsSeekPriority() const;
+	bool IsWorthJumping(size_t target) const;
+	void StartJump(size_t target);
+	void RunJumpLane(int lane, size_t target);
+	void RenderLane(int lane, size_t position);
+
+	/// @brief Wakes up whoever waits for more content to become available (called at the chunk granularity).
+	void PublishProgress();
+
+	/// @brief Blocks until the next PublishProgress (or a short timeout, so the waiter can check for its own abort request) and returns the new progress generation.
+	uint_least64_t WaitForProgress(uint_least64_t seenGeneration);
+
+	void LockMemory();
+	void UnlockMemory();
+
+	size_t ToSamplePosition(uint_least32_t timeMs) const;
+
+	/// @brief Returns false if it gave up (on abort, or superseded by a newer seek), leaving the anchor as it is but the renderer possibly elsewhere (see TryResyncRenderer).
+	bool TryReanchor(size_t targetPosition);
+
+	/// @brief Brings the renderer back to the _renderedEnd after an abandoned re-anchoring. Returns false if it gave up too.
+	bool TryResyncRenderer(IBufferWriter& renderer);
+	bool IsReanchoringSuperseded() const;
+
 	void AbortPreRender();
 	void DestroyData();
 
@@ -50,11 +133,42 @@ private:
 	int _numChannels = 0;
 	double _stridePerMs = 0; // _sampleRatePerMs * _numChannels
 
-	size_t _playbackPosition = 0;
+	// Reminder: all positions are in samples (i.e., frames * _numChannels) since the song start.
+	std::atomic_size_t _playbackPosition = 0;
 
 	std::thread _thread;
-	std::atomic<short*> _waveBufferContent = nullptr;
-	std::atomic_size_t _waveBufferSize = 0;
-	std::atomic_size_t _preRenderedSize = 0;
+	std::atomic<short*> _waveBufferContent = nullptr; // Ring of _ringSize samples (not wrapping around unless windowed).
+	std::atomic_size_t _ringSize = 0;
+	std::atomic_size_t _totalSize = 0;
+	std::atomic_size_t _validStart = 0; // Oldest position still held in the ring.
+	std::atomic_size_t _renderedEnd = 0;
 	std::atomic_bool _abortPreRenderFlag = false;
+
+	bool _memoryLocking = false;
+	size_t _lockedSize = 0; // Bytes of the _waveBufferContent locked in RAM.
+
+	std::atomic_uint_least64_t _progressGeneration = 0; // Reminder: modified only while holding the _progressMutex.
+	std::mutex _progressMutex;
+	std::condition_variable _progressCv;
+
+	// Windowed mode
+	AbortableRendererSeeker _seekRenderer;
+	std::atomic_size_t _reanchorRequest = SIZE_MAX;
+	std::atomic_size_t _seekTarget = SIZE_MAX; // Play head-to-be while SeekTo waits for it to be rendered.
+	std::atomic_uint _anchorGeneration = 0;
+
+	// Seek priority mode (the lanes swap their roles whenever the front one catches up with the one which jumped ahead)
+	Lane _lanes[2] = {};
+	std::thread _laneThreads[2];
+	std::atomic_int _frontLane = 0;
+	std::atomic_size_t _jumpStart = SIZE_MAX; // Range rendered by the other (non-front) lane, if any.
+	std::atomic_size_t _jumpEnd = 0;
+	std::atomic_bool _abortJumpFlag = false;
+	std::mutex _laneMutex;
+
+	// Stem mode
+	std::vector<std::unique_ptr<PreRender>> _stems;
+	std::unique_ptr<std::atomic<float>[]> _stemGains;
+	std::vector<short> _stemScratch;
+	std::vector<float> _mixScratch;
 };
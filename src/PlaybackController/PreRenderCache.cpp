@@ -0,0 +1,135 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "PreRenderCache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint_least64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    constexpr uint_least64_t FNV_PRIME = 1099511628211ull;
+
+    template <typename T>
+    void HashValue(uint_least64_t& hash, const T& value)
+    {
+        unsigned char bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T));
+        for (const unsigned char byte : bytes)
+        {
+            hash = (hash ^ byte) * FNV_PRIME;
+        }
+    }
+}
+
+// Key inner struct -------------------------------------------
+
+bool PreRenderCache::Key::operator==(const Key& other) const
+{
+    return subsong == other.subsong && durationMs == other.durationMs && configHash == other.configHash && tuneMd5 == other.tuneMd5;
+}
+
+// PreRenderCache main class ----------------------------------
+
+uint_least64_t PreRenderCache::HashConfig(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig)
+{
+    uint_least64_t hash = FNV_OFFSET_BASIS;
+    HashValue(hash, sidConfig.frequency);
+    HashValue(hash, static_cast<int>(sidConfig.playback));
+    HashValue(hash, static_cast<int>(sidConfig.samplingMethod));
+    HashValue(hash, sidConfig.fastSampling);
+    HashValue(hash, static_cast<int>(sidConfig.defaultC64Model));
+    HashValue(hash, static_cast<int>(sidConfig.defaultSidModel));
+    HashValue(hash, sidConfig.forceC64Model);
+    HashValue(hash, sidConfig.forceSidModel);
+    HashValue(hash, sidConfig.digiBoost);
+    HashValue(hash, sidConfig.powerOnDelay);
+    HashValue(hash, sidConfig.secondSidAddress);
+    HashValue(hash, sidConfig.thirdSidAddress);
+    HashValue(hash, filterConfig.filterEnabled);
+    HashValue(hash, filterConfig.filter6581Curve);
+    HashValue(hash, filterConfig.filter8580Curve);
+    return hash;
+}
+
+void PreRenderCache::SetBudget(size_t bytes)
+{
+    _budget = bytes;
+    EvictToFit(0);
+}
+
+bool PreRenderCache::TryStore(const Key& key, PreRender& source)
+{
+    const size_t size = source.GetMemorySize();
+    if (!source.IsFullyAvailable() || size > _budget)
+    {
+        return false;
+    }
+
+    const auto it = std::find_if(_entries.begin(), _entries.end(), [&key](const Entry& entry) { return entry.key == key; });
+    if (it != _entries.end()) // Normally not there (since it was taken), but just in case.
+    {
+        _usedSize -= it->size;
+        _entries.erase(it);
+    }
+
+    EvictToFit(size);
+
+    std::unique_ptr<PreRender> preRender = std::make_unique<PreRender>();
+    preRender->TryAdoptCompleted(source);
+    _entries.push_front({key, std::move(preRender), size});
+    _usedSize += size;
+    return true;
+}
+
+bool PreRenderCache::TryTake(const Key& key, bool acceptMixed, PreRender& target)
+{
+    const auto it = std::find_if(_entries.begin(), _entries.end(), [&key](const Entry& entry) { return entry.key == key; });
+    if (it == _entries.end() || (!acceptMixed && !it->preRender->HasStems()))
+    {
+        return false;
+    }
+
+    const bool success = target.TryAdoptCompleted(*it->preRender);
+    _usedSize -= it->size;
+    _entries.erase(it);
+    return success;
+}
+
+bool PreRenderCache::Contains(const std::wstring& filepath, unsigned int subsong, int durationMs, uint_least64_t configHash) const
+{
+    return std::any_of(_entries.begin(), _entries.end(), [&](const Entry& entry)
+    {
+        return entry.key.subsong == subsong && entry.key.durationMs == durationMs && entry.key.configHash == configHash && entry.key.filepath == filepath;
+    });
+}
+
+void PreRenderCache::Clear()
+{
+    _entries.clear();
+    _usedSize = 0;
+}
+
+void PreRenderCache::EvictToFit(size_t size)
+{
+    while (!_entries.empty() && _usedSize + size > _budget)
+    {
+        _usedSize -= _entries.back().size;
+        _entries.pop_back();
+    }
+}
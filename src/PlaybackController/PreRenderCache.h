@@ -0,0 +1,81 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PreRender.h"
+#include "PlaybackWrappers/Input/SidDecoder.h"
+#include "Util/Md5Lanes.h"
+
+#include <list>
+#include <memory>
+#include <string>
+
+/// @brief Keeps the complete pre-renders of the recently played subsongs (within a memory budget, least recently used ones are evicted first) so revisiting them starts instantly.
+class PreRenderCache
+{
+public:
+    struct Key
+    {
+        Md5Lanes::Digest tuneMd5;
+        unsigned int subsong;
+        int durationMs;
+        uint_least64_t configHash; // See HashConfig().
+        std::wstring filepath; // Not part of the identity (the file may have changed since), just lets the Contains() skip the hashing.
+
+        bool operator==(const Key& other) const;
+    };
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::unique_ptr<PreRender> preRender;
+        size_t size;
+    };
+
+public:
+    PreRenderCache() = default;
+    PreRenderCache(PreRenderCache&) = delete;
+
+public:
+    /// @brief Identifies the emulation parameters affecting the rendered content.
+    static uint_least64_t HashConfig(const SidConfig& sidConfig, const SidDecoder::FilterConfig& filterConfig);
+
+    /// @brief Sets the memory budget, evicting the least recently used entries exceeding it. Pass 0 to disable.
+    void SetBudget(size_t bytes);
+
+    /// @brief Moves a complete pre-render into the cache (the source is left empty), evicting the least recently used entries as needed. Returns false if it's not complete or doesn't fit within the budget at all.
+    bool TryStore(const Key& key, PreRender& source);
+
+    /// @brief Moves a cached pre-render into the target (it's stored back once it's replaced there). Mixed (i.e., not per-voice) pre-renders are all-voices-enabled ones, and are only taken if acceptMixed.
+    bool TryTake(const Key& key, bool acceptMixed, PreRender& target);
+
+    /// @brief Whether a pre-render of the file's subsong is cached (as of when the file was stored, see the Key::filepath).
+    bool Contains(const std::wstring& filepath, unsigned int subsong, int durationMs, uint_least64_t configHash) const;
+
+    void Clear();
+
+private:
+    void EvictToFit(size_t size);
+
+private:
+    std::list<Entry> _entries; // Most recently used first.
+    size_t _budget = 0;
+    size_t _usedSize = 0;
+};
@@ -0,0 +1,280 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "RenderAheadBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+namespace
+{
+    constexpr size_t CHUNK_FRAMES = 256; // Render granularity of the producer thread.
+    constexpr size_t MIN_CALLBACKS_BUFFERED = 2;
+    constexpr std::chrono::milliseconds PRODUCER_IDLE_SLEEP(1);
+    constexpr uint_least32_t LOAD_HISTOGRAM_STEP_PERMILLE = 50;
+    constexpr double HIGH_LOAD_PERCENTILE = 0.99;
+}
+
+RenderAheadBuffer::~RenderAheadBuffer()
+{
+    Halt();
+    UnlockRing();
+}
+
+void RenderAheadBuffer::SetDepthMs(unsigned int depthMs)
+{
+    _depthMs = depthMs;
+}
+
+unsigned int RenderAheadBuffer::GetDepthMs() const
+{
+    return _depthMs;
+}
+
+void RenderAheadBuffer::Start(IBufferWriter& source, int sampleRate, int numChannels, unsigned long framesPerCallback)
+{
+    Halt();
+
+    _source = &source;
+    _sampleRate = sampleRate;
+    _numChannels = numChannels;
+    _started = true;
+
+    UnlockRing();
+    _realtimeGrants = {};
+
+    // A ring not holding at least two callbacks' worth would underrun on every callback (as the consumer would always be waiting for the producer).
+    const size_t depthSamples = static_cast<size_t>(static_cast<uint_least64_t>(_depthMs) * _sampleRate / 1000) * _numChannels;
+    const size_t minSamples = static_cast<size_t>(framesPerCallback) * MIN_CALLBACKS_BUFFERED * _numChannels;
+    if (_depthMs == 0 || depthSamples < minSamples)
+    {
+        _ring.clear();
+        _ring.shrink_to_fit();
+        return; // Pass-through mode.
+    }
+
+    // Round up to whole chunks so the producer never has to split a chunk due to the capacity limit.
+    const size_t chunkSamples = CHUNK_FRAMES * _numChannels;
+    const size_t capacity = std::max<size_t>(1, (depthSamples + chunkSamples - 1) / chunkSamples) * chunkSamples;
+
+    _ring.assign(capacity, 0);
+    _scratch.assign(chunkSamples, 0);
+
+    if (_realtime)
+    {
+        _realtimeGrants.memoryLocked = RealtimeUtil::TryPrefaultAndLock(_ring.data(), _ring.size() * sizeof(short));
+    }
+
+    // Pre-fill so the stream doesn't start with an underrun.
+    while (_writeIndex - _readIndex < _ring.size() && TryRenderChunk())
+    {
+    }
+
+    _haltFlag = false;
+    _thread = std::thread([this]()
+    {
+        while (!_haltFlag && !_sourceFailed)
+        {
+            const size_t freeSamples = _ring.size() - (_writeIndex.load(std::memory_order_relaxed) - _readIndex.load(std::memory_order_acquire));
+            if (freeSamples < _scratch.size())
+            {
+                std::this_thread::sleep_for(PRODUCER_IDLE_SLEEP);
+                continue;
+            }
+
+            const std::chrono::steady_clock::time_point chunkStart = std::chrono::steady_clock::now();
+            if (TryRenderChunk())
+            {
+                const double chunkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - chunkStart).count();
+                const uint_least32_t loadPermille = static_cast<uint_least32_t>(chunkSeconds * _sampleRate * 1000.0 / CHUNK_FRAMES);
+                _loadHistogram[std::min<size_t>(loadPermille / LOAD_HISTOGRAM_STEP_PERMILLE, LOAD_HISTOGRAM_SIZE - 1)].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    if (_realtime)
+    {
+        _realtimeGrants.realtimeScheduling = RealtimeUtil::TryMakeThreadRealtime(_thread);
+        _realtimeGrants.cpuPinned = RealtimeUtil::TryPinThread(_thread, _realtimeCpuCore);
+    }
+}
+
+void RenderAheadBuffer::Halt()
+{
+    if (_thread.joinable())
+    {
+        _haltFlag = true;
+        _thread.join();
+    }
+
+    _started = false;
+    _haltFlag = false;
+    _sourceFailed = false;
+    _writeIndex = 0;
+    _readIndex = 0;
+}
+
+bool RenderAheadBuffer::IsRunning() const
+{
+    return _started;
+}
+
+bool RenderAheadBuffer::IsBuffering() const
+{
+    return _started && !_ring.empty();
+}
+
+void RenderAheadBuffer::SetRealtime(bool enable, int cpuCore)
+{
+    _realtime = enable;
+    _realtimeCpuCore = cpuCore;
+}
+
+RealtimeUtil::Grants RenderAheadBuffer::GetRealtimeGrants() const
+{
+    return _realtimeGrants;
+}
+
+bool RenderAheadBuffer::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
+{
+    if (_ring.empty())
+    {
+        return _source != nullptr && _source->TryFillBuffer(buffer, framesPerBuffer); // Pass-through mode.
+    }
+
+    short* const out = static_cast<short*>(buffer);
+    const size_t wanted = framesPerBuffer * _numChannels;
+    const size_t readIndex = _readIndex.load(std::memory_order_relaxed);
+    const size_t available = _writeIndex.load(std::memory_order_acquire) - readIndex;
+
+    if (available == 0 && _sourceFailed)
+    {
+        return false;
+    }
+
+    // Copy (in up to two parts due to wrap-around)
+    const size_t amount = std::min(wanted, available);
+    const size_t ringPos = readIndex % _ring.size();
+    const size_t firstPart = std::min(amount, _ring.size() - ringPos);
+    memcpy(out, _ring.data() + ringPos, firstPart * sizeof(short));
+    memcpy(out + firstPart, _ring.data(), (amount - firstPart) * sizeof(short));
+
+    _readIndex.store(readIndex + amount, std::memory_order_release);
+
+    if (amount < wanted)
+    {
+        memset(out + amount, 0, (wanted - amount) * sizeof(short));
+        if (!_sourceFailed)
+        {
+            ++_underruns;
+            ++_statsUnderruns;
+        }
+    }
+
+    return true;
+}
+
+uint_least32_t RenderAheadBuffer::GetBufferedMs() const
+{
+    if (_ring.empty() || _sampleRate == 0)
+    {
+        return 0;
+    }
+
+    return static_cast<uint_least32_t>(GetBufferedFrames() * 1000 / _sampleRate);
+}
+
+uint_least64_t RenderAheadBuffer::GetBufferedFrames() const
+{
+    if (_ring.empty() || _numChannels == 0)
+    {
+        return 0;
+    }
+
+    return (_writeIndex - _readIndex) / _numChannels;
+}
+
+double RenderAheadBuffer::GetFillFactor() const
+{
+    if (_ring.empty())
+    {
+        return 0.0;
+    }
+
+    return std::clamp(static_cast<double>(_writeIndex - _readIndex) / _ring.size(), 0.0, 1.0);
+}
+
+uint_least64_t RenderAheadBuffer::GetUnderrunCount() const
+{
+    return _underruns;
+}
+
+RenderAheadBuffer::ProducerStats RenderAheadBuffer::TakeProducerStats()
+{
+    ProducerStats stats;
+    stats.underruns = _statsUnderruns.exchange(0);
+
+    uint_least32_t histogram[LOAD_HISTOGRAM_SIZE];
+    uint_least64_t chunks = 0;
+    for (size_t step = 0; step < LOAD_HISTOGRAM_SIZE; ++step)
+    {
+        histogram[step] = _loadHistogram[step].exchange(0);
+        chunks += histogram[step];
+    }
+
+    uint_least64_t counted = 0;
+    for (size_t step = 0; step < LOAD_HISTOGRAM_SIZE && chunks > 0; ++step)
+    {
+        counted += histogram[step];
+        if (counted >= chunks * HIGH_LOAD_PERCENTILE)
+        {
+            stats.highLoad = (step + 1) * LOAD_HISTOGRAM_STEP_PERMILLE / 1000.0; // Upper bound of the step.
+            break;
+        }
+    }
+
+    return stats;
+}
+
+bool RenderAheadBuffer::TryRenderChunk()
+{
+    if (!_source->TryFillBuffer(_scratch.data(), CHUNK_FRAMES))
+    {
+        _sourceFailed = true;
+        return false;
+    }
+
+    // Copy (in up to two parts due to wrap-around)
+    const size_t writeIndex = _writeIndex.load(std::memory_order_relaxed);
+    const size_t ringPos = writeIndex % _ring.size();
+    const size_t firstPart = std::min(_scratch.size(), _ring.size() - ringPos);
+    memcpy(_ring.data() + ringPos, _scratch.data(), firstPart * sizeof(short));
+    memcpy(_ring.data(), _scratch.data() + firstPart, (_scratch.size() - firstPart) * sizeof(short));
+
+    _writeIndex.store(writeIndex + _scratch.size(), std::memory_order_release);
+    return true;
+}
+
+void RenderAheadBuffer::UnlockRing()
+{
+    if (_realtimeGrants.memoryLocked)
+    {
+        RealtimeUtil::Unlock(_ring.data(), _ring.size() * sizeof(short));
+        _realtimeGrants.memoryLocked = false;
+    }
+}
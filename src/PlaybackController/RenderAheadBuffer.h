@@ -0,0 +1,109 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/IBufferWriter.h"
+#include "Util/RealtimeUtil.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/// @brief Renders ahead from the source in its own thread into a lock-free single-producer/single-consumer ring buffer, so the audio callback only has to copy the data. With a depth of 0 it just passes the calls through.
+class RenderAheadBuffer : public IBufferWriter
+{
+public:
+    struct ProducerStats
+    {
+        uint_least32_t underruns = 0; // Audio callbacks the ring couldn't fully serve.
+        double highLoad = 0.0; // Time spent rendering a chunk relative to its playback duration, the 99th percentile rounded up to 5 % (0 if nothing was rendered ahead).
+    };
+
+public:
+    RenderAheadBuffer() = default;
+    RenderAheadBuffer(RenderAheadBuffer&) = delete;
+
+    ~RenderAheadBuffer();
+
+public:
+    /// @brief Sets the ring buffer depth used from the next Start() on. Pass 0 to disable the buffering.
+    void SetDepthMs(unsigned int depthMs);
+    unsigned int GetDepthMs() const;
+
+    /// @brief Discards any buffered content, pre-fills the buffer from the source and starts the render thread. Source must not be accessed by anyone else until Halt().
+    /// The framesPerCallback is the largest request of the audio callback (0 if unknown): a depth not holding two of those just passes the calls through.
+    void Start(IBufferWriter& source, int sampleRate, int numChannels, unsigned long framesPerCallback);
+
+    /// @brief Stops the render thread and discards any buffered content. The audio stream must be stopped.
+    void Halt();
+
+    bool IsRunning() const;
+
+    /// @brief Whether the last Start() actually buffers (i.e., isn't in the pass-through mode).
+    bool IsBuffering() const;
+
+    /// @brief Real-time mode (see RealtimeUtil): locks the ring in RAM and runs the render thread with a real-time policy, pinned to the cpuCore (unless negative). Takes effect from the next Start().
+    void SetRealtime(bool enable, int cpuCore);
+
+    /// @brief What the real-time mode was granted on the last Start() (nothing if disabled or in the pass-through mode).
+    RealtimeUtil::Grants GetRealtimeGrants() const;
+
+    bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override; // Consumer side (audio callback).
+
+public:
+    uint_least32_t GetBufferedMs() const;
+    uint_least64_t GetBufferedFrames() const;
+    double GetFillFactor() const;
+    uint_least64_t GetUnderrunCount() const;
+
+    /// @brief Returns and resets the stats since the last call (tells how much headroom the render thread has, regardless of the audio callback's buffer size).
+    ProducerStats TakeProducerStats();
+
+private:
+    bool TryRenderChunk();
+    void UnlockRing();
+
+private:
+    unsigned int _depthMs = 0;
+
+    IBufferWriter* _source = nullptr;
+    int _sampleRate = 0;
+    int _numChannels = 0;
+
+    std::vector<short> _ring;
+    std::vector<short> _scratch;
+    std::atomic_size_t _writeIndex = 0; // Monotonic, in samples. Written by the producer only.
+    std::atomic_size_t _readIndex = 0; // Monotonic, in samples. Written by the consumer only.
+
+    bool _started = false;
+    std::thread _thread;
+    std::atomic_bool _haltFlag = false;
+    std::atomic_bool _sourceFailed = false;
+    std::atomic_uint_least64_t _underruns = 0;
+
+    // Producer stats (see TakeProducerStats)
+    static constexpr size_t LOAD_HISTOGRAM_SIZE = 21; // In 5 % steps, the last one is for 100 % and beyond.
+    std::atomic_uint_least32_t _statsUnderruns = 0;
+    std::atomic_uint_least32_t _loadHistogram[LOAD_HISTOGRAM_SIZE] = {}; // Chunk counts per load step.
+
+    // Real-time mode
+    bool _realtime = false;
+    int _realtimeCpuCore = -1;
+    RealtimeUtil::Grants _realtimeGrants;
+};
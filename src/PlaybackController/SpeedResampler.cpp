@@ -0,0 +1,249 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "SpeedResampler.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <string.h>
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    constexpr size_t KERNEL_ZERO_CROSSINGS = 8; // Per side, at the full bandwidth (the kernel gets wider as the cutoff is lowered).
+    constexpr double CUTOFF_MARGIN = 0.9; // Relative to the Nyquist frequency, so the transition band is (mostly) below it.
+    constexpr size_t KERNEL_PHASES = 512; // Table resolution per zero crossing (linearly interpolated in between).
+    constexpr size_t CeilToSize(double value)
+    {
+        const size_t truncated = static_cast<size_t>(value);
+        return (static_cast<double>(truncated) < value) ? truncated + 1 : truncated;
+    }
+
+    constexpr size_t KERNEL_MAX_HALF_WIDTH = CeilToSize(KERNEL_ZERO_CROSSINGS * SpeedResampler::MAX_SPEED_FACTOR / CUTOFF_MARGIN); // In source frames, at the lowest cutoff.
+
+    constexpr size_t TAPS_BEFORE = KERNEL_MAX_HALF_WIDTH; // Frames before the read position needed by the interpolation.
+    constexpr size_t TAPS_AFTER = KERNEL_MAX_HALF_WIDTH; // Frames after the read position needed by the interpolation.
+    constexpr size_t RESERVED_FRAMES = 16384; // Avoids reallocations in the audio callback for any sane buffer size.
+
+    using KernelTable = std::array<float, KERNEL_ZERO_CROSSINGS * KERNEL_PHASES + 2>; // Plus the guard for the interpolation past the last zero crossing.
+
+    /// @brief One side of the Blackman-windowed sinc, sampled in zero crossings.
+    const KernelTable& GetKernelTable()
+    {
+        static const KernelTable table = []()
+        {
+            KernelTable result{};
+            for (size_t i = 0; i <= KERNEL_ZERO_CROSSINGS * KERNEL_PHASES; ++i)
+            {
+                const double x = static_cast<double>(i) / KERNEL_PHASES;
+                const double sinc = (i == 0) ? 1.0 : std::sin(PI * x) / (PI * x);
+                const double u = x / KERNEL_ZERO_CROSSINGS;
+                const double window = 0.42 + 0.5 * std::cos(PI * u) + 0.08 * std::cos(2.0 * PI * u);
+                result[i] = static_cast<float>(sinc * window);
+            }
+
+            return result;
+        }();
+
+        return table;
+    }
+
+    inline float Kernel(const KernelTable& table, float zeroCrossings)
+    {
+        const float index = std::fabs(zeroCrossings) * KERNEL_PHASES;
+        const size_t i = static_cast<size_t>(index);
+        if (i >= KERNEL_ZERO_CROSSINGS * KERNEL_PHASES)
+        {
+            return 0.0f;
+        }
+
+        const float f = index - i;
+        return table[i] + (table[i + 1] - table[i]) * f;
+    }
+
+    inline short ToSample(float value)
+    {
+        return static_cast<short>(std::clamp(std::lround(value), -32768l, 32767l));
+    }
+}
+
+void SpeedResampler::SetSource(IBufferWriter& source, int numChannels)
+{
+    _source = &source;
+    _numChannels = static_cast<size_t>(numChannels);
+    _input.reserve(RESERVED_FRAMES * _numChannels);
+    _weights.reserve(2 * KERNEL_MAX_HALF_WIDTH);
+    GetKernelTable(); // Build it now rather than in the audio callback.
+    Reset();
+}
+
+void SpeedResampler::Reset()
+{
+    _input.assign(TAPS_BEFORE * _numChannels, 0);
+    _position = TAPS_BEFORE;
+    _bufferedFrames = 0;
+}
+
+void SpeedResampler::SetSpeedFactor(double factor)
+{
+    _speedFactor = std::clamp(factor, MIN_SPEED_FACTOR, MAX_SPEED_FACTOR);
+}
+
+double SpeedResampler::GetSpeedFactor() const
+{
+    return _speedFactor;
+}
+
+uint_least64_t SpeedResampler::GetBufferedFrames() const
+{
+    return _bufferedFrames;
+}
+
+size_t SpeedResampler::GetKernelHalfWidth(double speedFactor)
+{
+    return static_cast<size_t>(std::ceil(KERNEL_ZERO_CROSSINGS / GetKernelCutoff(speedFactor))); // Reminder: never more than the KERNEL_MAX_HALF_WIDTH (which the buffers are sized for).
+}
+
+size_t SpeedResampler::GetMaxKernelHalfWidth()
+{
+    return KERNEL_MAX_HALF_WIDTH;
+}
+
+float SpeedResampler::GetKernelCutoff(double speedFactor)
+{
+    return static_cast<float>(std::min(1.0, 1.0 / speedFactor) * CUTOFF_MARGIN);
+}
+
+bool SpeedResampler::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
+{
+    if (_source == nullptr || framesPerBuffer == 0)
+    {
+        return _source != nullptr;
+    }
+
+    short* const out = static_cast<short*>(buffer);
+    const double step = _speedFactor;
+    if (step == 1.0)
+    {
+        return TryPassThrough(out, framesPerBuffer);
+    }
+
+    // Fetch the source frames needed for this buffer (just the difference, the rest is already here).
+    const size_t lastTapFrame = static_cast<size_t>(_position + (framesPerBuffer - 1) * step) + TAPS_AFTER;
+    const size_t haveFrames = _input.size() / _numChannels;
+    if (lastTapFrame >= haveFrames)
+    {
+        const size_t missingFrames = lastTapFrame + 1 - haveFrames;
+        _input.resize((haveFrames + missingFrames) * _numChannels);
+        if (!_source->TryFillBuffer(_input.data() + haveFrames * _numChannels, static_cast<unsigned long>(missingFrames)))
+        {
+            return false;
+        }
+    }
+
+    // Interpolate (windowed sinc). When speeding up, the cutoff is lowered along with the output's Nyquist frequency (relative to the source), so the high-frequency content doesn't alias.
+    const KernelTable& table = GetKernelTable();
+    const float cutoff = GetKernelCutoff(step);
+    const size_t halfWidth = GetKernelHalfWidth(step);
+    for (unsigned long i = 0; i < framesPerBuffer; ++i)
+    {
+        const double position = _position + i * step;
+        const size_t frame = static_cast<size_t>(position);
+        const float t = static_cast<float>(position - frame);
+
+        // Taps from frame - halfWidth + 1 to frame + halfWidth (normalized so the DC gain stays exactly 1).
+        _weights.clear();
+        float weightSum = 0.0f;
+        for (size_t tap = 0; tap < 2 * halfWidth; ++tap)
+        {
+            const float distance = static_cast<float>(tap) - static_cast<float>(halfWidth - 1) - t;
+            const float weight = Kernel(table, distance * cutoff);
+            _weights.push_back(weight);
+            weightSum += weight;
+        }
+
+        const float normalization = (weightSum != 0.0f) ? 1.0f / weightSum : 0.0f;
+        const short* const taps = _input.data() + (frame - (halfWidth - 1)) * _numChannels;
+        short* const outFrame = out + i * _numChannels;
+        for (size_t ch = 0; ch < _numChannels; ++ch)
+        {
+            float sum = 0.0f;
+            for (size_t tap = 0; tap < _weights.size(); ++tap)
+            {
+                sum += _weights[tap] * taps[tap * _numChannels + ch];
+            }
+
+            outFrame[ch] = ToSample(sum * normalization);
+        }
+    }
+
+    _position += framesPerBuffer * step;
+    DiscardConsumedFrames();
+    UpdateBufferedFrames();
+    return true;
+}
+
+bool SpeedResampler::TryPassThrough(short* out, unsigned long framesPerBuffer)
+{
+    // Snap to a whole frame so the 1:1 playback doesn't get interpolated at all (a sub-frame skip is inaudible).
+    _position = std::floor(_position + 0.5);
+
+    // Play out whatever is still buffered from the resampled playback first...
+    const size_t readFrame = static_cast<size_t>(_position);
+    const size_t bufferedFrames = _input.size() / _numChannels - readFrame;
+    const size_t fromBuffer = std::min<size_t>(bufferedFrames, framesPerBuffer);
+    memcpy(out, _input.data() + readFrame * _numChannels, fromBuffer * _numChannels * sizeof(short));
+
+    const unsigned long fromSource = framesPerBuffer - static_cast<unsigned long>(fromBuffer);
+    if (fromSource == 0)
+    {
+        _position += fromBuffer;
+        DiscardConsumedFrames();
+        UpdateBufferedFrames();
+        return true;
+    }
+
+    // ...then the rest directly from the source, keeping just the interpolation history in case the speed changes again.
+    if (!_source->TryFillBuffer(out + fromBuffer * _numChannels, fromSource))
+    {
+        return false;
+    }
+
+    _input.insert(_input.end(), out + fromBuffer * _numChannels, out + framesPerBuffer * _numChannels);
+    _position = static_cast<double>(_input.size() / _numChannels);
+    DiscardConsumedFrames();
+    UpdateBufferedFrames();
+    return true;
+}
+
+void SpeedResampler::DiscardConsumedFrames()
+{
+    const size_t consumedFrames = static_cast<size_t>(_position) - TAPS_BEFORE;
+    if (consumedFrames > 0)
+    {
+        _input.erase(_input.begin(), _input.begin() + consumedFrames * _numChannels);
+        _position -= consumedFrames;
+    }
+}
+
+void SpeedResampler::UpdateBufferedFrames()
+{
+    const double haveFrames = static_cast<double>(_input.size() / _numChannels);
+    _bufferedFrames = (haveFrames > _position) ? static_cast<uint_least64_t>(haveFrames - _position) : 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/IBufferWriter.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// @brief Changes the playback speed by resampling the source (windowed-sinc, low-passed below the output Nyquist when speeding up) at the device's native sample rate, so the speed can be changed at any time without reopening the audio stream.
+/// At exactly 1.0x the source is passed through unchanged.
+class SpeedResampler : public IBufferWriter
+{
+public:
+    static constexpr double MIN_SPEED_FACTOR = 0.25;
+    static constexpr double MAX_SPEED_FACTOR = 4.0;
+
+public:
+    SpeedResampler() = default;
+    SpeedResampler(SpeedResampler&) = delete;
+
+public:
+    /// @brief The audio stream must be stopped.
+    void SetSource(IBufferWriter& source, int numChannels);
+
+    /// @brief Discards the few buffered source frames (e.g., after seeking). The audio stream must be stopped.
+    void Reset();
+
+    /// @brief Can be called at any time, takes effect from the next audio callback.
+    void SetSpeedFactor(double factor);
+    double GetSpeedFactor() const;
+
+    /// @brief Source frames fetched ahead of the read position, i.e., handed out by the source but not heard yet. Can be called from any thread.
+    uint_least64_t GetBufferedFrames() const;
+
+    bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override; // Audio callback.
+
+    /// @brief Interpolation kernel's half width (in source frames) at the speed factor, must fit within the GetMaxKernelHalfWidth().
+    static size_t GetKernelHalfWidth(double speedFactor);
+    static size_t GetMaxKernelHalfWidth();
+
+private:
+    static float GetKernelCutoff(double speedFactor); // Relative to the source's Nyquist frequency.
+    bool TryPassThrough(short* out, unsigned long framesPerBuffer);
+    void DiscardConsumedFrames();
+    void UpdateBufferedFrames();
+
+private:
+    IBufferWriter* _source = nullptr;
+    size_t _numChannels = 0;
+    std::atomic<double> _speedFactor = 1.0;
+
+    std::vector<short> _input; // Source frames around the read position (a few already played ones are kept as interpolation history).
+    double _position = 0.0; // Fractional read position within the _input, in frames.
+    std::vector<float> _weights; // Kernel of the output frame being interpolated.
+    std::atomic_uint_least64_t _bufferedFrames = 0; // See GetBufferedFrames().
+};
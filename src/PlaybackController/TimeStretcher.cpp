@@ -0,0 +1,373 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "TimeStretcher.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define TIMESTRETCHER_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr unsigned int WINDOW_MS = 40;
+    constexpr unsigned int TOLERANCE_MS = 10; // How far a window may be shifted from its nominal position.
+    constexpr size_t COARSE_SEARCH_STEP = 4; // The best candidate of the coarse pass is then refined within this distance.
+    constexpr size_t RESERVED_FRAMES = 16384; // On top of the geometry, avoids reallocations in the audio callback for any sane buffer size.
+    constexpr double MAX_SPEED_FACTOR = 4.0;
+    constexpr double PI = 3.14159265358979323846;
+
+    inline short ToSample(float value)
+    {
+        return static_cast<short>(std::clamp(std::lround(value), -32768l, 32767l));
+    }
+
+    float DotProduct(const float* a, const float* b, size_t length)
+    {
+        size_t i = 0;
+        float sum = 0.0f;
+
+#ifdef TIMESTRETCHER_SSE2
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (; i + 8 <= length; i += 8)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, _mm_add_ps(sum0, sum1));
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+        for (; i < length; ++i)
+        {
+            sum += a[i] * b[i];
+        }
+
+        return sum;
+    }
+}
+
+void TimeStretcher::SetSource(IBufferWriter& source, int sampleRate, int numChannels)
+{
+    _source = &source;
+    _numChannels = static_cast<size_t>(numChannels);
+
+    _windowFrames = (static_cast<size_t>(sampleRate) * WINDOW_MS / 1000) & ~static_cast<size_t>(1); // Must be even.
+    _hopFrames = _windowFrames / 2;
+    _toleranceFrames = static_cast<size_t>(sampleRate) * TOLERANCE_MS / 1000;
+
+    _window.resize(_windowFrames);
+    for (size_t i = 0; i < _windowFrames; ++i)
+    {
+        _window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * PI * i / _windowFrames)); // Periodic Hann.
+    }
+
+    const size_t reservedFrames = _windowFrames + 2 * _toleranceFrames + static_cast<size_t>(_hopFrames * MAX_SPEED_FACTOR) + RESERVED_FRAMES;
+    _fetchScratch.reserve(reservedFrames * _numChannels);
+    _input.reserve(reservedFrames * _numChannels);
+    _inputMono.reserve(reservedFrames);
+    _energyPrefix.reserve(2 * _toleranceFrames + _hopFrames + 2);
+    _overlap.reserve(_hopFrames * _numChannels);
+    _ready.reserve((_hopFrames + reservedFrames) * _numChannels);
+
+    Reset();
+}
+
+void TimeStretcher::Reset()
+{
+    _active = false;
+    _input.clear();
+    _inputMono.clear();
+    _inputStartFrame = 0;
+    _overlap.clear();
+    _ready.clear();
+    _readyPos = 0;
+    _bufferedFrames = 0;
+}
+
+void TimeStretcher::SetSpeedFactor(double factor)
+{
+    _speedFactor = std::clamp(factor, 1.0 / MAX_SPEED_FACTOR, MAX_SPEED_FACTOR);
+}
+
+double TimeStretcher::GetSpeedFactor() const
+{
+    return _speedFactor;
+}
+
+uint_least64_t TimeStretcher::GetBufferedFrames() const
+{
+    return _bufferedFrames;
+}
+
+bool TimeStretcher::TryFillBuffer(void* buffer, unsigned long framesPerBuffer)
+{
+    if (_source == nullptr)
+    {
+        return false;
+    }
+
+    const double factor = _speedFactor;
+    if (!_active && factor != 1.0)
+    {
+        Start();
+    }
+    else if (_active && factor == 1.0)
+    {
+        Finish();
+    }
+
+    short* const out = static_cast<short*>(buffer);
+    size_t framesDone = 0;
+    while (framesDone < framesPerBuffer)
+    {
+        // Finished output first...
+        const size_t readyFrames = _ready.size() / _numChannels - _readyPos;
+        if (readyFrames > 0)
+        {
+            const size_t amount = std::min<size_t>(readyFrames, framesPerBuffer - framesDone);
+            memcpy(out + framesDone * _numChannels, _ready.data() + _readyPos * _numChannels, amount * _numChannels * sizeof(short));
+            _readyPos += amount;
+            framesDone += amount;
+            continue;
+        }
+
+        _ready.clear();
+        _readyPos = 0;
+
+        // ...then either the source directly or another stretched hop.
+        if (!_active)
+        {
+            _bufferedFrames = 0;
+            return _source->TryFillBuffer(out + framesDone * _numChannels, static_cast<unsigned long>(framesPerBuffer - framesDone));
+        }
+
+        if (!TryProduceHop(factor))
+        {
+            return false;
+        }
+    }
+
+    UpdateBufferedFrames(factor);
+    return true;
+}
+
+void TimeStretcher::Start()
+{
+    _active = true;
+    _input.clear();
+    _inputMono.clear();
+    _inputStartFrame = 0;
+    _overlap.clear(); // Marks the first window.
+}
+
+void TimeStretcher::Finish()
+{
+    // Undo the windowing of the last window's second half by simply continuing with the raw source from there on (the windows add up to 1.0 anyway).
+    const uint_least64_t continueFrame = (_overlap.empty()) ? _inputStartFrame : _previousStart + _hopFrames;
+    const size_t from = static_cast<size_t>(continueFrame - _inputStartFrame) * _numChannels;
+    for (size_t i = from; i < _input.size(); ++i)
+    {
+        _ready.push_back(static_cast<short>(_input[i])); // Exact, these were shorts to begin with.
+    }
+
+    _active = false;
+    _input.clear();
+    _inputMono.clear();
+    _overlap.clear();
+}
+
+bool TimeStretcher::TryFetchInputUntil(uint_least64_t endFrame)
+{
+    const uint_least64_t haveUntilFrame = _inputStartFrame + _inputMono.size();
+    if (endFrame <= haveUntilFrame)
+    {
+        return true;
+    }
+
+    const size_t missingFrames = static_cast<size_t>(endFrame - haveUntilFrame);
+    _fetchScratch.resize(missingFrames * _numChannels);
+    if (!_source->TryFillBuffer(_fetchScratch.data(), static_cast<unsigned long>(missingFrames)))
+    {
+        return false;
+    }
+
+    for (size_t frame = 0; frame < missingFrames; ++frame)
+    {
+        float mono = 0.0f;
+        for (size_t ch = 0; ch < _numChannels; ++ch)
+        {
+            const float sample = _fetchScratch[frame * _numChannels + ch];
+            _input.push_back(sample);
+            mono += sample;
+        }
+
+        _inputMono.push_back(mono / _numChannels);
+    }
+
+    return true;
+}
+
+bool TimeStretcher::TryProduceHop(double factor)
+{
+    uint_least64_t start = 0;
+
+    if (_overlap.empty())
+    {
+        // First window: seed the overlap with the complement of its first half, so the stretching starts without any fade-in.
+        if (!TryFetchInputUntil(_inputStartFrame + _windowFrames))
+        {
+            return false;
+        }
+
+        start = _inputStartFrame;
+        _nominalStart = static_cast<double>(start);
+        _overlap.resize(_hopFrames * _numChannels);
+        for (size_t i = 0; i < _hopFrames; ++i)
+        {
+            for (size_t ch = 0; ch < _numChannels; ++ch)
+            {
+                _overlap[i * _numChannels + ch] = _input[i * _numChannels + ch] * (1.0f - _window[i]);
+            }
+        }
+    }
+    else
+    {
+        const uint_least64_t nominalStart = std::max(static_cast<uint_least64_t>(std::llround(_nominalStart)), _inputStartFrame);
+        const uint_least64_t naturalStart = _previousStart + _hopFrames;
+        if (!TryFetchInputUntil(std::max(nominalStart + _toleranceFrames + _windowFrames, naturalStart + _hopFrames)))
+        {
+            return false;
+        }
+
+        start = FindBestSegmentStart(nominalStart, naturalStart);
+    }
+
+    // Overlap-add: the first half of this window completes the output hop, its second half waits for the next window.
+    const float* const segment = _input.data() + static_cast<size_t>(start - _inputStartFrame) * _numChannels;
+    for (size_t i = 0; i < _hopFrames; ++i)
+    {
+        for (size_t ch = 0; ch < _numChannels; ++ch)
+        {
+            const size_t k = i * _numChannels + ch;
+            _ready.push_back(ToSample(_overlap[k] + segment[k] * _window[i]));
+            _overlap[k] = segment[_hopFrames * _numChannels + k] * _window[_hopFrames + i];
+        }
+    }
+
+    _previousStart = start;
+    _nominalStart += _hopFrames * factor;
+
+    // Keep just what the next search can reach.
+    const uint_least64_t nextNominalStart = static_cast<uint_least64_t>(std::llround(_nominalStart));
+    const uint_least64_t lowestReachable = (nextNominalStart > _toleranceFrames) ? nextNominalStart - _toleranceFrames : 0;
+    DiscardInputBefore(std::min(lowestReachable, _previousStart + _hopFrames));
+
+    return true;
+}
+
+uint_least64_t TimeStretcher::FindBestSegmentStart(uint_least64_t nominalStart, uint_least64_t naturalStart) const
+{
+    // Candidates are compared (normalized cross-correlation) over the overlapping part against the natural continuation of the previous window.
+    const uint_least64_t lowest = std::max((nominalStart > _toleranceFrames) ? nominalStart - _toleranceFrames : 0, _inputStartFrame);
+    const uint_least64_t highest = nominalStart + _toleranceFrames;
+    const size_t candidates = static_cast<size_t>(highest - lowest) + 1;
+    const size_t length = _hopFrames;
+
+    const float* const target = _inputMono.data() + static_cast<size_t>(naturalStart - _inputStartFrame);
+    const float* const base = _inputMono.data() + static_cast<size_t>(lowest - _inputStartFrame);
+
+    // Prefix sums of the energy, so each candidate's energy is a simple difference.
+    _energyPrefix.resize(candidates + length);
+    double energy = 0.0;
+    for (size_t i = 0; i < candidates + length - 1; ++i)
+    {
+        _energyPrefix[i] = energy;
+        energy += static_cast<double>(base[i]) * base[i];
+    }
+    _energyPrefix[candidates + length - 1] = energy;
+
+    const auto score = [&](size_t candidate)
+    {
+        const double candidateEnergy = _energyPrefix[candidate + length] - _energyPrefix[candidate];
+        return DotProduct(base + candidate, target, length) / std::sqrt(candidateEnergy + 1.0);
+    };
+
+    // Coarse pass...
+    size_t best = static_cast<size_t>(nominalStart - lowest);
+    double bestScore = -std::numeric_limits<double>::max();
+    for (size_t candidate = 0; candidate < candidates; candidate += COARSE_SEARCH_STEP)
+    {
+        const double cScore = score(candidate);
+        if (cScore > bestScore)
+        {
+            bestScore = cScore;
+            best = candidate;
+        }
+    }
+
+    // ...then refine around the best one.
+    const size_t refineFrom = (best > COARSE_SEARCH_STEP) ? best - COARSE_SEARCH_STEP : 0;
+    const size_t refineTo = std::min(best + COARSE_SEARCH_STEP, candidates - 1);
+    for (size_t candidate = refineFrom; candidate <= refineTo; ++candidate)
+    {
+        const double cScore = score(candidate);
+        if (cScore > bestScore)
+        {
+            bestScore = cScore;
+            best = candidate;
+        }
+    }
+
+    return lowest + best;
+}
+
+void TimeStretcher::DiscardInputBefore(uint_least64_t frame)
+{
+    if (frame <= _inputStartFrame)
+    {
+        return;
+    }
+
+    const size_t discardFrames = std::min(static_cast<size_t>(frame - _inputStartFrame), _inputMono.size());
+    _input.erase(_input.begin(), _input.begin() + discardFrames * _numChannels);
+    _inputMono.erase(_inputMono.begin(), _inputMono.begin() + discardFrames);
+    _inputStartFrame += discardFrames;
+}
+
+void TimeStretcher::UpdateBufferedFrames(double factor)
+{
+    const size_t unplayedFrames = _ready.size() / _numChannels - _readyPos;
+    if (!_active)
+    {
+        _bufferedFrames = unplayedFrames; // Just the raw leftovers of the Finish().
+        return;
+    }
+
+    // The output produced so far ends at the next window's nominal start, the unplayed part of it was stretched from the source at the speed factor.
+    const double fetchedEnd = static_cast<double>(_inputStartFrame + _inputMono.size());
+    const double playedEnd = _nominalStart - unplayedFrames * factor;
+    _bufferedFrames = (fetchedEnd > playedEnd) ? static_cast<uint_least64_t>(fetchedEnd - playedEnd) : 0;
+}
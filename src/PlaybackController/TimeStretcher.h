@@ -0,0 +1,87 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/IBufferWriter.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// @brief Pitch-preserving playback speed change (WSOLA): the source is cut into overlapping windows which are overlap-added at a fixed output hop, while the input hop follows the speed factor.
+/// Each window is shifted (within a small tolerance) to where it best continues the previous one, so the waveform stays coherent. At exactly 1.0x the source is passed through unchanged.
+class TimeStretcher : public IBufferWriter
+{
+public:
+    TimeStretcher() = default;
+    TimeStretcher(TimeStretcher&) = delete;
+
+public:
+    /// @brief The audio stream must be stopped.
+    void SetSource(IBufferWriter& source, int sampleRate, int numChannels);
+
+    /// @brief Discards all the buffered content (e.g., after seeking). The audio stream must be stopped.
+    void Reset();
+
+    /// @brief Can be called at any time, takes effect from the next audio callback.
+    void SetSpeedFactor(double factor);
+    double GetSpeedFactor() const;
+
+    /// @brief Source frames handed out by the source but not heard yet (both the stretched output and the input read ahead, approximately). Can be called from any thread.
+    uint_least64_t GetBufferedFrames() const;
+
+    bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override; // Audio callback.
+
+private:
+    void Start();
+    void Finish();
+
+    bool TryFetchInputUntil(uint_least64_t endFrame);
+    bool TryProduceHop(double factor);
+    uint_least64_t FindBestSegmentStart(uint_least64_t nominalStart, uint_least64_t naturalStart) const;
+    void DiscardInputBefore(uint_least64_t frame);
+    void UpdateBufferedFrames(double factor);
+
+private:
+    IBufferWriter* _source = nullptr;
+    size_t _numChannels = 0;
+    std::atomic<double> _speedFactor = 1.0;
+
+    // Geometry (in frames), derived from the sample rate.
+    size_t _windowFrames = 0;
+    size_t _hopFrames = 0; // Output hop, also the overlap length (half a window).
+    size_t _toleranceFrames = 0;
+    std::vector<float> _window; // Hann, sums up to 1.0 at the 50% overlap.
+
+    bool _active = false; // Stretching (rather than passing through).
+
+    std::vector<short> _fetchScratch;
+    std::vector<float> _input; // Interleaved.
+    std::vector<float> _inputMono; // For the similarity search.
+    mutable std::vector<double> _energyPrefix; // Scratch for the similarity search.
+    uint_least64_t _inputStartFrame = 0; // Source frame index of the _input's beginning.
+
+    double _nominalStart = 0.0; // Source frame index where the next window would start at the exact speed factor.
+    uint_least64_t _previousStart = 0; // Source frame index of the last window used.
+    std::vector<float> _overlap; // Second (windowed) half of the last window, to be added to the next one.
+
+    std::vector<short> _ready; // Finished output.
+    size_t _readyPos = 0;
+
+    std::atomic_uint_least64_t _bufferedFrames = 0; // See GetBufferedFrames().
+};
@@ -0,0 +1,237 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "TuneInfoCache.h"
+#include "../Util/HelpersBinaryFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    constexpr const char CACHE_MAGIC[8] = {'S', 'P', 'W', 'X', 'T', 'I', 'C', '\0'};
+    constexpr uint_least32_t CACHE_VERSION = 2;
+    constexpr uint_least32_t MAX_STRING_LENGTH = 1u << 16; // Sanity limit while reading.
+
+    constexpr uint_least16_t MAX_UNUSED_SESSIONS = 30; // Records not looked up in that many sessions are dropped (e.g., of deleted files or forgotten playlists).
+    constexpr size_t MAX_RECORDS = 100000; // Plenty for the whole HVSC. The least recently used records are dropped beyond it.
+
+    using Helpers::BinaryFile::Write;
+    using Helpers::BinaryFile::WriteString;
+    using Helpers::BinaryFile::TryRead;
+    using Helpers::BinaryFile::TryReadString;
+    using Helpers::BinaryFile::TrySaveReplacing;
+}
+
+bool TuneInfoCache::TryLoad(const std::wstring& filepath, uint_least64_t contextStamp)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _records.clear();
+    _contextStamp = contextStamp;
+    _dirty = false;
+
+    std::ifstream file(std::filesystem::path(filepath), std::ios::binary);
+    if (!file.good())
+    {
+        return false;
+    }
+
+    char magic[sizeof(CACHE_MAGIC)]{};
+    uint_least32_t version = 0;
+    uint_least32_t charSize = 0;
+    uint_least64_t fileContextStamp = 0;
+    uint_least32_t recordCount = 0;
+
+    file.read(magic, sizeof(magic));
+    const bool validHeader = file.good() && memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+        TryRead(file, version) && version == CACHE_VERSION &&
+        TryRead(file, charSize) && charSize == sizeof(wchar_t) &&
+        TryRead(file, fileContextStamp) && fileContextStamp == contextStamp && // Otherwise stale, just start anew.
+        TryRead(file, recordCount);
+
+    if (!validHeader)
+    {
+        _dirty = true; // Overwrite it upon save.
+        return false;
+    }
+
+    _records.reserve(recordCount);
+    for (uint_least32_t i = 0; i < recordCount; ++i)
+    {
+        std::wstring key;
+        Record record;
+        TuneInfoScanner::TuneInfo& info = record.info;
+
+        uint_least8_t valid = 0;
+        int_least32_t sidChipsRequired = 0;
+        int_least32_t defaultSubsong = 0;
+        int_least32_t totalSubsongs = 0;
+        uint_least8_t romRequirement = 0;
+        uint_least32_t subsongDurationCount = 0;
+
+        bool success = TryReadString(file, key, MAX_STRING_LENGTH) &&
+            TryRead(file, record.stamp.size) &&
+            TryRead(file, record.stamp.modifiedTime) &&
+            TryRead(file, record.unusedSessions) &&
+            TryRead(file, valid) &&
+            TryReadString(file, info.title, MAX_STRING_LENGTH) &&
+            TryReadString(file, info.author, MAX_STRING_LENGTH) &&
+            TryReadString(file, info.released, MAX_STRING_LENGTH) &&
+            TryRead(file, sidChipsRequired) &&
+            TryRead(file, defaultSubsong) &&
+            TryRead(file, totalSubsongs) &&
+            TryRead(file, romRequirement) &&
+            TryRead(file, info.duration) &&
+            TryRead(file, subsongDurationCount) &&
+            subsongDurationCount <= MAX_STRING_LENGTH;
+
+        if (success)
+        {
+            info.subsongDurations.resize(subsongDurationCount);
+            success = static_cast<bool>(file.read(reinterpret_cast<char*>(info.subsongDurations.data()), subsongDurationCount * sizeof(uint_least32_t)));
+        }
+
+        if (!success)
+        {
+            _records.clear(); // Corrupted.
+            _dirty = true;
+            return false;
+        }
+
+        info.valid = valid != 0;
+        info.sidChipsRequired = sidChipsRequired;
+        info.defaultSubsong = defaultSubsong;
+        info.totalSubsongs = totalSubsongs;
+        info.romRequirement = static_cast<SidDecoder::RomRequirement>(romRequirement);
+
+        _records.emplace(std::move(key), std::move(record));
+    }
+
+    return true;
+}
+
+bool TuneInfoCache::TrySave(const std::wstring& filepath) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Reminder: the unused ones still need aging even if nothing was added.
+    const bool agesChanged = std::any_of(_records.begin(), _records.end(), [](const auto& entry) { return GetSavedUnusedSessions(entry.second) != entry.second.unusedSessions; });
+    if (!_dirty && !agesChanged)
+    {
+        return true;
+    }
+
+    std::vector<const decltype(_records)::value_type*> kept;
+    kept.reserve(_records.size());
+    for (const auto& entry : _records)
+    {
+        if (GetSavedUnusedSessions(entry.second) <= MAX_UNUSED_SESSIONS)
+        {
+            kept.emplace_back(&entry);
+        }
+    }
+
+    if (kept.size() > MAX_RECORDS)
+    {
+        std::nth_element(kept.begin(), kept.begin() + MAX_RECORDS, kept.end(), [](const auto* a, const auto* b) { return GetSavedUnusedSessions(a->second) < GetSavedUnusedSessions(b->second); });
+        kept.resize(MAX_RECORDS);
+    }
+
+    const bool success = TrySaveReplacing(std::filesystem::path(filepath), [this, &kept](std::ostream& file)
+    {
+        file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        Write(file, CACHE_VERSION);
+        Write(file, static_cast<uint_least32_t>(sizeof(wchar_t)));
+        Write(file, static_cast<uint_least64_t>(_contextStamp));
+        Write(file, static_cast<uint_least32_t>(kept.size()));
+
+        for (const auto* entry : kept)
+        {
+            const Record& record = entry->second;
+            const TuneInfoScanner::TuneInfo& info = record.info;
+
+            WriteString(file, entry->first);
+            Write(file, record.stamp.size);
+            Write(file, record.stamp.modifiedTime);
+            Write(file, GetSavedUnusedSessions(record));
+            Write(file, static_cast<uint_least8_t>(info.valid));
+            WriteString(file, info.title);
+            WriteString(file, info.author);
+            WriteString(file, info.released);
+            Write(file, static_cast<int_least32_t>(info.sidChipsRequired));
+            Write(file, static_cast<int_least32_t>(info.defaultSubsong));
+            Write(file, static_cast<int_least32_t>(info.totalSubsongs));
+            Write(file, static_cast<uint_least8_t>(info.romRequirement));
+            Write(file, info.duration);
+            Write(file, static_cast<uint_least32_t>(info.subsongDurations.size()));
+            file.write(reinterpret_cast<const char*>(info.subsongDurations.data()), info.subsongDurations.size() * sizeof(uint_least32_t));
+        }
+    });
+
+    _dirty = !success;
+    return success;
+}
+
+bool TuneInfoCache::TryGetFileStamp(const std::wstring& filepath, FileStamp& out)
+{
+    std::error_code ec;
+    const std::filesystem::path path(filepath);
+
+    out.size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    out.modifiedTime = static_cast<int_least64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    return !ec;
+}
+
+bool TuneInfoCache::TryGet(const std::wstring& key, const FileStamp& stamp, TuneInfoScanner::TuneInfo& out) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto it = _records.find(key);
+    if (it == _records.end() || !(it->second.stamp == stamp))
+    {
+        return false; // Not cached or the file has changed since.
+    }
+
+    out = it->second.info;
+    it->second.usedThisSession = true;
+    return true;
+}
+
+void TuneInfoCache::Put(const std::wstring& key, const FileStamp& stamp, const TuneInfoScanner::TuneInfo& info)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Record& record = _records[key];
+    record.stamp = stamp;
+    record.info = info;
+    record.unusedSessions = 0;
+    record.usedThisSession = true;
+    _dirty = true;
+}
+
+uint_least16_t TuneInfoCache::GetSavedUnusedSessions(const Record& record)
+{
+    return (record.usedThisSession) ? 0 : record.unusedSessions + 1;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "TuneInfoScanner.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/// @brief Persistent (on-disk) cache of the tunes' info, keyed by file path and validated by the file's size & modification time.
+class TuneInfoCache
+{
+public:
+    struct FileStamp
+    {
+        uint_least64_t size = 0;
+        int_least64_t modifiedTime = 0;
+
+        bool operator==(const FileStamp& other) const { return size == other.size && modifiedTime == other.modifiedTime; }
+    };
+
+public:
+    TuneInfoCache() = default;
+    TuneInfoCache(TuneInfoCache&) = delete;
+
+public:
+    /// @brief Loads the cache file. Its content is discarded if it was made in a different context (e.g., with another Songlengths database, which affects the durations).
+    bool TryLoad(const std::wstring& filepath, uint_least64_t contextStamp);
+
+    /// @brief Saves the cache file (if anything changed since loading), dropping the records which weren't looked up for too many sessions (or are beyond the size limit).
+    bool TrySave(const std::wstring& filepath) const;
+
+    static bool TryGetFileStamp(const std::wstring& filepath, FileStamp& out);
+
+    bool TryGet(const std::wstring& key, const FileStamp& stamp, TuneInfoScanner::TuneInfo& out) const;
+    void Put(const std::wstring& key, const FileStamp& stamp, const TuneInfoScanner::TuneInfo& info);
+
+private:
+    struct Record
+    {
+        FileStamp stamp;
+        TuneInfoScanner::TuneInfo info;
+        uint_least16_t unusedSessions = 0; // Consecutive saved sessions it wasn't looked up in (as of loading).
+        mutable bool usedThisSession = false;
+    };
+
+private:
+    static uint_least16_t GetSavedUnusedSessions(const Record& record);
+
+private:
+    uint_least64_t _contextStamp = 0;
+    std::unordered_map<std::wstring, Record> _records;
+    mutable bool _dirty = false;
+    mutable std::mutex _mutex;
+};
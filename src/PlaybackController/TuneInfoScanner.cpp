@@ -0,0 +1,221 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "TuneInfoScanner.h"
+#include "TuneInfoCache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t SCAN_CHUNK_SIZE = 16; // Files taken by a worker at once (and hashed together).
+
+    // The Songlengths (HVSC's "new" MD5 method) hash covers the whole file only in case of these formats.
+    bool IsWholeFileHashed(const BufferHolder& bufferHolder)
+    {
+        return bufferHolder.size >= 4 && (memcmp(bufferHolder.data, "PSID", 4) == 0 || memcmp(bufferHolder.data, "RSID", 4) == 0);
+    }
+}
+
+TuneInfoScanner::~TuneInfoScanner()
+{
+    Abort();
+}
+
+void TuneInfoScanner::Start(size_t fileCount, const FileLoader& loader, const SidDecoder& databaseSource, TuneInfoCache* cache, const CacheKeyProvider& cacheKeyOf)
+{
+    Abort();
+
+    _results.clear();
+    _results.resize(fileCount);
+    _takenCount = 0;
+    _nextIndex = 0;
+
+    const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t workerCount = std::min<size_t>(hardwareThreads, fileCount);
+
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        _workers.emplace_back([this, loader, &databaseSource, cache, cacheKeyOf]()
+        {
+            RunWorker(loader, databaseSource, (cacheKeyOf != nullptr) ? cache : nullptr, cacheKeyOf);
+        });
+    }
+}
+
+size_t TuneInfoScanner::TakeReady(std::vector<TuneInfo>& out, size_t maxCount, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(_resultsMutex);
+    _resultsCv.wait_for(lock, timeout, [this]()
+    {
+        return _takenCount >= _results.size() || _results.at(_takenCount) != nullptr;
+    });
+
+    size_t taken = 0;
+    while (taken < maxCount && _takenCount < _results.size() && _results.at(_takenCount) != nullptr)
+    {
+        out.emplace_back(std::move(*_results.at(_takenCount)));
+        _results.at(_takenCount).reset();
+        ++_takenCount;
+        ++taken;
+    }
+
+    return taken;
+}
+
+bool TuneInfoScanner::IsDone() const
+{
+    std::lock_guard<std::mutex> lock(_resultsMutex);
+    return _takenCount >= _results.size();
+}
+
+void TuneInfoScanner::Abort()
+{
+    _abortFlag = true;
+    for (std::thread& worker : _workers)
+    {
+        worker.join();
+    }
+
+    _workers.clear();
+    _abortFlag = false;
+}
+
+void TuneInfoScanner::RunWorker(const FileLoader& loader, const SidDecoder& databaseSource, TuneInfoCache* cache, const CacheKeyProvider& cacheKeyOf)
+{
+    SidDecoder decoder; // Info-only (no emulation init needed).
+    decoder.UseSidDatabaseOf(databaseSource);
+
+    struct Job
+    {
+        size_t index = 0;
+        std::unique_ptr<BufferHolder> bufferHolder;
+        std::wstring cacheKey;
+        bool hasStamp = false;
+        TuneInfoCache::FileStamp stamp;
+    };
+
+    std::vector<Job> jobs;
+    std::vector<Md5Lanes::Input> hashInputs;
+
+    while (!_abortFlag)
+    {
+        const size_t first = _nextIndex.fetch_add(SCAN_CHUNK_SIZE);
+        if (first >= _results.size())
+        {
+            break;
+        }
+
+        const size_t last = std::min(first + SCAN_CHUNK_SIZE, _results.size());
+
+        // Load the chunk (the cached ones are done right away)
+        jobs.clear();
+        for (size_t index = first; index < last && !_abortFlag; ++index)
+        {
+            Job job;
+            job.index = index;
+
+            if (cache != nullptr)
+            {
+                auto [key, diskFilepath] = cacheKeyOf(index);
+                job.hasStamp = TuneInfoCache::TryGetFileStamp(diskFilepath, job.stamp);
+
+                std::unique_ptr<TuneInfo> info = std::make_unique<TuneInfo>();
+                if (job.hasStamp && cache->TryGet(key, job.stamp, *info))
+                {
+                    Publish(index, std::move(info));
+                    continue;
+                }
+
+                job.cacheKey = std::move(key);
+            }
+
+            job.bufferHolder = loader(index);
+            jobs.emplace_back(std::move(job));
+        }
+
+        // Hash the rest all at once
+        hashInputs.clear();
+        for (const Job& job : jobs)
+        {
+            const bool hashable = job.bufferHolder != nullptr && IsWholeFileHashed(*job.bufferHolder);
+            hashInputs.push_back({(hashable) ? job.bufferHolder->data : nullptr, (hashable) ? job.bufferHolder->size : 0});
+        }
+
+        const std::vector<Md5Lanes::Digest> digests = Md5Lanes::HashAll(hashInputs);
+
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            Job& job = jobs.at(i);
+            std::unique_ptr<TuneInfo> info = std::make_unique<TuneInfo>(Scan(decoder, job.bufferHolder, digests.at(i)));
+            if (cache != nullptr && job.hasStamp)
+            {
+                cache->Put(job.cacheKey, job.stamp, *info);
+            }
+
+            Publish(job.index, std::move(info));
+        }
+    }
+}
+
+void TuneInfoScanner::Publish(size_t index, std::unique_ptr<TuneInfo> info)
+{
+    {
+        std::lock_guard<std::mutex> lock(_resultsMutex);
+        _results.at(index) = std::move(info);
+    }
+
+    _resultsCv.notify_all();
+}
+
+TuneInfoScanner::TuneInfo TuneInfoScanner::Scan(SidDecoder& decoder, const std::unique_ptr<BufferHolder>& bufferHolder, const Md5Lanes::Digest& md5)
+{
+    TuneInfo info;
+    info.valid = bufferHolder != nullptr && decoder.TryLoadSongInfo(bufferHolder->data, bufferHolder->size);
+    if (!info.valid)
+    {
+        return info;
+    }
+
+    info.title = decoder.GetCurrentTuneInfoString(SidDecoder::SongInfoCategory::Title);
+    info.author = decoder.GetCurrentTuneInfoString(SidDecoder::SongInfoCategory::Author);
+    info.released = decoder.GetCurrentTuneInfoString(SidDecoder::SongInfoCategory::Released);
+    info.sidChipsRequired = decoder.GetCurrentTuneSidChipsRequired();
+    info.defaultSubsong = decoder.GetDefaultSubsong();
+    info.totalSubsongs = decoder.GetTotalSubsongs();
+    info.romRequirement = decoder.GetCurrentSongRomRequirement();
+
+    // Determine subsong durations (all at once, without loading each subsong into the engine)
+    const std::vector<uint_least32_t> durations = (IsWholeFileHashed(*bufferHolder)) ? decoder.GetAllSubsongDurations(md5) : decoder.GetAllSubsongDurations();
+    const auto durationOf = [&durations](int subsong) -> uint_least32_t
+    {
+        return (subsong >= 1 && static_cast<size_t>(subsong) <= durations.size()) ? durations.at(subsong - 1) : 0;
+    };
+
+    info.duration = durationOf(info.defaultSubsong);
+    if (info.totalSubsongs > 1)
+    {
+        info.subsongDurations.reserve(info.totalSubsongs);
+        for (int i = 1; i <= info.totalSubsongs; ++i)
+        {
+            info.subsongDurations.emplace_back(durationOf(i));
+        }
+    }
+
+    return info;
+}
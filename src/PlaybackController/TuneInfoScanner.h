@@ -0,0 +1,94 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include "PlaybackWrappers/Input/SidDecoder.h"
+#include "../Util/BufferHolder.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class TuneInfoCache;
+
+/// @brief Reads the tunes' info in a pool of background workers (each one with its own info-only SidDecoder). Results are taken in the submission order.
+/// Each worker takes a chunk of files at a time and hashes them together (Md5Lanes) for the Songlengths lookups.
+class TuneInfoScanner
+{
+public:
+    struct TuneInfo
+    {
+        bool valid = false;
+        std::string title;
+        std::string author;
+        std::string released;
+        int sidChipsRequired = 0;
+        int defaultSubsong = 0;
+        int totalSubsongs = 0;
+        SidDecoder::RomRequirement romRequirement = SidDecoder::RomRequirement::None;
+        uint_least32_t duration = 0; // Of the default subsong.
+        std::vector<uint_least32_t> subsongDurations; // Only if there's more than one subsong.
+    };
+
+    /// @brief Returns the content of the file at the given index (or nullptr on failure). Called from the worker threads.
+    using FileLoader = std::function<std::unique_ptr<BufferHolder>(size_t index)>;
+
+    /// @brief Returns the cache key of the file at the given index and the path of the actual file on disk (i.e., the Zip archive if within one). Called from the worker threads.
+    using CacheKeyProvider = std::function<std::pair<std::wstring, std::wstring>(size_t index)>;
+
+public:
+    TuneInfoScanner() = default;
+    TuneInfoScanner(TuneInfoScanner&) = delete;
+
+    ~TuneInfoScanner();
+
+public:
+    /// @brief Starts scanning the given number of files (aborting any previous scan). Songlengths database of the databaseSource is shared with the workers.
+    /// If a cache is provided, unchanged files are taken from it without decoding (and the decoded ones are put into it).
+    void Start(size_t fileCount, const FileLoader& loader, const SidDecoder& databaseSource, TuneInfoCache* cache = nullptr, const CacheKeyProvider& cacheKeyOf = nullptr);
+
+    /// @brief Moves up to maxCount consecutive ready results (continuing where the previous call stopped) into the out vector, waiting up to the timeout for at least one of them. Returns the number of results moved.
+    size_t TakeReady(std::vector<TuneInfo>& out, size_t maxCount, std::chrono::milliseconds timeout);
+
+    bool IsDone() const;
+    void Abort();
+
+private:
+    void RunWorker(const FileLoader& loader, const SidDecoder& databaseSource, TuneInfoCache* cache, const CacheKeyProvider& cacheKeyOf);
+    void Publish(size_t index, std::unique_ptr<TuneInfo> info);
+    static TuneInfo Scan(SidDecoder& decoder, const std::unique_ptr<BufferHolder>& bufferHolder, const Md5Lanes::Digest& md5);
+
+private:
+    std::vector<std::thread> _workers;
+    std::atomic_size_t _nextIndex = 0;
+    std::atomic_bool _abortFlag = false;
+
+    std::vector<std::unique_ptr<TuneInfo>> _results; // Index matches the file index.
+    size_t _takenCount = 0;
+    std::condition_variable _resultsCv;
+    mutable std::mutex _resultsMutex;
+};
@@ -0,0 +1,325 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "Md5Lanes.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MD5LANES_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace
+{
+	constexpr size_t LANES = 4;
+	constexpr size_t BLOCK_SIZE = 64;
+
+	constexpr uint_least32_t INITIAL_STATE[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+	constexpr uint_least32_t K[64] = {
+		0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+		0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+		0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+		0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+		0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+		0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+		0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+		0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+	};
+
+	constexpr int SHIFTS[64] = {
+		7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+		5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+		4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+		6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+	};
+
+#ifdef MD5LANES_SSE2
+	namespace Sse2
+	{
+		struct Vec
+		{
+			static Vec Load(const uint_least32_t* lanes) { return {_mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes))}; }
+			static Vec Splat(uint_least32_t value) { return {_mm_set1_epi32(static_cast<int>(value))}; }
+			void Store(uint_least32_t* lanes) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v); }
+
+			__m128i v;
+		};
+
+		inline Vec operator+(Vec a, Vec b) { return {_mm_add_epi32(a.v, b.v)}; }
+		inline Vec operator&(Vec a, Vec b) { return {_mm_and_si128(a.v, b.v)}; }
+		inline Vec operator|(Vec a, Vec b) { return {_mm_or_si128(a.v, b.v)}; }
+		inline Vec operator^(Vec a, Vec b) { return {_mm_xor_si128(a.v, b.v)}; }
+		inline Vec AndNot(Vec a, Vec b) { return {_mm_andnot_si128(a.v, b.v)}; } // ~a & b
+		inline Vec RotateLeft(Vec a, int bits)
+		{
+			return {_mm_or_si128(_mm_sll_epi32(a.v, _mm_cvtsi32_si128(bits)), _mm_srl_epi32(a.v, _mm_cvtsi32_si128(32 - bits)))};
+		}
+	}
+#endif
+
+	namespace Portable
+	{
+		struct Vec
+		{
+			static Vec Load(const uint_least32_t* lanes) { Vec out; std::copy(lanes, lanes + LANES, out.v); return out; }
+			static Vec Splat(uint_least32_t value) { Vec out; std::fill(out.v, out.v + LANES, value); return out; }
+			void Store(uint_least32_t* lanes) const { std::copy(v, v + LANES, lanes); }
+
+			uint_least32_t v[LANES];
+		};
+
+		template <typename Op>
+		inline Vec Map(Vec a, Vec b, Op op)
+		{
+			Vec out;
+			for (size_t i = 0; i < LANES; ++i)
+			{
+				out.v[i] = static_cast<uint_least32_t>(op(a.v[i], b.v[i]));
+			}
+
+			return out;
+		}
+
+		inline Vec operator+(Vec a, Vec b) { return Map(a, b, [](uint_least32_t x, uint_least32_t y) { return (x + y) & 0xffffffffu; }); }
+		inline Vec operator&(Vec a, Vec b) { return Map(a, b, [](uint_least32_t x, uint_least32_t y) { return x & y; }); }
+		inline Vec operator|(Vec a, Vec b) { return Map(a, b, [](uint_least32_t x, uint_least32_t y) { return x | y; }); }
+		inline Vec operator^(Vec a, Vec b) { return Map(a, b, [](uint_least32_t x, uint_least32_t y) { return x ^ y; }); }
+		inline Vec AndNot(Vec a, Vec b) { return Map(a, b, [](uint_least32_t x, uint_least32_t y) { return ~x & y & 0xffffffffu; }); }
+		inline Vec RotateLeft(Vec a, int bits)
+		{
+			Vec out;
+			for (size_t i = 0; i < LANES; ++i)
+			{
+				out.v[i] = ((a.v[i] << bits) | (a.v[i] >> (32 - bits))) & 0xffffffffu;
+			}
+
+			return out;
+		}
+	}
+
+	inline uint_least32_t LoadLittleEndian32(const uint_least8_t* bytes)
+	{
+		return static_cast<uint_least32_t>(bytes[0]) | (static_cast<uint_least32_t>(bytes[1]) << 8) | (static_cast<uint_least32_t>(bytes[2]) << 16) | (static_cast<uint_least32_t>(bytes[3]) << 24);
+	}
+
+	// Lane-major state: state[word][lane].
+	template <typename Vec>
+	void CompressBlocks(uint_least32_t (&state)[4][LANES], const uint_least8_t* const (&blocks)[LANES])
+	{
+		alignas(16) uint_least32_t words[16][LANES];
+		for (size_t lane = 0; lane < LANES; ++lane)
+		{
+			for (size_t i = 0; i < 16; ++i)
+			{
+				words[i][lane] = LoadLittleEndian32(blocks[lane] + i * 4);
+			}
+		}
+
+		Vec m[16];
+		for (size_t i = 0; i < 16; ++i)
+		{
+			m[i] = Vec::Load(words[i]);
+		}
+
+		const Vec a0 = Vec::Load(state[0]);
+		const Vec b0 = Vec::Load(state[1]);
+		const Vec c0 = Vec::Load(state[2]);
+		const Vec d0 = Vec::Load(state[3]);
+		Vec a = a0;
+		Vec b = b0;
+		Vec c = c0;
+		Vec d = d0;
+		const Vec ones = Vec::Splat(0xffffffffu);
+
+		for (int i = 0; i < 64; ++i)
+		{
+			Vec f;
+			int g;
+			if (i < 16)
+			{
+				f = (b & c) | AndNot(b, d);
+				g = i;
+			}
+			else if (i < 32)
+			{
+				f = (d & b) | AndNot(d, c);
+				g = (5 * i + 1) % 16;
+			}
+			else if (i < 48)
+			{
+				f = b ^ c ^ d;
+				g = (3 * i + 5) % 16;
+			}
+			else
+			{
+				f = c ^ (b | (d ^ ones));
+				g = (7 * i) % 16;
+			}
+
+			f = f + a + Vec::Splat(K[i]) + m[g];
+			a = d;
+			d = c;
+			c = b;
+			b = b + RotateLeft(f, SHIFTS[i]);
+		}
+
+		(a0 + a).Store(state[0]);
+		(b0 + b).Store(state[1]);
+		(c0 + c).Store(state[2]);
+		(d0 + d).Store(state[3]);
+	}
+
+	// Feeds the padded message of one input a block at a time.
+	class LaneFeed
+	{
+	public:
+		void Reset(const Md5Lanes::Input& input)
+		{
+			_input = input;
+			_nextBlock = 0;
+			_blockCount = (input.size + 8) / BLOCK_SIZE + 1; // Data, 0x80 marker & 64-bit length.
+		}
+
+		bool IsDone() const
+		{
+			return _nextBlock >= _blockCount;
+		}
+
+		const uint_least8_t* NextBlock()
+		{
+			const size_t offset = _nextBlock++ * BLOCK_SIZE;
+			if (offset + BLOCK_SIZE <= _input.size)
+			{
+				return _input.data + offset; // Whole block straight from the input.
+			}
+
+			// Tail block(s) with the padding
+			std::fill(_tail, _tail + BLOCK_SIZE, 0);
+			if (offset < _input.size)
+			{
+				memcpy(_tail, _input.data + offset, _input.size - offset);
+			}
+
+			if (offset <= _input.size)
+			{
+				_tail[_input.size - offset] = 0x80;
+			}
+
+			if (_nextBlock == _blockCount)
+			{
+				const uint_least64_t bitLength = static_cast<uint_least64_t>(_input.size) * 8;
+				for (size_t i = 0; i < 8; ++i)
+				{
+					_tail[BLOCK_SIZE - 8 + i] = static_cast<uint_least8_t>(bitLength >> (i * 8));
+				}
+			}
+
+			return _tail;
+		}
+
+	private:
+		Md5Lanes::Input _input;
+		size_t _nextBlock = 0;
+		size_t _blockCount = 0;
+		uint_least8_t _tail[BLOCK_SIZE] = {};
+	};
+
+	template <typename Vec>
+	std::vector<Md5Lanes::Digest> HashAllWith(const std::vector<Md5Lanes::Input>& inputs)
+	{
+		std::vector<Md5Lanes::Digest> digests(inputs.size());
+
+		LaneFeed feeds[LANES];
+		size_t laneInput[LANES] = {};
+		bool laneActive[LANES] = {};
+		uint_least32_t state[4][LANES] = {};
+		size_t nextInput = 0;
+
+		const auto refillLane = [&](size_t lane)
+		{
+			laneActive[lane] = nextInput < inputs.size();
+			if (laneActive[lane])
+			{
+				laneInput[lane] = nextInput++;
+				feeds[lane].Reset(inputs.at(laneInput[lane]));
+				for (size_t word = 0; word < 4; ++word)
+				{
+					state[word][lane] = INITIAL_STATE[word];
+				}
+			}
+		};
+
+		for (size_t lane = 0; lane < LANES; ++lane)
+		{
+			refillLane(lane);
+		}
+
+		static constexpr uint_least8_t idleBlock[BLOCK_SIZE] = {}; // Fed to the idle lanes, result is ignored.
+
+		while (std::any_of(laneActive, laneActive + LANES, [](bool active) { return active; }))
+		{
+			const uint_least8_t* blocks[LANES];
+			for (size_t lane = 0; lane < LANES; ++lane)
+			{
+				blocks[lane] = (laneActive[lane]) ? feeds[lane].NextBlock() : idleBlock;
+			}
+
+			CompressBlocks<Vec>(state, blocks);
+
+			for (size_t lane = 0; lane < LANES; ++lane)
+			{
+				if (!laneActive[lane] || !feeds[lane].IsDone())
+				{
+					continue;
+				}
+
+				Md5Lanes::Digest& digest = digests.at(laneInput[lane]);
+				for (size_t word = 0; word < 4; ++word)
+				{
+					for (size_t i = 0; i < 4; ++i)
+					{
+						digest[word * 4 + i] = static_cast<uint_least8_t>(state[word][lane] >> (i * 8));
+					}
+				}
+
+				refillLane(lane);
+			}
+		}
+
+		return digests;
+	}
+}
+
+namespace Md5Lanes
+{
+	std::vector<Digest> HashAll(const std::vector<Input>& inputs)
+	{
+#ifdef MD5LANES_SSE2
+		return HashAllWith<Sse2::Vec>(inputs);
+#else
+		return HashAllWith<Portable::Vec>(inputs);
+#endif
+	}
+
+	std::vector<Digest> HashAllPortable(const std::vector<Input>& inputs)
+	{
+		return HashAllWith<Portable::Vec>(inputs);
+	}
+}
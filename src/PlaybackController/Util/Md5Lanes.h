@@ -0,0 +1,43 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Batch MD5 hashing: several buffers are hashed at once in interleaved SIMD lanes (SSE2 when available, otherwise plain lane-interleaved code).
+/// A lane that finishes its buffer is immediately refilled with the next one, so buffers of very different sizes don't leave lanes idle.
+namespace Md5Lanes
+{
+	using Digest = std::array<uint_least8_t, 16>;
+
+	struct Input
+	{
+		const uint_least8_t* data = nullptr;
+		size_t size = 0;
+	};
+
+	/// @brief Returns the digests in the order of the inputs.
+	std::vector<Digest> HashAll(const std::vector<Input>& inputs);
+
+	/// @brief Same as HashAll but always with the plain lane-interleaved code (which HashAll falls back to without SSE2).
+	std::vector<Digest> HashAllPortable(const std::vector<Input>& inputs);
+}
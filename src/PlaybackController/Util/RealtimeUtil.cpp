@@ -0,0 +1,122 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#include "RealtimeUtil.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#endif
+
+namespace
+{
+	constexpr int RENDER_THREAD_PRIORITY = 10; // Modest: above any regular thread, but below the audio server's (and the audio callback's) real-time threads.
+}
+
+namespace RealtimeUtil
+{
+	bool IsSupported()
+	{
+#ifdef __linux__
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool TryPrefaultAndLock(void* memory, size_t bytes)
+	{
+#ifdef __linux__
+		if (memory == nullptr || bytes == 0)
+		{
+			return false;
+		}
+
+		// Write-access each page (preserving its content), otherwise it may just get mapped to the shared zero page.
+		const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		volatile char* const data = static_cast<volatile char*>(memory);
+		for (size_t offset = 0; offset < bytes; offset += pageSize)
+		{
+			data[offset] = data[offset];
+		}
+
+		data[bytes - 1] = data[bytes - 1]; // The last page might not be page-aligned relative to the start.
+
+		return mlock(memory, bytes) == 0;
+#else
+		(void)memory;
+		(void)bytes;
+		return false;
+#endif
+	}
+
+	void Unlock(void* memory, size_t bytes)
+	{
+#ifdef __linux__
+		if (memory != nullptr && bytes != 0)
+		{
+			munlock(memory, bytes);
+		}
+#else
+		(void)memory;
+		(void)bytes;
+#endif
+	}
+
+	bool TryMakeThreadRealtime(std::thread& thread)
+	{
+#ifdef __linux__
+		for (const int policy : {SCHED_FIFO, SCHED_RR})
+		{
+			sched_param param{};
+			param.sched_priority = std::clamp(RENDER_THREAD_PRIORITY, sched_get_priority_min(policy), sched_get_priority_max(policy));
+			if (pthread_setschedparam(thread.native_handle(), policy, &param) == 0)
+			{
+				return true;
+			}
+		}
+
+		return false;
+#else
+		(void)thread;
+		return false;
+#endif
+	}
+
+	bool TryPinThread(std::thread& thread, int cpuCore)
+	{
+#ifdef __linux__
+		if (cpuCore < 0 || cpuCore >= CPU_SETSIZE)
+		{
+			return false;
+		}
+
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(cpuCore, &cpuSet);
+		return pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+		(void)thread;
+		(void)cpuCore;
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,50 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <thread>
+
+/// @brief Helpers of the opt-in real-time playback mode (Linux only, they just return false elsewhere).
+namespace RealtimeUtil
+{
+	/// @brief What the OS granted (each one is attempted independently).
+	struct Grants
+	{
+		bool memoryLocked = false;
+		bool realtimeScheduling = false;
+		bool cpuPinned = false;
+	};
+
+	/// @brief Whether the platform supports the real-time mode at all.
+	bool IsSupported();
+
+	/// @brief Touches every page of the memory (so it's backed up front rather than page-faulting on the first access), then locks it in RAM if permitted (see RLIMIT_MEMLOCK). Returns whether it got locked.
+	/// Reminder: nobody else may be writing to the memory meanwhile.
+	bool TryPrefaultAndLock(void* memory, size_t bytes);
+
+	/// @brief Releases the lock of the TryPrefaultAndLock. Must be called before the memory is freed.
+	void Unlock(void* memory, size_t bytes);
+
+	/// @brief Switches the thread to the SCHED_FIFO (or else SCHED_RR) policy if permitted (see RLIMIT_RTPRIO). Returns whether it got switched.
+	bool TryMakeThreadRealtime(std::thread& thread);
+
+	/// @brief Pins the thread to a CPU core. Returns false if not permitted or the core is negative (i.e., none chosen).
+	bool TryPinThread(std::thread& thread, int cpuCore);
+}
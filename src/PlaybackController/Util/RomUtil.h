@@ -52,6 +52,13 @@ namespace RomUtil
 		};
 	};
 
+	struct RomPaths
+	{
+		std::wstring kernal;
+		std::wstring basic;
+		std::wstring chargen;
+	};
+
 	// Sanity check if non-empty paths point to a missing or obviously incorrect files. Paths should be absolute.
     RomStatus PreCheckRoms(const std::wstring& pathKernal, const std::wstring& pathBasic, const std::wstring& pathChargen);
 }
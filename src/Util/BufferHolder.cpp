@@ -22,11 +22,21 @@ BufferHolder::BufferHolder(size_t bufferSize)
 {
 	size = bufferSize;
 	buffer = new uint_least8_t[size];
+	data = buffer;
+}
+
+BufferHolder::BufferHolder(std::unique_ptr<MappedFile> mappedFile) :
+	_mappedFile(std::move(mappedFile))
+{
+	size = _mappedFile->GetSize();
+	data = reinterpret_cast<const uint_least8_t*>(_mappedFile->GetData());
 }
 
 BufferHolder::~BufferHolder()
 {
 	delete[] buffer;
+	_mappedFile = nullptr; // Unmaps.
 	buffer = nullptr;
+	data = nullptr;
 	size = 0;
 }
@@ -18,7 +18,9 @@
 
 #pragma once
 
+#include "MappedFile.h"
 #include <cstdint>
+#include <memory>
 
 struct BufferHolder // Designed for holding a buffered SID Tune (when loaded from a Zip file) for use with libsidplayfp.
 {
@@ -27,8 +29,16 @@ struct BufferHolder // Designed for holding a buffered SID Tune (when loaded fro
 	BufferHolder& operator=(const BufferHolder&) = delete;
 
 	explicit BufferHolder(size_t bufferSize);
+
+	/// @brief Wraps the content of a memory-mapped file instead of allocating a copy. Reminder: such content is read-only (there's no buffer) and keeps the file open, so it's only meant for short-lived uses.
+	explicit BufferHolder(std::unique_ptr<MappedFile> mappedFile);
+
 	~BufferHolder();
 
-	uint_least8_t* buffer = nullptr;
+	uint_least8_t* buffer = nullptr; // Writable (nullptr if mapped).
+	const uint_least8_t* data = nullptr; // Content of either the buffer or the mapping.
 	size_t size = 0;
+
+private:
+	std::unique_ptr<MappedFile> _mappedFile;
 };
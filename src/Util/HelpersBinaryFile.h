@@ -0,0 +1,99 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+namespace Helpers
+{
+	namespace BinaryFile
+	{
+		template <typename T>
+		void Write(std::ostream& os, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template <typename T>
+		bool TryRead(std::istream& is, T& out)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			return static_cast<bool>(is.read(reinterpret_cast<char*>(&out), sizeof(T)));
+		}
+
+		/// @brief Writes the length (32-bit) followed by the characters.
+		template <typename CharT>
+		void WriteString(std::ostream& os, const std::basic_string<CharT>& str)
+		{
+			Write(os, static_cast<uint_least32_t>(str.size()));
+			os.write(reinterpret_cast<const char*>(str.data()), str.size() * sizeof(CharT));
+		}
+
+		/// @brief Reads what the WriteString wrote. Fails if the length exceeds the maxLength (sanity limit, e.g., for a corrupted file).
+		template <typename CharT>
+		bool TryReadString(std::istream& is, std::basic_string<CharT>& out, uint_least32_t maxLength)
+		{
+			uint_least32_t length = 0;
+			if (!TryRead(is, length) || length > maxLength)
+			{
+				return false;
+			}
+
+			out.resize(length);
+			return static_cast<bool>(is.read(reinterpret_cast<char*>(out.data()), length * sizeof(CharT)));
+		}
+
+		/// @brief Writes the content into a temporary file next to the target, which then replaces the target. An interrupted save thus can't leave a truncated file behind.
+		inline bool TrySaveReplacing(const std::filesystem::path& filepath, const std::function<void(std::ostream&)>& writeContent)
+		{
+			std::filesystem::path tempFilepath = filepath;
+			tempFilepath += ".tmp";
+
+			std::error_code ec;
+			{
+				std::ofstream file(tempFilepath, std::ios::binary | std::ios::trunc);
+				writeContent(file);
+				file.close();
+
+				if (file.fail())
+				{
+					std::filesystem::remove(tempFilepath, ec);
+					return false;
+				}
+			}
+
+			std::filesystem::rename(tempFilepath, filepath, ec); // Reminder: replaces the existing one (also on Windows).
+			if (ec)
+			{
+				std::error_code ignored;
+				std::filesystem::remove(tempFilepath, ignored);
+				return false;
+			}
+
+			return true;
+		}
+	}
+}
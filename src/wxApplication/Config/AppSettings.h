@@ -34,11 +34,21 @@ namespace Settings
 			// Prefs
 			static constexpr const char* const AudioOutputDevice = "AudioOutputDevice";
 			static constexpr const char* const LowLatency = "LowLatency";
+			static constexpr const char* const AdaptiveLatency = "AdaptiveLatency";
 			static constexpr const char* const ForceMono = "ForceMono";
+			static constexpr const char* const RenderAheadMs = "RenderAheadMs";
+			static constexpr const char* const RealtimeMode = "RealtimeMode";
+			static constexpr const char* const RealtimeCpuCore = "RealtimeCpuCore";
 
 			static constexpr const char* const PreRenderEnabled = "PreRenderEnabled";
+			static constexpr const char* const PreRenderLookahead = "PreRenderLookahead";
+			static constexpr const char* const PreRenderMemoryLimitMb = "PreRenderMemoryLimitMb";
+			static constexpr const char* const PreRenderVoiceStems = "PreRenderVoiceStems";
+			static constexpr const char* const PreRenderCacheMb = "PreRenderCacheMb";
 			static constexpr const char* const AutoPlay = "AutoPlay";
+			static constexpr const char* const GaplessPlayback = "GaplessPlayback";
 			static constexpr const char* const SongFallbackDuration = "SongFallbackDuration";
+			static constexpr const char* const EstimateDurations = "EstimateDurations";
 			static constexpr const char* const SkipShorter = "SkipShorter";
 			static constexpr const char* const PopSilencer = "PopSilencer";
 			static constexpr const char* const DragDropMode = "DragDropMode";
@@ -127,14 +137,24 @@ namespace Settings
 				// Prefs
 				DefaultOption(ID::AudioOutputDevice, ""),
 				DefaultOption(ID::LowLatency, true),
+				DefaultOption(ID::AdaptiveLatency, false),
 				DefaultOption(ID::ForceMono, false),
+				DefaultOption(ID::RenderAheadMs, 100),
+				DefaultOption(ID::RealtimeMode, false),
+				DefaultOption(ID::RealtimeCpuCore, -1),
 
 				DefaultOption(ID::PreRenderEnabled, false),
+				DefaultOption(ID::PreRenderLookahead, 2),
+				DefaultOption(ID::PreRenderMemoryLimitMb, 64),
+				DefaultOption(ID::PreRenderVoiceStems, false),
+				DefaultOption(ID::PreRenderCacheMb, 256),
 				DefaultOption(ID::AutoPlay, true),
+				DefaultOption(ID::GaplessPlayback, true),
 				DefaultOption(ID::RepeatMode, static_cast<int>(UIElements::RepeatModeButton::RepeatMode::Normal)),
 				DefaultOption(ID::RepeatModeIncludeSubsongs, false),
 				DefaultOption(ID::RepeatModeDefaultSubsong, true),
 				DefaultOption(ID::SongFallbackDuration, 180),
+				DefaultOption(ID::EstimateDurations, false),
 				DefaultOption(ID::SkipShorter, 0),
 				DefaultOption(ID::PopSilencer, 100),
 				DefaultOption(ID::DragDropMode, static_cast<int>(DragDropMode::Dual)),
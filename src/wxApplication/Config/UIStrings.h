@@ -129,10 +129,12 @@ namespace Strings
 		inline constexpr const char* const SID_VOICE("Voice");
 		inline constexpr const char* const VOICE_ACTIVE("Active");
 		inline constexpr const char* const VOICE_MENU_ITEM_SOLO("Solo");
-		inline constexpr const char* const VOICES_UNAVAILABLE_PRERENDER("Voices state frozen during playback in Fast seeking mode.");
+		inline constexpr const char* const VOICES_UNAVAILABLE_PRERENDER("Voices state frozen during playback in Fast seeking mode (per-voice pre-render is off or exceeds the memory limit).");
 
 		inline constexpr const char* const SPEED_SLIDER("Playback Speed (%)");
 		inline constexpr const char* const SPEED_SLIDER_MENU_ITEM_RESET("Reset to 100%");
+		inline constexpr const char* const SPEED_PRESERVE_PITCH("Preserve pitch");
+		inline constexpr const char* const SPEED_PRESERVE_PITCH_TOOLTIP("Change the tempo only (time-stretching) rather than both the tempo and the pitch.");
 	}
 
 	namespace Preferences
@@ -146,23 +148,50 @@ namespace Strings
 		// Audio Output
 		inline constexpr const char* const CATEGORY_AUDIO_OUTPUT("Audio output");
 		inline constexpr const char* const OPT_DEVICE("Device");
-		inline constexpr const char* const DESC_DEVICE("- Modifying the playback speed is not supported on all device interfaces (e.g., WASAPI).\nNote: ongoing playback will stop when changing this setting.");
+		inline constexpr const char* const DESC_DEVICE("Note: ongoing playback will stop when changing this setting.");
 
 		inline constexpr const char* const OPT_LOW_LATENCY("Low latency");
 		inline constexpr const char* const DESC_LOW_LATENCY("Enable for more responsive controls.\nDisable if experiencing stuttering.\nNote: ongoing playback will stop when changing this setting.");
 
+		inline constexpr const char* const OPT_ADAPTIVE_LATENCY("Adaptive latency");
+		inline constexpr const char* const DESC_ADAPTIVE_LATENCY("Learn the smallest stutter-free audio buffer for each device (and the number of SID chips) over time, starting from the Low latency setting.\n- The buffer grows after a playback with dropouts and shrinks after several smooth ones.\nTakes effect from the next playback start.");
+
 		inline constexpr const char* const OPT_FORCE_MONO("Force mono");
 		inline constexpr const char* const DESC_FORCE_MONO("Disables stereo/panning effects of multi-SID tunes (2SID, 3SID).\nNote: ongoing playback will stop when changing this setting.");
 
+		inline constexpr const char* const OPT_RENDER_AHEAD("Render-ahead buffer");
+		inline constexpr const char* const DESC_RENDER_AHEAD("Amount of audio (in milliseconds) emulated ahead of time in a separate thread, so emulation spikes don't cause audible dropouts.\n- Increase if experiencing stuttering.\n- Set to 0 to emulate directly in the audio callback.\n- Values too small to hold two audio buffers are treated as 0.\n- Not used in Fast seeking mode.\nTakes effect from the next playback start.");
+
+		inline constexpr const char* const OPT_REALTIME_MODE("Real-time mode");
+		inline constexpr const char* const DESC_REALTIME_MODE("Lock the playback buffers in RAM and run the render-ahead thread with a real-time scheduling priority, for dropout-free playback on a busy system (Linux only).\n- Requires the memlock and rtprio limits to be raised for the user (e.g., in /etc/security/limits.conf), otherwise it's partially or entirely denied (see the log).\nTakes effect from the next playback start.");
+
+		inline constexpr const char* const OPT_REALTIME_CPU_CORE("Real-time CPU core");
+		inline constexpr const char* const DESC_REALTIME_CPU_CORE("Pin the render-ahead thread to this CPU core in Real-time mode (-1 to let the system choose).\n- Best used with a core isolated from the other tasks (e.g., via the isolcpus kernel parameter).\nTakes effect from the next playback start.");
+
 		// Playback behavior
 		inline constexpr const char* const CATEGORY_PLAYBACK_BEHAVIOR("Playback behavior");
 
 		inline constexpr const char* const OPT_PRERENDER("Fast seeking");
-		inline constexpr const char* const DESC_PRERENDER("Pre-render the song in the background for faster seeking (especially backwards).\n- Some realtime features (e.g., toggling voices, Leave Running) won't work during playback in this mode.\n- Ongoing playback will stop when changing this setting.\n(This option is also available in a Repeat Mode button's context menu.)");
+		inline constexpr const char* const DESC_PRERENDER("Pre-render the song in the background for faster seeking (especially backwards).\n- Some realtime features (e.g., Leave Running, or toggling voices unless pre-rendered per voice) won't work during playback in this mode.\n- Ongoing playback will stop when changing this setting.\n(This option is also available in a Repeat Mode button's context menu.)");
+
+		inline constexpr const char* const OPT_PRERENDER_LOOKAHEAD("Fast seeking look-ahead");
+		inline constexpr const char* const DESC_PRERENDER_LOOKAHEAD("Number of upcoming (sub)songs to pre-render in parallel while in Fast seeking mode, so they can start from an already complete buffer.\n- Limited by the number of available CPU cores.\n- Each one takes up additional memory until played.\n- Set to 0 to disable.");
+
+		inline constexpr const char* const OPT_PRERENDER_MEMORY_LIMIT("Fast seeking memory limit (MB)");
+		inline constexpr const char* const DESC_PRERENDER_MEMORY_LIMIT("Maximum memory a single (sub)song may take up while in Fast seeking mode. Longer ones are pre-rendered only around the current position instead, seeking outside of which takes a bit longer.\n- Upcoming (sub)songs exceeding this are not pre-rendered in advance.\n- Set to 0 for no limit.");
+
+		inline constexpr const char* const OPT_PRERENDER_VOICE_STEMS("Fast seeking per voice");
+		inline constexpr const char* const DESC_PRERENDER_VOICE_STEMS("Pre-render each voice separately (in parallel) so the voices can still be toggled instantly during playback in Fast seeking mode.\n- Takes several times more memory and CPU, (sub)songs that don't fit within the memory limit this way are pre-rendered normally, as are the ones already pre-rendered ahead of time.\n- The filter is shared among the voices on a real SID, so the mix of separately rendered voices may sound very slightly different.\n- Takes effect from the next playback.");
+
+		inline constexpr const char* const OPT_PRERENDER_CACHE("Fast seeking cache (MB)");
+		inline constexpr const char* const DESC_PRERENDER_CACHE("Memory for keeping the complete pre-renders of the recently played (sub)songs, so going back to them starts (and seeks) instantly without pre-rendering them again.\n- Least recently played ones are discarded first when full.\n- Set to 0 to disable.");
 
 		inline constexpr const char* const OPT_AUTOPLAY("Autoplay");
 		inline constexpr const char* const DESC_AUTOPLAY("- Play added files immediately (unless enqueued).\n- Always start playback on track navigation.");
 
+		inline constexpr const char* const OPT_GAPLESS("Gapless playback");
+		inline constexpr const char* const DESC_GAPLESS("Prepare the next (sub)song in the background and continue with it seamlessly once the current one ends, without a pause in between.\n- Follows the Repeat Mode.\n- Not used in Fast seeking mode.");
+
 		inline constexpr const char* const OPT_START_DEFAULT_SUBSONG("Start default subsong");
 		inline constexpr const char* const DESC_START_DEFAULT_SUBSONG("Start multi-tunes from their default subsong (indicated with a crown icon, isn't necessarily the first subsong).\nTurn this off to always start a multi-tune from its first subsong.\n(This option is also available in a Repeat Mode button's context menu.)");
 
@@ -172,6 +201,9 @@ namespace Strings
 		inline constexpr const char* const OPT_FALLBACK_DURATION("Fallback duration");
 		inline constexpr const char* const DESC_FALLBACK_DURATION("Song duration (in seconds) when its real duration is unknown (i.e., song is not in a Songlengths.md5 database).");
 
+		inline constexpr const char* const OPT_ESTIMATE_DURATIONS("Estimate unknown durations");
+		inline constexpr const char* const DESC_ESTIMATE_DURATIONS("Analyze the (sub)songs missing from the Songlengths.md5 database in the background (by detecting where they loop or fall silent), and use the estimated durations instead of the fallback duration.\nEstimated durations are indicated with a ~ sign in the playlist.");
+
 		inline constexpr const char* const OPT_SKIP_SHORTER("Auto-skip shorter");
 		inline constexpr const char* const DESC_SKIP_SHORTER("Auto-skip (sub)songs with durations below the specified threshold (in seconds). Affected (sub)songs will be indicated with a timer icon. You can still force playback by activating them in the playlist directly.\nSet to 0 to disable this feature.\n\nNOTE: displaying lots of timer icons degrades the playlist scrolling performance (wxWidgets issue).");
 
@@ -87,6 +87,9 @@ namespace FrameElements
 	    sliderPlaybackSpeed = new wxSlider(sizer_6->GetStaticBox(), wxID_ANY, 100, 50, 200, wxDefaultPosition, wxDefaultSize, wxSL_HORIZONTAL | wxSL_LABELS);
 		sliderPlaybackSpeed->SetPageSize(5);
 	    sizer_6->Add(sliderPlaybackSpeed, 0, wxEXPAND, 0);
+		chkPreservePitch = new wxCheckBox(sizer_6->GetStaticBox(), wxID_ANY, Strings::PlaybackMods::SPEED_PRESERVE_PITCH);
+		chkPreservePitch->SetToolTip(Strings::PlaybackMods::SPEED_PRESERVE_PITCH_TOOLTIP);
+		sizer_6->Add(chkPreservePitch, 0, wxALL, 5);
 
 		// Setup
 	    _parentPanel.SetSizer(sizerParent);
@@ -84,6 +84,7 @@ namespace FrameElements
 		wxStaticText* labelPreRenderActive;
 
 	    wxSlider* sliderPlaybackSpeed;
+		wxCheckBox* chkPreservePitch;
 
 	private:
 		wxPanel& _parentPanel;
@@ -42,7 +42,9 @@ FramePlaybackMods::FramePlaybackMods(wxWindow* parent, const wxString& title, co
     }
 
     _ui->sliderPlaybackSpeed->Bind(wxEVT_SCROLL_CHANGED, &OnSpeedSlider, this);
+    _ui->sliderPlaybackSpeed->Bind(wxEVT_SCROLL_THUMBTRACK, &OnSpeedSlider, this); // Speed changes are seamless, so follow the slider while dragging.
     _ui->sliderPlaybackSpeed->Bind(wxEVT_SCROLL_THUMBRELEASE , &OnSpeedSlider, this);
+    _ui->chkPreservePitch->Bind(wxEVT_CHECKBOX, &OnPreservePitchCheckBox, this);
 
     Bind(wxEVT_CHAR_HOOK, &OnCharHook, this);
 
@@ -72,10 +74,11 @@ void FramePlaybackMods::UpdateUiState()
         return;
     }
 
-    const bool changeable = !(_app.GetPlaybackInfo().GetState() != PlaybackController::State::Stopped && _app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool());
+    const PlaybackController& playback = _app.GetPlaybackInfo();
+    const bool preRenderPlayback = playback.GetState() != PlaybackController::State::Stopped && _app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool();
+    const bool changeable = !preRenderPlayback || playback.IsPreRenderPerVoice();
     _ui->labelPreRenderActive->Show(!changeable);
 
-    const PlaybackController& playback = _app.GetPlaybackInfo();
     const int sidChipsRequired = playback.GetCurrentTuneSidChipsRequired();
 
     for (wxCheckBox* chkBox : _ui->GetVoiceCheckBoxes())
@@ -88,6 +91,7 @@ void FramePlaybackMods::UpdateUiState()
 
     _ui->SetActiveSidsIndicator(sidChipsRequired);
     _ui->sliderPlaybackSpeed->SetValue(playback.GetPlaybackSpeedFactor() * 100);
+    _ui->chkPreservePitch->SetValue(playback.IsPitchPreserved());
 }
 
 void FramePlaybackMods::OnSpeedSlider(wxCommandEvent& evt)
@@ -108,6 +112,11 @@ void FramePlaybackMods::OnSpeedSlider(wxCommandEvent& evt)
     }
 }
 
+void FramePlaybackMods::OnPreservePitchCheckBox(wxCommandEvent& evt)
+{
+    _app.SetPitchPreserved(evt.IsChecked());
+}
+
 void FramePlaybackMods::OnVoiceCheckBox(wxCommandEvent& evt)
 {
     const VoiceCheckBoxData* const data = dynamic_cast<VoiceCheckBoxData*>(evt.GetEventObject()->GetRefData());
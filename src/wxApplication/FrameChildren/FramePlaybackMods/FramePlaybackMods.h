@@ -46,6 +46,7 @@ private:
     void UpdateUiState();
 
     void OnSpeedSlider(wxCommandEvent& evt);
+    void OnPreservePitchCheckBox(wxCommandEvent& evt);
     void OnVoiceCheckBox(wxCommandEvent& evt);
     void OnCharHook(wxKeyEvent& evt);
 
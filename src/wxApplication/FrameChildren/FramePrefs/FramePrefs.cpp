@@ -28,6 +28,21 @@ namespace
     constexpr int MIN_DURATION = 0;
     constexpr int MAX_DURATION = 3600;
 
+    constexpr int MIN_RENDER_AHEAD = 0;
+    constexpr int MAX_RENDER_AHEAD = 2000;
+
+    constexpr int MIN_REALTIME_CPU_CORE = -1;
+    constexpr int MAX_REALTIME_CPU_CORE = 255;
+
+    constexpr int MIN_PRERENDER_LOOKAHEAD = 0;
+    constexpr int MAX_PRERENDER_LOOKAHEAD = 8;
+
+    constexpr int MIN_PRERENDER_MEMORY_LIMIT = 0;
+    constexpr int MAX_PRERENDER_MEMORY_LIMIT = 4096;
+
+    constexpr int MIN_PRERENDER_CACHE = 0;
+    constexpr int MAX_PRERENDER_CACHE = 16384;
+
     constexpr int MIN_POP_SILENCER = 0;
     constexpr int MAX_POP_SILENCER = 1000;
 
@@ -134,19 +149,31 @@ void FramePrefs::FillPropertyGrid()
         }
 
         AddWrappedProp(Settings::AppSettings::ID::LowLatency, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_LOW_LATENCY), *page, Effective::Immediately, Strings::Preferences::DESC_LOW_LATENCY);
+        AddWrappedProp(Settings::AppSettings::ID::AdaptiveLatency, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_ADAPTIVE_LATENCY), *page, Effective::Immediately, Strings::Preferences::DESC_ADAPTIVE_LATENCY);
         AddWrappedProp(Settings::AppSettings::ID::ForceMono, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_FORCE_MONO), *page, Effective::Immediately, Strings::Preferences::DESC_FORCE_MONO);
+        AddWrappedProp(Settings::AppSettings::ID::RenderAheadMs, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_RENDER_AHEAD), *page, Effective::Immediately, Strings::Preferences::DESC_RENDER_AHEAD, MIN_RENDER_AHEAD, MAX_RENDER_AHEAD);
+#ifdef __linux__
+        AddWrappedProp(Settings::AppSettings::ID::RealtimeMode, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_REALTIME_MODE), *page, Effective::Immediately, Strings::Preferences::DESC_REALTIME_MODE);
+        AddWrappedProp(Settings::AppSettings::ID::RealtimeCpuCore, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_REALTIME_CPU_CORE), *page, Effective::Immediately, Strings::Preferences::DESC_REALTIME_CPU_CORE, MIN_REALTIME_CPU_CORE, MAX_REALTIME_CPU_CORE);
+#endif
     }
 
     // Playback
     page->Append(new wxPropertyCategory(Strings::Preferences::CATEGORY_PLAYBACK_BEHAVIOR));
     {
         AddWrappedProp(Settings::AppSettings::ID::PreRenderEnabled, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_PRERENDER), *page, Effective::Immediately, Strings::Preferences::DESC_PRERENDER);
+        AddWrappedProp(Settings::AppSettings::ID::PreRenderLookahead, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_PRERENDER_LOOKAHEAD), *page, Effective::Immediately, Strings::Preferences::DESC_PRERENDER_LOOKAHEAD, MIN_PRERENDER_LOOKAHEAD, MAX_PRERENDER_LOOKAHEAD);
+        AddWrappedProp(Settings::AppSettings::ID::PreRenderMemoryLimitMb, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_PRERENDER_MEMORY_LIMIT), *page, Effective::Immediately, Strings::Preferences::DESC_PRERENDER_MEMORY_LIMIT, MIN_PRERENDER_MEMORY_LIMIT, MAX_PRERENDER_MEMORY_LIMIT);
+        AddWrappedProp(Settings::AppSettings::ID::PreRenderVoiceStems, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_PRERENDER_VOICE_STEMS), *page, Effective::Immediately, Strings::Preferences::DESC_PRERENDER_VOICE_STEMS);
+        AddWrappedProp(Settings::AppSettings::ID::PreRenderCacheMb, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_PRERENDER_CACHE), *page, Effective::Immediately, Strings::Preferences::DESC_PRERENDER_CACHE, MIN_PRERENDER_CACHE, MAX_PRERENDER_CACHE);
         AddWrappedProp(Settings::AppSettings::ID::AutoPlay, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_AUTOPLAY), *page, Effective::Immediately, Strings::Preferences::DESC_AUTOPLAY);
+        AddWrappedProp(Settings::AppSettings::ID::GaplessPlayback, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_GAPLESS), *page, Effective::Immediately, Strings::Preferences::DESC_GAPLESS);
 
         AddWrappedProp(Settings::AppSettings::ID::RepeatModeDefaultSubsong, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_START_DEFAULT_SUBSONG), *page, Effective::Immediately, Strings::Preferences::DESC_START_DEFAULT_SUBSONG);
         AddWrappedProp(Settings::AppSettings::ID::RepeatModeIncludeSubsongs, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_INCLUDE_SUBSONGS), *page, Effective::Immediately, Strings::Preferences::DESC_INCLUDE_SUBSONGS);
 
         AddWrappedProp(Settings::AppSettings::ID::SongFallbackDuration, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_FALLBACK_DURATION), *page, Effective::Immediately, Strings::Preferences::DESC_FALLBACK_DURATION, MIN_DURATION, MAX_DURATION);
+        AddWrappedProp(Settings::AppSettings::ID::EstimateDurations, TypeSerialized::Int, new wxBoolProperty(Strings::Preferences::OPT_ESTIMATE_DURATIONS), *page, Effective::Immediately, Strings::Preferences::DESC_ESTIMATE_DURATIONS);
         AddWrappedProp(Settings::AppSettings::ID::SkipShorter, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_SKIP_SHORTER), *page, Effective::Immediately, Strings::Preferences::DESC_SKIP_SHORTER, MIN_DURATION, MAX_DURATION);
         AddWrappedProp(Settings::AppSettings::ID::PopSilencer, TypeSerialized::Int, new wxIntProperty(Strings::Preferences::OPT_POP_SILENCER), *page, Effective::Immediately, Strings::Preferences::DESC_POP_SILENCER, MIN_POP_SILENCER, MAX_POP_SILENCER);
 
@@ -308,7 +335,7 @@ void FramePrefs::OnPropertyGridChanging(wxPropertyGridEvent& evt)
         }
         else if (SidDecoder _tempSidDecoder; _tempSidDecoder.TrySetRoms(pendingValue, L"", L"").IsValidated(RomUtil::RomType::Kernal))
         {
-            wxMessageBox(_tempSidDecoder.GetEngineInfo().kernalDesc(), Strings::Preferences::TITLE_ROM_INFO, wxICON_INFORMATION);
+            wxMessageBox(_tempSidDecoder.GetEngineInfo().kernalDesc, Strings::Preferences::TITLE_ROM_INFO, wxICON_INFORMATION);
         }
     }
     else if (strcmp(cId, Settings::AppSettings::ID::RomBasicPath) == 0)
@@ -323,7 +350,7 @@ void FramePrefs::OnPropertyGridChanging(wxPropertyGridEvent& evt)
         }
         else if (SidDecoder _tempSidDecoder; _tempSidDecoder.TrySetRoms(L"", pendingValue, L"").IsValidated(RomUtil::RomType::Basic))
         {
-            wxMessageBox(_tempSidDecoder.GetEngineInfo().basicDesc(), Strings::Preferences::TITLE_ROM_INFO);
+            wxMessageBox(_tempSidDecoder.GetEngineInfo().basicDesc, Strings::Preferences::TITLE_ROM_INFO);
         }
     }
     else if (strcmp(cId, Settings::AppSettings::ID::RomChargenPath) == 0)
@@ -338,7 +365,7 @@ void FramePrefs::OnPropertyGridChanging(wxPropertyGridEvent& evt)
         }
         else if (SidDecoder _tempSidDecoder; _tempSidDecoder.TrySetRoms(L"", L"", pendingValue).IsValidated(RomUtil::RomType::Chargen))
         {
-            wxMessageBox(_tempSidDecoder.GetEngineInfo().chargenDesc(), Strings::Preferences::TITLE_ROM_INFO);
+            wxMessageBox(_tempSidDecoder.GetEngineInfo().chargenDesc, Strings::Preferences::TITLE_ROM_INFO);
         }
     }
 }
@@ -384,14 +411,51 @@ void FramePrefs::OnButtonApply(wxCommandEvent& /*evt*/)
                     {
                         _framePlayer.ForceStopPlayback({});
                     }
+                    else if (prop.first == Settings::AppSettings::ID::RenderAheadMs)
+                    {
+                        _app.SetRenderAheadDepth(propertyValueInt);
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::AdaptiveLatency)
+                    {
+                        _app.SetAdaptiveLatency(propertyValueInt != 0);
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::RealtimeMode || prop.first == Settings::AppSettings::ID::RealtimeCpuCore)
+                    {
+                        _app.SetRealtimeMode(_app.currentSettings->GetOption(Settings::AppSettings::ID::RealtimeMode)->GetValueAsBool(), _app.currentSettings->GetOption(Settings::AppSettings::ID::RealtimeCpuCore)->GetValueAsInt());
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::GaplessPlayback || prop.first == Settings::AppSettings::ID::SonglengthsTrim)
+                    {
+                        _framePlayer.ArmGaplessNext({});
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::PreRenderLookahead)
+                    {
+                        _app.SetUpcomingPreRenderLimit(propertyValueInt);
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::PreRenderMemoryLimitMb)
+                    {
+                        _app.SetPreRenderMemoryLimit(propertyValueInt);
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::PreRenderVoiceStems)
+                    {
+                        _app.SetPreRenderVoiceStems(propertyValueInt != 0);
+                    }
+                    else if (prop.first == Settings::AppSettings::ID::PreRenderCacheMb)
+                    {
+                        _app.SetPreRenderCacheLimit(propertyValueInt);
+                    }
                     else if (prop.first == Settings::AppSettings::ID::SongFallbackDuration)
                     {
                         _framePlayer.UpdateIgnoredSongs({}); // Just in case the "skip shorter" is affected by this.
+                        _framePlayer.ArmGaplessNext({}); // Switch point may have changed.
                         if (_app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool())
                         {
                             _framePlayer.ForceStopPlayback({}); // Fallback duration setting can be changed in realtime (and that's immediately reflected in the seekbar), but that's not supported when playing in a pre-render mode (in case new duration is longer), so we simply stop the playback to force new pre-render upon manual playback restart.
                         }
                     }
+                    else if (prop.first == Settings::AppSettings::ID::EstimateDurations)
+                    {
+                        _framePlayer.EstimateUnknownDurations({});
+                    }
                     else if (prop.first == Settings::AppSettings::ID::SkipShorter)
                     {
                         _framePlayer.UpdateIgnoredSongs({});
@@ -25,7 +25,9 @@
 
 #include "ElementsPlayer.h"
 #include "../Theme/ThemeManager.h"
+#include "../../PlaybackController/DurationEstimator.h"
 #include "../../PlaybackController/PlaybackWrappers/Input/SidDecoder.h"
+#include "../../PlaybackController/TuneInfoCache.h"
 #include "../../Util/SimpleSignal/SimpleSignalListener.h"
 
 class FramePlaybackMods;
@@ -112,6 +114,8 @@ public:
     std::vector<wxString> GetCurrentPlaylistFilePaths(bool includeBlacklistedSongs);
     void DiscoverFilesAndSendToPlaylist(const wxArrayString& rawPaths, bool clearPrevious = true, bool autoPlayFirstImmediately = true);
     void UpdateIgnoredSongs(PassKey<FramePrefs>);
+    void ArmGaplessNext(PassKey<FramePrefs>);
+    void EstimateUnknownDurations(PassKey<FramePrefs>);
 
 private:
     void SendFilesToPlaylist(const wxArrayString& files, bool clearPrevious = true, bool autoPlayFirstImmediately = true);
@@ -121,6 +125,10 @@ private:
     void UpdateIgnoredSong(PlaylistTreeModelNode& mainSongNode);
     long GetEffectiveSongDuration(const PlaylistTreeModelNode& node) const;
 
+    /// @brief Queues the (sub)songs of unknown durations for the background analysis (if enabled).
+    void EstimateUnknownDurations(const std::vector<PlaylistTreeModelNode*>& mainSongNodes);
+    void ApplyEstimatedDurations();
+
 #pragma endregion
 #pragma region *** input ***
 
@@ -136,11 +144,19 @@ private:
 private:
     bool TryPlayPlaylistItem(const PlaylistTreeModelNode& node);
 
+    /// @brief Returns the node whose subsong the TryPlayPlaylistItem would actually play (the effective initial subsong of a main song with subsongs), nullptr if none is playable.
+    const PlaylistTreeModelNode* GetEffectivePlaybackNode(const PlaylistTreeModelNode& node) const;
+
     bool TryPlayNextValidSong();
     bool TryPlayPrevValidSong();
     bool TryPlayNextValidSubsong();
     bool TryPlayPrevValidSubsong();
 
+    void PreRenderUpcomingSongs(const PlaylistTreeModelNode& fromNode);
+
+    /// @brief Prepares whatever the repeat mode would play next to follow the active (sub)song seamlessly (or discards the prepared one if nothing should follow).
+    void ArmGaplessNext();
+
 #pragma endregion
 #pragma region *** wx Event handlers ***
 
@@ -184,6 +200,7 @@ private:
     bool OnButtonTunePrev();
 
     void OnSongDurationReached();
+    void OnGaplessTransition();
     void OnSeekingCeased();
     void OnRepeatModeExtraOptionToggled(ExtraOptionId extraOptionId);
 
@@ -205,6 +222,8 @@ private:
     wxPanel* _panel;
     ThemeManager _themeManager;
     SidDecoder _silentSidInfoDecoder;
+    TuneInfoCache _tuneInfoCache;
+    std::unique_ptr<DurationEstimator> _durationEstimator; // Lazily created.
     std::unique_ptr<FrameElements::ElementsPlayer> _ui;
     std::unique_ptr<wxTimer> _timer;
     FramePlaybackMods* _framePlaybackMods = nullptr;
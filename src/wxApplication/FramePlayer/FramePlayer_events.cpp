@@ -95,6 +95,7 @@ void FramePlayer::OnButtonRepeatMode(wxCommandEvent& evt)
     Settings::Option* option = _app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatMode);
     assert(newRepeatMode != RepeatMode::Undefined); // Neither the (correct) default nor loaded value was applied during the UI init!
     option->UpdateValue(static_cast<int>(newRepeatMode));
+    ArmGaplessNext();
 }
 
 void FramePlayer::OnSeekBackward(wxCommandEvent& evt)
@@ -433,8 +434,15 @@ void FramePlayer::OnTimer(wxTimerEvent& /*evt*/)
     const bool hiresUpdate = _ui->compositeSeekbar->IsSeekPreviewing() || cState == PlaybackController::State::Seeking || cState == PlaybackController::State::Playing;
     SetRefreshTimerThrottled(!hiresUpdate);
 
+    ApplyEstimatedDurations();
+
     if (cState != PlaybackController::State::Stopped && cState != PlaybackController::State::Undefined)
     {
+        if (_app.TryPromoteArmedTune())
+        {
+            OnGaplessTransition();
+        }
+
         const uint_least32_t playbackTimeMs = playbackInfo.GetTime();
         if (playbackTimeMs > 0)
         {
@@ -443,7 +451,7 @@ void FramePlayer::OnTimer(wxTimerEvent& /*evt*/)
             // Playback (repeat) control
             const int ivalue = _app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatMode)->GetValueAsInt();
             const RepeatMode repeatMode = static_cast<RepeatMode>(ivalue);
-            if (repeatMode != RepeatMode::InfiniteDuration)
+            if (repeatMode != RepeatMode::InfiniteDuration && !playbackInfo.HasSwitchedToArmedTune()) // Reminder: the armed tune takes over by itself, it just isn't audible yet.
             {
                 const int trimMs = _app.currentSettings->GetOption(Settings::AppSettings::ID::SonglengthsTrim)->GetValueAsInt();
                 if (playbackTimeMs >= _ui->compositeSeekbar->GetDurationValue() + trimMs)
@@ -527,6 +535,7 @@ void FramePlayer::OnButtonPlayPause()
                 const bool preRenderEnabled = _app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool();
                 const int preRenderDurationMs = (preRenderEnabled && node != nullptr) ? GetEffectiveSongDuration(*node) : 0;
                 _app.ReplayLoadedTune(preRenderDurationMs);
+                ArmGaplessNext();
             }
         }
     }
@@ -701,6 +710,7 @@ void FramePlayer::OnSongDurationReached()
             {
                 const int preRenderDurationMs = (_app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool()) ? GetEffectiveSongDuration(*node) : 0;
                 _app.ReplayLoadedTune(preRenderDurationMs, true);
+                ArmGaplessNext();
             }
 
             break;
@@ -713,6 +723,28 @@ void FramePlayer::OnSongDurationReached()
     UpdateUiState();
 }
 
+void FramePlayer::OnGaplessTransition()
+{
+    // The playback has already moved on by itself, just catch up with it.
+    const PlaybackController& playbackInfo = _app.GetPlaybackInfo();
+    PlaylistTreeModelNode* node = _ui->treePlaylist->GetSong(playbackInfo.GetCurrentTuneFilePath());
+    if (node != nullptr && node->GetSubsongCount() > 0)
+    {
+        node = &node->GetSubsong(playbackInfo.GetCurrentSubsong());
+    }
+
+    const bool highlightable = node != nullptr && _ui->treePlaylist->TrySetActiveSong(*node, _app.currentSettings->GetOption(Settings::AppSettings::ID::AutoExpandSubsongs)->GetValueAsBool());
+    UpdateUiState();
+
+    if (highlightable && _app.currentSettings->GetOption(Settings::AppSettings::ID::SelectionFollowsPlayback)->GetValueAsBool())
+    {
+        _ui->treePlaylist->Select(*node);
+        _ui->treePlaylist->EnsureVisible(*node);
+    }
+
+    ArmGaplessNext();
+}
+
 void FramePlayer::OnSeekingCeased()
 {
     const PlaybackController::State state = _app.GetPlaybackInfo().GetState();
@@ -733,6 +765,7 @@ void FramePlayer::OnRepeatModeExtraOptionToggled(ExtraOptionId extraOptionId)
             Settings::Option* option = _app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatModeDefaultSubsong);
             option->UpdateValue(!option->GetValueAsBool());
             _ui->btnRepeatMode->SetExtraOptionEnabled(ExtraOptionId::DefaultSubsong, option->GetValueAsBool());
+            ArmGaplessNext();
             break;
         }
         case ExtraOptionId::IncludeSubsongs:
@@ -740,6 +773,7 @@ void FramePlayer::OnRepeatModeExtraOptionToggled(ExtraOptionId extraOptionId)
             Settings::Option* option = _app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatModeIncludeSubsongs);
             option->UpdateValue(!option->GetValueAsBool());
             _ui->btnRepeatMode->SetExtraOptionEnabled(ExtraOptionId::IncludeSubsongs, option->GetValueAsBool());
+            ArmGaplessNext();
             break;
         }
         case ExtraOptionId::PreRenderEnabled:
@@ -847,6 +881,7 @@ void FramePlayer::DoRemoveSongTreeItem(PlaylistTreeModelNode& node)
 
     _ui->treePlaylist->Remove(node);
     PadColumnsWidth();
+    ArmGaplessNext(); // Next (sub)song may have changed.
     UpdateUiState(); // To refresh the Next/Prev buttons.
 }
 
@@ -884,6 +919,7 @@ void FramePlayer::DoRemoveAllSongTreeItemsAbove(PlaylistTreeModelNode& node)
     _ui->treePlaylist->EnsureVisible(node);
 
     PadColumnsWidth();
+    ArmGaplessNext(); // Next (sub)song may have changed.
     UpdateUiState(); // To refresh the Next/Prev buttons.
 }
 
@@ -924,6 +960,7 @@ void FramePlayer::DoRemoveAllSongTreeItemsBelow(PlaylistTreeModelNode& node)
     _ui->treePlaylist->EnsureVisible(node);
 
     PadColumnsWidth();
+    ArmGaplessNext(); // Next (sub)song may have changed.
     UpdateUiState(); // To refresh the Next/Prev buttons.
 }
 
@@ -940,6 +977,7 @@ void FramePlayer::DoToggleSubsongBlacklistState(PlaylistTreeModelNode& node)
             break;
     }
 
+    ArmGaplessNext(); // Next (sub)song may have changed.
     UpdateUiState(); // To refresh the Next/Prev buttons.
 }
 
@@ -30,6 +30,7 @@
 using RepeatMode = UIElements::RepeatModeButton::RepeatMode;
 static constexpr size_t VISUALIZATION_WAVE_WINDOW_MS = 100;
 static wxString bundledSonglengthsPath("bundled-Songlengths.md5");
+static wxString tuneInfoCachePath("tuneinfo.cache");
 
 FramePlayer::FramePlayer(const wxString& title, const wxPoint& pos, const wxSize& size, MyApp& app)
     : wxFrame(NULL, wxID_ANY, title, pos, size),
@@ -38,6 +39,7 @@ FramePlayer::FramePlayer(const wxString& title, const wxPoint& pos, const wxSize
     SetIcon(wxICON(appicon)); // Comes from .rc
 
     InitSonglengthsDatabase();
+    _tuneInfoCache.TryLoad(tuneInfoCachePath.ToStdWstring(), _silentSidInfoDecoder.GetSidDatabaseStamp()); // Durations depend on the database.
 
     _themeManager.LoadTheme("default");
     SetupUiElements();
@@ -293,7 +295,10 @@ void FramePlayer::CloseApplication()
         _app.currentSettings->GetOption(Settings::AppSettings::ID::LastSubsongIndex)->UpdateValue(cSongIndex);
     }
 
+    _durationEstimator = nullptr; // Stop the background analysis while the file system is still around.
     _app.currentSettings->TrySave();
+    _app.SaveLatencyProfiles();
+    _tuneInfoCache.TrySave(tuneInfoCachePath.ToStdWstring());
 
 #if defined(_WIN32) && defined(wxUSE_DDE_FOR_IPC)
     new wxLogNull; // Suppress popup-errors (irrelevant DDE DMLERR_INVALIDPARAMETER edge-case message which I think might be a wx library defect and I can't do anything about it).
@@ -453,7 +458,7 @@ void FramePlayer::DisplayAboutBox()
     aboutInfo.SetLicense(Strings::About::LICENSE);
 
     aboutInfo.AddDeveloper(wxString(Strings::About::DEVELOPER_LIBRARIES) + "\n" +
-                           wxString::Format("%s %s", _silentSidInfoDecoder.GetEngineInfo().name(), _silentSidInfoDecoder.GetEngineInfo().version()) + "\n" + // libsidplayfp
+                           wxString::Format("%s %s", _silentSidInfoDecoder.GetEngineInfo().name.c_str(), _silentSidInfoDecoder.GetEngineInfo().version.c_str()) + "\n" + // libsidplayfp
                            wxString(Pa_GetVersionInfo()->versionText) + "\n" + // PortAudio
                            wxVERSION_STRING // wxWidgets
                           );
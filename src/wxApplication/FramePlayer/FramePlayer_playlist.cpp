@@ -23,7 +23,15 @@
 #include "../Config/UIStrings.h"
 #include "../Helpers/HelpersWx.h"
 #include "../UIElements/Playlist/Components/PlaylistModel.h"
+#include "../../PlaybackController/TuneInfoScanner.h"
 #include "../../Util/Const.h"
+#include <chrono>
+
+namespace
+{
+    constexpr size_t SCAN_BATCH_MAX = 500; // Max tunes added to the playlist between UI updates.
+    constexpr int SCAN_BATCH_WAIT_MS = 50;
+}
 
 std::vector<wxString> FramePlayer::GetCurrentPlaylistFilePaths(bool includeBlacklistedSongs)
 {
@@ -89,6 +97,11 @@ void FramePlayer::SendFilesToPlaylist(const wxArrayString& files, bool clearPrev
         _app.StopPlayback();
         _app.UnloadActiveTune();
 
+        if (_durationEstimator != nullptr)
+        {
+            _durationEstimator->ClearQueue();
+        }
+
         SetStatusText(Strings::FramePlayer::STATUS_CLEARING_PLAYLIST, 2); // TODO
         _ui->treePlaylist->Clear();
 
@@ -101,62 +114,68 @@ void FramePlayer::SendFilesToPlaylist(const wxArrayString& files, bool clearPrev
 
     int processedFilesCount = 0;
     int lastPercentage = -1;
-    bool tuneIsValid = false;
 
     int playableTunesCount = 0; // Not important if it rolls over.
     const PlaybackController& playback = _app.GetPlaybackInfo();
 
-    for (const wxString& filepath : files)
+    // Inspect tunes in parallel in the info-only decoders
+    TuneInfoScanner scanner;
+    scanner.Start(files.GetCount(), [&files](size_t index) -> std::unique_ptr<BufferHolder>
+    {
+        const wxString& filepath = files[index];
+        return (Helpers::Wx::Files::IsWithinZipFile(filepath)) ? Helpers::Wx::Files::GetFileContentFromZip(filepath) : Helpers::Wx::Files::MapFileContentFromDisk(filepath); // Reminder: released as soon as scanned.
+    }, _silentSidInfoDecoder, &_tuneInfoCache, [&files](size_t index) -> std::pair<std::wstring, std::wstring>
     {
-        ++processedFilesCount;
+        // Unchanged files are taken from the cache without loading them at all (a file within Zip is validated against its archive)
+        const wxString& filepath = files[index];
+        const wxString& diskFilepath = (Helpers::Wx::Files::IsWithinZipFile(filepath)) ? Helpers::Wx::Files::SplitZipArchiveAndFileNames(filepath).first : filepath;
+        return {filepath.ToStdWstring(), diskFilepath.ToStdWstring()};
+    });
 
-        const int totalFiles = files.GetCount() + _enqueuedFiles.GetCount();
-        const float totalFilesFloat = static_cast<float>(totalFiles);
+    std::vector<TuneInfoScanner::TuneInfo> batch;
+    batch.reserve(SCAN_BATCH_MAX);
 
-        // Progress percentage display ------------------------
-        const int currentPercentage = static_cast<int>((processedFilesCount / totalFilesFloat) * 100.0f);
-        if (currentPercentage != lastPercentage) // SetStatusText calls are expensive.
-        {
-            const wxString textAddingFilesWithCount = wxString::Format(Strings::FramePlayer::STATUS_ADDING_FILES_WITH_COUNT, totalFiles);
-            SetStatusText(wxString::Format("%s (%i%%)", textAddingFilesWithCount, currentPercentage), 2);
-        }
-        lastPercentage = currentPercentage;
+    std::vector<PlaylistTreeModelNode*> addedSongNodes;
+    addedSongNodes.reserve(SCAN_BATCH_MAX);
 
-        // Inspect tune in a separate info-only decoder -------
-        if (Helpers::Wx::Files::IsWithinZipFile(filepath))
-        {
-            const std::unique_ptr<BufferHolder>& infoTuneBufferHolder = Helpers::Wx::Files::GetFileContentFromZip(filepath);
-            tuneIsValid = infoTuneBufferHolder != nullptr && _silentSidInfoDecoder.TryLoadSong(infoTuneBufferHolder->buffer, infoTuneBufferHolder->size);
-        }
-        else
-        {
-            //tuneIsValid =_silentSidInfoDecoder.TryLoadSong(filepath); // Would be much faster but no unicode paths support then.
-            const std::unique_ptr<BufferHolder>& infoTuneBufferHolder = Helpers::Wx::Files::GetFileContentFromDisk(filepath);
-            tuneIsValid = infoTuneBufferHolder != nullptr && _silentSidInfoDecoder.TryLoadSong(infoTuneBufferHolder->buffer, infoTuneBufferHolder->size, 0);
-        }
+    while (!scanner.IsDone())
+    {
+        batch.clear();
+        addedSongNodes.clear();
+        scanner.TakeReady(batch, SCAN_BATCH_MAX, std::chrono::milliseconds(SCAN_BATCH_WAIT_MS));
+
+        _ui->treePlaylist->Freeze();
 
-        if (tuneIsValid)
+        for (const TuneInfoScanner::TuneInfo& info : batch)
         {
+            const wxString& filepath = files[processedFilesCount];
+            ++processedFilesCount;
+
+            if (!info.valid)
+            {
+                continue;
+            }
+
             // Tune title
-            const int sidsNeeded = _silentSidInfoDecoder.GetCurrentTuneSidChipsRequired();
+            const int sidsNeeded = info.sidChipsRequired;
             const wxString songTitleAddendum = (sidsNeeded > 1) ? wxString::Format(" [%iSID]", sidsNeeded) : "";
-            const wxString songTitle = _silentSidInfoDecoder.GetCurrentTuneInfoString(SidDecoder::SongInfoCategory::Title) + songTitleAddendum;
+            const wxString songTitle = info.title + songTitleAddendum;
 
             // Subsongs count
-            const int defaultSubsong = _silentSidInfoDecoder.GetDefaultSubsong();
-            const int totalSubsongs = _silentSidInfoDecoder.GetTotalSubsongs();
+            const int defaultSubsong = info.defaultSubsong;
+            const int totalSubsongs = info.totalSubsongs;
 
             // Tune ROM requirement
-            const SidDecoder::RomRequirement romRequirement = _silentSidInfoDecoder.GetCurrentSongRomRequirement();
+            const SidDecoder::RomRequirement romRequirement = info.romRequirement;
             const bool playable = playback.IsRomLoaded(romRequirement);
 
             // Add main song node to playlist tree
             PlaylistTreeModelNode* mainSongNodeNew = nullptr;
 
             {
-                const uint_least32_t realDuration = _silentSidInfoDecoder.TryGetActiveSongDuration();
-                const wxString author = _silentSidInfoDecoder.GetCurrentTuneInfoString(PlaybackController::SongInfoCategory::Author); // Don't use reference.
-                const wxString copyright = _silentSidInfoDecoder.GetCurrentTuneInfoString(PlaybackController::SongInfoCategory::Released); // Don't use reference.
+                const uint_least32_t realDuration = info.duration;
+                const wxString author = info.author; // Don't use reference.
+                const wxString copyright = info.released; // Don't use reference.
 
                 // Determine ROM requirement
                 PlaylistTreeModelNode::RomRequirement nodeRom = PlaylistTreeModelNode::RomRequirement::None;
@@ -184,24 +203,12 @@ void FramePlayer::SendFilesToPlaylist(const wxArrayString& files, bool clearPrev
                 ++playableTunesCount;
             }
 
+            addedSongNodes.push_back(mainSongNodeNew);
+
             // Add any subsongs to playlist tree
             if (totalSubsongs > 1)
             {
-                std::vector<uint_least32_t> subsongDurations;
-                subsongDurations.reserve(totalSubsongs);
-
-                // Determine durations
-                for (int i = 1; i <= totalSubsongs; ++i)
-                {
-                    if (_silentSidInfoDecoder.TrySetSubsong(i))
-                    {
-                        const uint_least32_t realDuration = _silentSidInfoDecoder.TryGetActiveSongDuration();
-                        subsongDurations.emplace_back(realDuration);
-                    }
-                }
-
-                // Add subsongs
-                _ui->treePlaylist->AddSubsongs(subsongDurations, *mainSongNodeNew);
+                _ui->treePlaylist->AddSubsongs(info.subsongDurations, *mainSongNodeNew);
             }
 
             // One tune (with any subsongs) added -----------------
@@ -224,12 +231,26 @@ void FramePlayer::SendFilesToPlaylist(const wxArrayString& files, bool clearPrev
                     shouldAutoPlay = subsongItemData->GetTag() != PlaylistTreeModelNode::ItemTag::Normal || !TryPlayPlaylistItem(*mainSongNodeNew);
                 }
             }
+
+            if (playableTunesCount == 2)
+            {
+                UpdateUiState(); // Simply to enable the "next song" button immediately while still adding lots of files.
+            }
         }
 
-        if (playableTunesCount == 2)
+        _ui->treePlaylist->Thaw();
+
+        EstimateUnknownDurations(addedSongNodes);
+
+        // Progress percentage display (once per batch) -------
+        const int totalFiles = files.GetCount() + _enqueuedFiles.GetCount();
+        const int currentPercentage = static_cast<int>((processedFilesCount / static_cast<float>(totalFiles)) * 100.0f);
+        if (currentPercentage != lastPercentage) // SetStatusText calls are expensive.
         {
-            UpdateUiState(); // Simply to enable the "next song" button immediately while still adding lots of files.
+            const wxString textAddingFilesWithCount = wxString::Format(Strings::FramePlayer::STATUS_ADDING_FILES_WITH_COUNT, totalFiles);
+            SetStatusText(wxString::Format("%s (%i%%)", textAddingFilesWithCount, currentPercentage), 2);
         }
+        lastPercentage = currentPercentage;
 
         wxYield(); // Also must be before the HasFocus() call because not even that updates otherwise!
         if (_exitingApplication) // In case the user clicked Close while adding lots of files. This should be checked immediately after any wxYield.
@@ -289,14 +310,13 @@ void FramePlayer::UpdateIgnoredSongs()
 void FramePlayer::UpdateIgnoredSong(PlaylistTreeModelNode& mainSongNode)
 {
     const uint_least32_t skipDurationThreshold = static_cast<uint_least32_t>(_app.currentSettings->GetOption(Settings::AppSettings::ID::SkipShorter)->GetValueAsInt() * Const::MILLISECONDS_IN_SECOND);
-    const uint_least32_t fallbackDuration = static_cast<uint_least32_t>(_app.currentSettings->GetOption(Settings::AppSettings::ID::SongFallbackDuration)->GetValueAsInt() * Const::MILLISECONDS_IN_SECOND);
 
     const PlaylistTreeModelNodePtrArray& subNodes = mainSongNode.GetChildren();
 
     // Subsongs
     for (const PlaylistTreeModelNodePtr& subsongNode : subNodes)
     {
-        const uint_least32_t relevantSubsongDuration = (subsongNode->duration == 0) ? fallbackDuration : subsongNode->duration;
+        const uint_least32_t relevantSubsongDuration = static_cast<uint_least32_t>(GetEffectiveSongDuration(*subsongNode.get()));
         const bool durationIsShort = skipDurationThreshold > 0 && (relevantSubsongDuration < skipDurationThreshold);
 
         const PlaylistTreeModelNode::ItemTag tag = (durationIsShort) ? PlaylistTreeModelNode::ItemTag::ShortDuration : PlaylistTreeModelNode::ItemTag::Normal;
@@ -309,7 +329,7 @@ void FramePlayer::UpdateIgnoredSong(PlaylistTreeModelNode& mainSongNode)
 
         if (mainSongNode.GetSubsongCount() == 0)
         {
-            const uint_least32_t relevantSingleSongDuration = (mainSongNode.duration == 0) ? fallbackDuration : mainSongNode.duration;
+            const uint_least32_t relevantSingleSongDuration = static_cast<uint_least32_t>(GetEffectiveSongDuration(mainSongNode));
             mainSongDurationIsShort = skipDurationThreshold > 0 && (relevantSingleSongDuration < skipDurationThreshold);
         }
         else
@@ -330,6 +350,11 @@ void FramePlayer::UpdateIgnoredSong(PlaylistTreeModelNode& mainSongNode)
 long FramePlayer::GetEffectiveSongDuration(const PlaylistTreeModelNode& node) const
 {
     long effectiveDuration = static_cast<long>(node.duration);
+    if (effectiveDuration == 0)
+    {
+        effectiveDuration = static_cast<long>(node.GetEstimatedDuration());
+    }
+
     if (effectiveDuration == 0)
     {
         effectiveDuration = _app.currentSettings->GetOption(Settings::AppSettings::ID::SongFallbackDuration)->GetValueAsInt() * Const::MILLISECONDS_IN_SECOND;
@@ -337,3 +362,106 @@ long FramePlayer::GetEffectiveSongDuration(const PlaylistTreeModelNode& node) co
 
     return effectiveDuration;
 }
+
+void FramePlayer::EstimateUnknownDurations(PassKey<FramePrefs>)
+{
+    if (!_app.currentSettings->GetOption(Settings::AppSettings::ID::EstimateDurations)->GetValueAsBool())
+    {
+        _durationEstimator = nullptr;
+        return;
+    }
+
+    std::vector<PlaylistTreeModelNode*> songNodes;
+    for (const PlaylistTreeModelNodePtr& songNode : _ui->treePlaylist->GetSongs())
+    {
+        songNodes.push_back(songNode.get());
+    }
+
+    EstimateUnknownDurations(songNodes);
+}
+
+void FramePlayer::EstimateUnknownDurations(const std::vector<PlaylistTreeModelNode*>& mainSongNodes)
+{
+    if (!_app.currentSettings->GetOption(Settings::AppSettings::ID::EstimateDurations)->GetValueAsBool())
+    {
+        return;
+    }
+
+    std::vector<DurationEstimator::Job> jobs;
+    const auto addIfUnknown = [&jobs](const PlaylistTreeModelNode& node)
+    {
+        if (node.duration == 0 && node.GetEstimatedDuration() == 0)
+        {
+            jobs.push_back({node.filepath.ToStdWstring(), static_cast<unsigned int>(node.defaultSubsong)});
+        }
+    };
+
+    for (PlaylistTreeModelNode* const mainSongNode : mainSongNodes)
+    {
+        if (!mainSongNode->IsPlayable())
+        {
+            continue;
+        }
+
+        if (mainSongNode->GetSubsongCount() == 0)
+        {
+            addIfUnknown(*mainSongNode);
+        }
+
+        for (const PlaylistTreeModelNodePtr& subsongNode : mainSongNode->GetChildren())
+        {
+            addIfUnknown(*subsongNode.get());
+        }
+    }
+
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    if (_durationEstimator == nullptr)
+    {
+        _durationEstimator = _app.CreateDurationEstimator();
+    }
+
+    _durationEstimator->Enqueue(jobs);
+}
+
+void FramePlayer::ApplyEstimatedDurations()
+{
+    std::vector<DurationEstimator::Estimate> estimates;
+    if (_durationEstimator == nullptr || _durationEstimator->TakeFinished(estimates) == 0)
+    {
+        return;
+    }
+
+    const bool enabledShortSongSkip = _app.currentSettings->GetOption(Settings::AppSettings::ID::SkipShorter)->GetValueAsInt() > 0;
+    const PlaylistTreeModelNode* const activeNode = _ui->treePlaylist->GetActiveSong();
+    bool activeSongAffected = false;
+
+    for (const DurationEstimator::Estimate& estimate : estimates)
+    {
+        PlaylistTreeModelNode* const mainSongNode = (estimate.durationMs == 0) ? nullptr : _ui->treePlaylist->GetSong(estimate.job.filepath);
+        if (mainSongNode == nullptr) // Nothing detected, or removed from the playlist meanwhile.
+        {
+            continue;
+        }
+
+        PlaylistTreeModelNode& node = (mainSongNode->GetSubsongCount() == 0) ? *mainSongNode : mainSongNode->GetSubsong(static_cast<int>(estimate.job.subsong));
+        _ui->treePlaylist->SetEstimatedDuration(node, estimate.durationMs);
+        activeSongAffected = activeSongAffected || &node == activeNode;
+
+        if (enabledShortSongSkip && mainSongNode->IsPlayable())
+        {
+            UpdateIgnoredSong(*mainSongNode);
+        }
+    }
+
+    // Reminder: the pre-rendered playback can't be extended, so it keeps whatever duration it was started with.
+    const bool preRenderEnabled = _app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool();
+    if (activeSongAffected && !preRenderEnabled && _app.GetPlaybackInfo().GetState() != PlaybackController::State::Stopped)
+    {
+        _ui->compositeSeekbar->SetDuration(GetEffectiveSongDuration(*activeNode));
+        ArmGaplessNext(); // Switch point has changed.
+    }
+}
@@ -19,6 +19,12 @@
 #include "FramePlayer.h"
 #include "../MyApp.h"
 #include "../Config/AppSettings.h"
+#include <algorithm>
+
+namespace
+{
+    using RepeatMode = UIElements::RepeatModeButton::RepeatMode;
+}
 
 bool FramePlayer::TryPlayPlaylistItem(const PlaylistTreeModelNode& node)
 {
@@ -27,24 +33,18 @@ bool FramePlayer::TryPlayPlaylistItem(const PlaylistTreeModelNode& node)
         return false;
     }
 
-    int subsong = node.defaultSubsong;
-
     // If the selected node is a mainsong, determine the initial subsong to play.
-    if (node.type == PlaylistTreeModelNode::ItemType::Song && node.GetSubsongCount() > 0)
+    const PlaylistTreeModelNode* const playbackNode = GetEffectivePlaybackNode(node);
+    if (playbackNode == nullptr) // All subsongs tagged for navigation auto-skip. Just expand the node but don't start any playback.
     {
-        if (const PlaylistTreeModelNode* const subNode = _ui->treePlaylist->GetEffectiveInitialSubsong(node))
-        {
-            subsong = subNode->defaultSubsong;
-        }
-        else // All subsongs tagged for navigation auto-skip. Just expand the node but don't start any playback.
-        {
-            _ui->treePlaylist->ExpandSongNode(node);
-            return false;
-        }
+        _ui->treePlaylist->ExpandSongNode(node);
+        return false;
     }
 
+    const int subsong = playbackNode->defaultSubsong;
+
     // Trigger playback
-    const int preRenderDurationMs = (_app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool()) ? GetEffectiveSongDuration(node) : 0;
+    const int preRenderDurationMs = (_app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool()) ? GetEffectiveSongDuration(*playbackNode) : 0;
     const bool sameTune = _app.GetPlaybackInfo().GetCurrentTuneFilePath() == node.filepath.ToStdWstring();
     if (sameTune)
     {
@@ -61,6 +61,15 @@ bool FramePlayer::TryPlayPlaylistItem(const PlaylistTreeModelNode& node)
     const bool highlightable = fileLoadedSuccessfully && _ui->treePlaylist->TrySetActiveSong(actualNode, _app.currentSettings->GetOption(Settings::AppSettings::ID::AutoExpandSubsongs)->GetValueAsBool());
     UpdateUiState();
 
+    if (fileLoadedSuccessfully && preRenderDurationMs > 0)
+    {
+        PreRenderUpcomingSongs(actualNode);
+    }
+    else
+    {
+        ArmGaplessNext();
+    }
+
     if (highlightable && _app.currentSettings->GetOption(Settings::AppSettings::ID::SelectionFollowsPlayback)->GetValueAsBool())
     {
         _ui->treePlaylist->Select(actualNode);
@@ -113,3 +122,109 @@ bool FramePlayer::TryPlayPrevValidSubsong()
 
     return false;
 }
+
+const PlaylistTreeModelNode* FramePlayer::GetEffectivePlaybackNode(const PlaylistTreeModelNode& node) const
+{
+    if (node.type == PlaylistTreeModelNode::ItemType::Song && node.GetSubsongCount() > 0)
+    {
+        return _ui->treePlaylist->GetEffectiveInitialSubsong(node);
+    }
+
+    return &node;
+}
+
+void FramePlayer::PreRenderUpcomingSongs(const PlaylistTreeModelNode& fromNode)
+{
+    const int lookahead = _app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderLookahead)->GetValueAsInt();
+    const bool includeSubsongs = _app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatModeIncludeSubsongs)->GetValueAsBool();
+
+    // Follow the same order as the normal repeat mode would.
+    std::vector<MyApp::UpcomingSubsong> upcoming;
+    const PlaylistTreeModelNode* node = &fromNode;
+    while (static_cast<int>(upcoming.size()) < lookahead)
+    {
+        const PlaylistTreeModelNode* nextNode = (includeSubsongs) ? _ui->treePlaylist->GetNextSubsong(*node) : nullptr;
+        if (nextNode == nullptr)
+        {
+            nextNode = _ui->treePlaylist->GetNextSong(*node);
+        }
+
+        if (nextNode == nullptr)
+        {
+            break;
+        }
+
+        // Keyed the same way as the TryPlayPlaylistItem will request it, otherwise it's never taken.
+        if (const PlaylistTreeModelNode* const playbackNode = GetEffectivePlaybackNode(*nextNode))
+        {
+            upcoming.push_back({playbackNode->filepath, static_cast<unsigned int>(playbackNode->defaultSubsong), static_cast<int>(GetEffectiveSongDuration(*playbackNode))});
+        }
+
+        node = nextNode;
+    }
+
+    _app.PreRenderUpcoming(upcoming);
+}
+
+void FramePlayer::ArmGaplessNext(PassKey<FramePrefs>)
+{
+    ArmGaplessNext();
+}
+
+void FramePlayer::ArmGaplessNext()
+{
+    const bool gaplessEnabled = _app.currentSettings->GetOption(Settings::AppSettings::ID::GaplessPlayback)->GetValueAsBool();
+    const bool preRenderEnabled = _app.currentSettings->GetOption(Settings::AppSettings::ID::PreRenderEnabled)->GetValueAsBool();
+    const PlaybackController::State state = _app.GetPlaybackInfo().GetState();
+    const PlaylistTreeModelNode* const activeNode = _ui->treePlaylist->GetActiveSong();
+    if (!gaplessEnabled || preRenderEnabled || activeNode == nullptr || state == PlaybackController::State::Stopped || state == PlaybackController::State::Undefined)
+    {
+        _app.DisarmNext();
+        return;
+    }
+
+    // Follow the same order as the OnSongDurationReached would.
+    const RepeatMode repeatMode = static_cast<RepeatMode>(_app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatMode)->GetValueAsInt());
+    const bool includeSubsongs = _app.currentSettings->GetOption(Settings::AppSettings::ID::RepeatModeIncludeSubsongs)->GetValueAsBool();
+    const bool singleTune = _ui->treePlaylist->GetSongs().size() == 1 && _ui->treePlaylist->GetSongs().front()->GetSubsongCount() == 0;
+
+    const PlaylistTreeModelNode* nextNode = nullptr;
+    if (repeatMode == RepeatMode::RepeatOne || (repeatMode == RepeatMode::RepeatAll && singleTune))
+    {
+        nextNode = activeNode;
+    }
+    else if (repeatMode == RepeatMode::Normal || repeatMode == RepeatMode::RepeatAll)
+    {
+        nextNode = (includeSubsongs) ? _ui->treePlaylist->GetNextSubsong() : nullptr;
+        if (nextNode == nullptr)
+        {
+            nextNode = _ui->treePlaylist->GetNextSong();
+        }
+
+        if (nextNode == nullptr && repeatMode == RepeatMode::RepeatAll)
+        {
+            const PlaylistTreeModelNode& firstTuneNode = *_ui->treePlaylist->GetSongs().front();
+            if (firstTuneNode.GetTag() == PlaylistTreeModelNode::ItemTag::Normal && firstTuneNode.IsPlayable())
+            {
+                nextNode = &firstTuneNode;
+            }
+        }
+    }
+
+    // Determine the subsong the same way as the TryPlayPlaylistItem would.
+    if (nextNode != nullptr)
+    {
+        nextNode = GetEffectivePlaybackNode(*nextNode);
+    }
+
+    const long durationMs = GetEffectiveSongDuration(*activeNode);
+    if (nextNode == nullptr || durationMs <= 0)
+    {
+        _app.DisarmNext();
+        return;
+    }
+
+    const int trimMs = _app.currentSettings->GetOption(Settings::AppSettings::ID::SonglengthsTrim)->GetValueAsInt();
+    const uint_least32_t switchAtMs = static_cast<uint_least32_t>(std::max(0L, durationMs + trimMs));
+    _app.ArmNext(nextNode->filepath, nextNode->defaultSubsong, switchAtMs);
+}
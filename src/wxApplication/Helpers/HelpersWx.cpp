@@ -22,47 +22,180 @@
 #include <wx/stdpaths.h>
 #include <wx/textfile.h>
 #include <portaudio.h>
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace
 {
-	inline wxArrayString GetFilesInZip(const wxString& path)
+	std::mutex fileSystemMutex; // The wxFileSystem is not thread-safe.
+
+	/// @brief Zip archive's central directory parsed only once, so the entries can be read directly from their offsets. The archive itself is only open while reading an entry (so it can be moved or replaced meanwhile).
+	class ZipArchiveCatalog
 	{
-		wxArrayString flatfileList;
+	public:
+		static constexpr size_t MAX_CACHED_CATALOGS = 4;
 
-		wxFileSystem fs;
-		fs.ChangePathTo(path); // Prevent OpenFile from trying relative scope first (always in vain). This yields huuuge speed boost.
-		wxString filenameOnly = path;
-		filenameOnly.Replace("\\", "/");
-		if (!fs.GetPath().IsEmpty())
-		{
-			filenameOnly.Replace(fs.GetPath(), "");
-		}
+		using Stamp = std::pair<uintmax_t, std::filesystem::file_time_type>;
 
-		wxFSFile* fsFile = fs.OpenFile(filenameOnly, wxFS_READ);
-		if (fsFile != NULL)
+	public:
+		ZipArchiveCatalog(const wxString& archivePath, const Stamp& stamp) :
+			_archivePath(archivePath),
+			_stamp(stamp)
 		{
-			wxZipInputStream in(fsFile->GetStream());
+			wxFFileInputStream file(archivePath);
+			if (!file.IsOk())
+			{
+				return;
+			}
 
-			if (in.GetTotalEntries() > 0)
+			// Reminder: with a seekable stream the entries come from the central directory (without reading the local entries in between).
+			wxZipInputStream zip(file);
+			for (wxZipEntry* entry = zip.GetNextEntry(); entry != nullptr; entry = zip.GetNextEntry())
 			{
-				wxZipEntry* entry = in.GetNextEntry();
-				while (entry != nullptr)
+				if (!entry->IsDir())
+				{
+					_index[entry->GetInternalName().ToStdWstring()] = _entries.size();
+					_entries.emplace_back(entry);
+				}
+				else
 				{
-					if (!entry->IsDir())
-					{
-						flatfileList.push_back(wxString::Format("%s/%s", path, entry->GetName()));
-					}
-
 					delete entry;
-					entry = in.GetNextEntry();
 				}
+			}
+		}
+
+		static Stamp ReadStamp(const wxString& archivePath)
+		{
+			std::error_code ec;
+			const std::filesystem::path path(archivePath.ToStdWstring());
+			return {std::filesystem::file_size(path, ec), std::filesystem::last_write_time(path, ec)};
+		}
+
+		bool IsValid() const
+		{
+			return !_entries.empty();
+		}
+
+		const Stamp& GetStamp() const
+		{
+			return _stamp;
+		}
+
+		const wxString& GetArchivePath() const
+		{
+			return _archivePath;
+		}
+
+		/// @brief In the archive's order.
+		const std::vector<std::unique_ptr<wxZipEntry>>& GetEntries() const
+		{
+			return _entries;
+		}
+
+		/// @brief Copy of the entry which shares nothing with the cached one, so it can be read without holding the zipArchiveCatalogsMutex (unlike this call itself).
+		std::unique_ptr<wxZipEntry> CopyEntry(const wxString& entryName) const
+		{
+			const auto it = _index.find(wxZipEntry::GetInternalName(entryName).ToStdWstring());
+			if (it == _index.end() || _entries[it->second]->GetSize() <= 0)
+			{
+				return nullptr;
+			}
+
+			// Reminder: the copies share the extra fields (not thread-safe reference counting), so the copy gets its own.
+			const wxZipEntry& cached = *_entries[it->second];
+			std::unique_ptr<wxZipEntry> copy = std::make_unique<wxZipEntry>(cached);
+			copy->SetExtra(cached.GetExtra(), cached.GetExtraLen());
+			copy->SetLocalExtra(cached.GetLocalExtra(), cached.GetLocalExtraLen());
+			return copy;
+		}
+
+		static std::unique_ptr<BufferHolder> ReadEntry(const wxString& archivePath, wxZipEntry& entry)
+		{
+			// Reminder: an entry of the same archive can be opened in a new stream (seeking straight to its offset).
+			wxFFileInputStream file(archivePath);
+			wxZipInputStream zip(file);
+			if (!file.IsOk() || !zip.OpenEntry(entry))
+			{
+				return nullptr;
+			}
+
+			std::unique_ptr<BufferHolder> bufferHolder = std::make_unique<BufferHolder>(entry.GetSize());
+			if (!zip.ReadAll(bufferHolder->buffer, bufferHolder->size))
+			{
+				bufferHolder = nullptr;
+			}
+
+			zip.CloseEntry();
+			return bufferHolder;
+		}
+
+	private:
+		const wxString _archivePath;
+		const Stamp _stamp;
+		std::vector<std::unique_ptr<wxZipEntry>> _entries;
+		std::unordered_map<std::wstring, size_t> _index; // Into the _entries, by internal name.
+	};
+
+	std::mutex zipArchiveCatalogsMutex; // Reminder: only held for the lookups, not while reading the archives.
+	std::list<std::unique_ptr<ZipArchiveCatalog>> zipArchiveCatalogs; // Most recently used first.
+
+	/// @brief Calls the func with the up-to-date catalog of the archive (nullptr if it can't be read) while holding the zipArchiveCatalogsMutex. The archive is only stat-ed and parsed without holding it.
+	template <typename Func>
+	auto WithZipArchiveCatalog(const wxString& archivePath, Func func)
+	{
+		const ZipArchiveCatalog::Stamp stamp = ZipArchiveCatalog::ReadStamp(archivePath);
+		const auto isSameArchive = [&archivePath](const std::unique_ptr<ZipArchiveCatalog>& catalog) { return catalog->GetArchivePath() == archivePath; };
 
-				in.CloseEntry();
+		{
+			std::lock_guard<std::mutex> lock(zipArchiveCatalogsMutex);
+			const auto it = std::find_if(zipArchiveCatalogs.begin(), zipArchiveCatalogs.end(), isSameArchive);
+			if (it != zipArchiveCatalogs.end() && (*it)->GetStamp() == stamp)
+			{
+				zipArchiveCatalogs.splice(zipArchiveCatalogs.begin(), zipArchiveCatalogs, it); // Mark as most recently used.
+				return func(zipArchiveCatalogs.front().get());
 			}
 		}
 
-		return flatfileList;
+		std::unique_ptr<ZipArchiveCatalog> catalog = std::make_unique<ZipArchiveCatalog>(archivePath, stamp);
+
+		std::lock_guard<std::mutex> lock(zipArchiveCatalogsMutex);
+		if (!catalog->IsValid())
+		{
+			return func(nullptr);
+		}
+
+		zipArchiveCatalogs.remove_if(isSameArchive); // Outdated (or parsed by another thread meanwhile).
+		zipArchiveCatalogs.emplace_front(std::move(catalog));
+		if (zipArchiveCatalogs.size() > ZipArchiveCatalog::MAX_CACHED_CATALOGS)
+		{
+			zipArchiveCatalogs.pop_back();
+		}
+
+		return func(zipArchiveCatalogs.front().get());
+	}
+
+	inline wxArrayString GetFilesInZip(const wxString& path)
+	{
+		// Reminder: this also caches the catalog for reading the files later on.
+		return WithZipArchiveCatalog(path, [&path](const ZipArchiveCatalog* catalog)
+		{
+			wxArrayString flatfileList;
+			if (catalog != nullptr)
+			{
+				flatfileList.reserve(catalog->GetEntries().size());
+				for (const std::unique_ptr<wxZipEntry>& entry : catalog->GetEntries())
+				{
+					flatfileList.push_back(wxString::Format("%s/%s", path, entry->GetName()));
+				}
+			}
+
+			return flatfileList;
+		});
 	}
 
 	inline wxKeyCode GetMediaKeyDown()
@@ -179,44 +312,29 @@ namespace Helpers
 			std::unique_ptr<BufferHolder> GetFileContentFromZip(const wxString& filename)
 			{
 				assert(IsWithinZipFile(filename));
-				std::unique_ptr<BufferHolder> bufferHolder;
 
 				const auto& archiveAndFile = SplitZipArchiveAndFileNames(filename);
-
-				wxFileSystem fs;
-				fs.ChangePathTo(archiveAndFile.first); // Prevent OpenFile from trying relative scope first (always in vain). This yields some speed boost.
-				wxString filenameOnly = archiveAndFile.first;
-				filenameOnly.Replace("\\", "/");
-				if (!fs.GetPath().IsEmpty())
+				std::unique_ptr<wxZipEntry> entry = WithZipArchiveCatalog(archiveAndFile.first, [&archiveAndFile](const ZipArchiveCatalog* catalog) -> std::unique_ptr<wxZipEntry>
 				{
-					filenameOnly.Replace(fs.GetPath(), "");
-				}
-
-				wxFSFile* zip = fs.OpenFile(wxString::Format("%s#zip:%s", filenameOnly, archiveAndFile.second), wxFS_READ);
-				if (zip != NULL)
-				{
-					wxInputStream* in = zip->GetStream();
-
-					const size_t zipStreamSize = in->GetSize();
-
-					if (zipStreamSize != 0)
-					{
-						bufferHolder = std::make_unique<BufferHolder>(zipStreamSize);
-						if (!in->ReadAll(bufferHolder->buffer, bufferHolder->size))
-						{
-							bufferHolder = nullptr;
-						}
-					}
+					return (catalog == nullptr) ? nullptr : catalog->CopyEntry(archiveAndFile.second);
+				});
 
-					delete zip;
-				}
-
-				return bufferHolder;
+				return (entry == nullptr) ? nullptr : ZipArchiveCatalog::ReadEntry(archiveAndFile.first, *entry);
 			}
 
 			std::unique_ptr<BufferHolder> GetFileContentFromDisk(const wxString& filename)
 			{
+				// Copy through a temporary mapping (the file is closed right away), fall back to reading it through the wxFileSystem
+				MappedFile mappedFile;
+				if (mappedFile.TryOpen(filename.ToStdWstring()))
+				{
+					std::unique_ptr<BufferHolder> bufferHolder = std::make_unique<BufferHolder>(mappedFile.GetSize());
+					memcpy(bufferHolder->buffer, mappedFile.GetData(), bufferHolder->size);
+					return bufferHolder;
+				}
+
 				std::unique_ptr<BufferHolder> bufferHolder;
+				std::lock_guard<std::mutex> lock(fileSystemMutex);
 
 				wxFileSystem fs;
 				fs.ChangePathTo(wxFileName(filename).GetPath()); // Prevent OpenFile from trying relative scope first (always in vain). This yields some speed boost.
@@ -242,6 +360,17 @@ namespace Helpers
 				return bufferHolder;
 			}
 
+			std::unique_ptr<BufferHolder> MapFileContentFromDisk(const wxString& filename)
+			{
+				std::unique_ptr<MappedFile> mappedFile = std::make_unique<MappedFile>();
+				if (mappedFile->TryOpen(filename.ToStdWstring()))
+				{
+					return std::make_unique<BufferHolder>(std::move(mappedFile));
+				}
+
+				return GetFileContentFromDisk(filename);
+			}
+
 			bool TrySavePlaylist(const wxString& fullpath, const std::vector<wxString>& fileList)
 			{
 				// If new file list is empty, just delete the old playlist file...
@@ -109,11 +109,16 @@ namespace Helpers
 			}
 
 			std::pair<wxString, wxString> SplitZipArchiveAndFileNames(const wxString& filename);
+
+			/// @brief Thread-safe (as are the GetFileContentFromDisk and MapFileContentFromDisk).
 			std::unique_ptr<BufferHolder> GetFileContentFromZip(const wxString& filename);
 
 			/// @brief Like GetFileContentFromZip but for regular files, supporting unicode paths (can't just naively load them directly via libsidplayfp's loader unfortunately due to lack of unicode paths support there).
 			std::unique_ptr<BufferHolder> GetFileContentFromDisk(const wxString& filename);
 
+			/// @brief Same as above but the content is normally a read-only memory mapping of the file (no allocation & copy). Only for short-lived uses (e.g., scanning) since the file stays open meanwhile.
+			std::unique_ptr<BufferHolder> MapFileContentFromDisk(const wxString& filename);
+
 			bool TrySavePlaylist(const wxString& fullpath, const std::vector<wxString>& fileList);
 			wxArrayString LoadPathsFromPlaylist(const wxString& fullpath);
 		}
@@ -22,12 +22,26 @@
 #include "Helpers/HelpersWx.h"
 #include "SingleInstanceManager/IpcSetup.h"
 #include "../Util/BufferHolder.h"
+#include "../Util/Const.h"
+#include "../PlaybackController/BatchExporter.h"
+#include "../PlaybackController/TuneInfoScanner.h"
 #include "../PlaybackController/Util/RomUtil.h"
+#include <wx/filename.h>
 #include <wx/stdpaths.h>
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+#endif
+
+#include <set>
 
 namespace
 {
     wxMilliClock_t lastFileListReceptionTime = 0;
+    const wxString LATENCY_PROFILES_PATH("latency.profiles");
+
+    const wxString HEADLESS_EXPORT_SWITCH("--export");
+    constexpr uint_least32_t HEADLESS_EXPORT_SAMPLE_RATE = 44100;
+    const wxString HEADLESS_EXPORT_BUNDLED_SONGLENGTHS("bundled-Songlengths.md5");
 
     void WarnRomLoadFailed(const std::wstring& romPath, const char* errMessage)
     {
@@ -134,10 +148,36 @@ namespace
             settings.GetOption(Settings::AppSettings::ID::FilterCurve8580)->GetValueAsDouble()
         };
     }
+
+    RomUtil::RomPaths LoadRomPaths(Settings::AppSettings& settings)
+    {
+        RomUtil::RomPaths romPaths;
+        romPaths.kernal = Helpers::Wx::Files::AsAbsolutePathIfPossible(settings.GetOption(Settings::AppSettings::ID::RomKernalPath)->GetValueAsString().ToStdWstring());
+        romPaths.basic = Helpers::Wx::Files::AsAbsolutePathIfPossible(settings.GetOption(Settings::AppSettings::ID::RomBasicPath)->GetValueAsString().ToStdWstring());
+        romPaths.chargen = Helpers::Wx::Files::AsAbsolutePathIfPossible(settings.GetOption(Settings::AppSettings::ID::RomChargenPath)->GetValueAsString().ToStdWstring());
+        return romPaths;
+    }
+
+    std::unique_ptr<BufferHolder> LoadTuneFile(const wxString& filename)
+    {
+        if (Helpers::Wx::Files::IsWithinZipFile(filename))
+        {
+            return Helpers::Wx::Files::GetFileContentFromZip(filename);
+        }
+
+        return Helpers::Wx::Files::GetFileContentFromDisk(filename);
+    }
 }
 
 bool MyApp::OnInit()
 {
+    if (IsHeadlessExportRequested())
+    {
+        _earlyExitCode = RunHeadlessExport();
+        _earlyExit = true;
+        return true;
+    }
+
     _instanceManager = std::make_unique<SingleInstanceManager>();
     const bool weAreFirstInstance = _instanceManager->TryLock();
 
@@ -162,6 +202,15 @@ bool MyApp::OnInit()
                                                                                              LoadFilterConfig(*currentSettings)));
         if (initSuccess)
         {
+            _playback->SetUpcomingPreRenderLimit(currentSettings->GetOption(Settings::AppSettings::ID::PreRenderLookahead)->GetValueAsInt());
+            _playback->SetPreRenderMemoryLimit(currentSettings->GetOption(Settings::AppSettings::ID::PreRenderMemoryLimitMb)->GetValueAsInt());
+            _playback->SetPreRenderVoiceStems(currentSettings->GetOption(Settings::AppSettings::ID::PreRenderVoiceStems)->GetValueAsBool());
+            _playback->SetPreRenderCacheLimit(currentSettings->GetOption(Settings::AppSettings::ID::PreRenderCacheMb)->GetValueAsInt());
+            _playback->SetRenderAheadDepth(currentSettings->GetOption(Settings::AppSettings::ID::RenderAheadMs)->GetValueAsInt());
+            _playback->SetAdaptiveLatency(currentSettings->GetOption(Settings::AppSettings::ID::AdaptiveLatency)->GetValueAsBool());
+            _playback->SetRealtimeMode(currentSettings->GetOption(Settings::AppSettings::ID::RealtimeMode)->GetValueAsBool(), currentSettings->GetOption(Settings::AppSettings::ID::RealtimeCpuCore)->GetValueAsInt());
+            _playback->TryLoadLatencyProfiles(LATENCY_PROFILES_PATH.ToStdWstring());
+
             // Load ROMs
             const std::wstring romPathKernal = Helpers::Wx::Files::AsAbsolutePathIfPossible(currentSettings->GetOption(Settings::AppSettings::ID::RomKernalPath)->GetValueAsString().ToStdWstring());
             const std::wstring romPathBasic = Helpers::Wx::Files::AsAbsolutePathIfPossible(currentSettings->GetOption(Settings::AppSettings::ID::RomBasicPath)->GetValueAsString().ToStdWstring());
@@ -222,7 +271,7 @@ int MyApp::OnRun()
 {
     if (_earlyExit)
     {
-        return EXIT_SUCCESS;
+        return _earlyExitCode;
     }
 
     return wxApp::OnRun();
@@ -258,26 +307,162 @@ void MyApp::HandoffToCanonicalInstance()
     }
 }
 
-void MyApp::Play(const wxString& filename, unsigned int subsong, int preRenderDurationMs)
+bool MyApp::IsHeadlessExportRequested() const
 {
-    assert(_playback != nullptr);
+    return argc > 2 && argv[1] == HEADLESS_EXPORT_SWITCH;
+}
 
-    StopPlayback();
+int MyApp::RunHeadlessExport()
+{
+#ifdef __WXMSW__
+    // We're a GUI subsystem app so the console of the caller (if any) must be attached explicitly.
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+#endif
 
-    bool success = false;
+    // Resolve the paths before the working directory is changed
+    wxFileName outputFolder = wxFileName::DirName(argv[2]);
+    outputFolder.MakeAbsolute();
 
+    wxArrayString rawPaths;
+    for (int i = 3; i < argc; ++i)
     {
-        std::unique_ptr<BufferHolder> bufferHolder;
+        wxFileName path(argv[i]);
+        path.MakeAbsolute();
+        rawPaths.Add(path.GetFullPath());
+    }
 
-        if (Helpers::Wx::Files::IsWithinZipFile(filename))
+    wxSetWorkingDirectory(wxPathOnly(wxStandardPaths::Get().GetExecutablePath()));
+
+    currentSettings = std::make_unique<Settings::AppSettings>();
+    currentSettings->TryLoad(currentSettings->GetDefaultSettings());
+    wxFileSystem::AddHandler(new wxZipFSHandler);
+
+    if (!outputFolder.DirExists() && !outputFolder.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+    {
+        wxFprintf(stderr, "Can't create the output folder: %s\n", outputFolder.GetFullPath());
+        return EXIT_FAILURE;
+    }
+
+    const wxArrayString files = Helpers::Wx::Files::GetValidFiles(rawPaths);
+    if (files.IsEmpty())
+    {
+        wxFprintf(stderr, "Nothing to export.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Songlengths
+    SidDecoder databaseSource;
+    for (wxFileName path : {currentSettings->GetOption(Settings::AppSettings::ID::SonglengthsPath)->GetValueAsString(), HEADLESS_EXPORT_BUNDLED_SONGLENGTHS})
+    {
+        if (!path.GetFullPath().IsEmpty() && path.MakeAbsolute() && path.Exists() && databaseSource.TryInitSidDatabase(path.GetFullPath().ToStdWstring()))
         {
-            bufferHolder = Helpers::Wx::Files::GetFileContentFromZip(filename);
+            break;
         }
-        else
+    }
+
+    const auto loader = [&files](size_t index) -> std::unique_ptr<BufferHolder>
+    {
+        return LoadTuneFile(files[index]);
+    };
+
+    // Read the subsong counts & durations
+    std::vector<TuneInfoScanner::TuneInfo> infos;
+    {
+        TuneInfoScanner scanner;
+        scanner.Start(files.GetCount(), loader, databaseSource);
+        while (!scanner.IsDone())
         {
-            bufferHolder = Helpers::Wx::Files::GetFileContentFromDisk(filename);
+            scanner.TakeReady(infos, files.GetCount(), std::chrono::milliseconds(100));
         }
+    }
+
+    // Prepare the jobs
+    const uint_least32_t fallbackDurationMs = currentSettings->GetOption(Settings::AppSettings::ID::SongFallbackDuration)->GetValueAsInt() * Const::MILLISECONDS_IN_SECOND;
+    std::vector<BatchExporter::Job> jobs;
+    std::set<wxString> usedNames;
+
+    for (size_t i = 0; i < infos.size(); ++i)
+    {
+        const TuneInfoScanner::TuneInfo& info = infos.at(i);
+        if (!info.valid)
+        {
+            wxFprintf(stderr, "Skipped (not a valid tune): %s\n", files[i]);
+            continue;
+        }
+
+        const wxString& innerPath = (Helpers::Wx::Files::IsWithinZipFile(files[i])) ? Helpers::Wx::Files::SplitZipArchiveAndFileNames(files[i]).second : files[i];
+        const wxString baseName = wxFileName(innerPath).GetName();
+
+        for (int subsong = 1; subsong <= info.totalSubsongs; ++subsong)
+        {
+            const wxString stem = (info.totalSubsongs > 1) ? wxString::Format("%s_%02d", baseName, subsong) : baseName;
+            wxString name = stem;
+            for (int n = 2; !usedNames.insert(name.Lower()).second; ++n)
+            {
+                name = wxString::Format("%s (%d)", stem, n); // Same-named tunes from different folders.
+            }
+
+            uint_least32_t durationMs = (info.totalSubsongs > 1) ? ((static_cast<size_t>(subsong) <= info.subsongDurations.size()) ? info.subsongDurations.at(subsong - 1) : 0) : info.duration;
+            if (durationMs == 0)
+            {
+                durationMs = fallbackDurationMs;
+            }
+
+            BatchExporter::Job job;
+            job.fileIndex = i;
+            job.subsong = static_cast<unsigned int>(subsong);
+            job.durationMs = durationMs;
+            job.outputFilepath = wxFileName(outputFolder.GetPath(), name, "wav").GetFullPath().ToStdWstring();
+            jobs.emplace_back(std::move(job));
+        }
+    }
+
+    // Render
+    SidConfig sidConfig = LoadSidConfig(SidConfig(), *currentSettings);
+    sidConfig.frequency = HEADLESS_EXPORT_SAMPLE_RATE;
+    sidConfig.playback = (currentSettings->GetOption(Settings::AppSettings::ID::ForceMono)->GetValueAsBool()) ? SidConfig::playback_t::MONO : SidConfig::playback_t::STEREO;
+
+    BatchExporter exporter(sidConfig, LoadFilterConfig(*currentSettings), LoadRomPaths(*currentSettings));
+    const BatchExporter::Progress result = exporter.Run(jobs, loader, databaseSource, [](const BatchExporter::Job& job, bool success, const BatchExporter::Progress& progress)
+    {
+        wxPrintf("[%zu/%zu] %s %s (%.1fx real-time)\n", progress.jobsDone, progress.jobsTotal, (success) ? "OK" : "FAILED", wxString(job.outputFilepath), progress.GetSpeedFactor());
+        fflush(stdout);
+    });
 
+    wxPrintf("Exported %zu of %zu subsongs, %s of audio in %s (%.1fx real-time).\n",
+             result.jobsDone - result.jobsFailed,
+             result.jobsTotal,
+             Helpers::Wx::GetTimeFormattedString(static_cast<uint_least32_t>(result.renderedMs)),
+             Helpers::Wx::GetTimeFormattedString(static_cast<uint_least32_t>(result.elapsedMs)),
+             result.GetSpeedFactor());
+
+    return (result.jobsFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+std::unique_ptr<DurationEstimator> MyApp::CreateDurationEstimator()
+{
+    const auto loader = [](const std::wstring& filepath) -> std::unique_ptr<BufferHolder>
+    {
+        return LoadTuneFile(filepath);
+    };
+
+    return std::make_unique<DurationEstimator>(LoadSidConfig(_playback->GetSidConfig(), *currentSettings), LoadFilterConfig(*currentSettings), LoadRomPaths(*currentSettings), loader);
+}
+
+void MyApp::Play(const wxString& filename, unsigned int subsong, int preRenderDurationMs)
+{
+    assert(_playback != nullptr);
+
+    StopPlayback();
+
+    bool success = false;
+
+    {
+        std::unique_ptr<BufferHolder> bufferHolder = LoadTuneFile(filename);
         success = (bufferHolder == nullptr) ? false : _playback->TryPlayFromBuffer(filename.ToStdWstring(), bufferHolder, subsong, preRenderDurationMs);
     }
 
@@ -319,12 +504,89 @@ void MyApp::StopPlayback()
     }
 }
 
+void MyApp::SaveLatencyProfiles()
+{
+    if (_playback != nullptr)
+    {
+        _playback->TrySaveLatencyProfiles(LATENCY_PROFILES_PATH.ToStdWstring());
+    }
+}
+
 void MyApp::PlaySubsong(int subsong, int preRenderDurationMs)
 {
     PopSilencer();
     _playback->TryPlaySubsong(subsong, preRenderDurationMs);
 }
 
+void MyApp::ArmNext(const wxString& filename, unsigned int subsong, uint_least32_t switchAtMs)
+{
+    std::unique_ptr<BufferHolder> bufferHolder = LoadTuneFile(filename);
+    if (bufferHolder == nullptr || !_playback->TryArmNext(filename.ToStdWstring(), bufferHolder, subsong, switchAtMs))
+    {
+        _playback->DisarmNext(); // Just fall back to the regular (non-gapless) advance.
+    }
+}
+
+void MyApp::DisarmNext()
+{
+    _playback->DisarmNext();
+}
+
+bool MyApp::TryPromoteArmedTune()
+{
+    return _playback->TryPromoteArmedTune();
+}
+
+void MyApp::PreRenderUpcoming(const std::vector<UpcomingSubsong>& upcoming)
+{
+    std::vector<PlaybackController::UpcomingPreRenderJob> jobs;
+    jobs.reserve(upcoming.size());
+
+    for (const UpcomingSubsong& item : upcoming)
+    {
+        // Reminder: only the ones not rendered (or cached) already get loaded, in their worker threads.
+        const wxString filename = item.filename;
+        jobs.emplace_back(filename.ToStdWstring(), [filename]() { return LoadTuneFile(filename); }, item.subsong, item.preRenderDurationMs);
+    }
+
+    _playback->PreRenderUpcoming(jobs);
+}
+
+void MyApp::SetUpcomingPreRenderLimit(unsigned int maxSubsongs)
+{
+    _playback->SetUpcomingPreRenderLimit(maxSubsongs);
+}
+
+void MyApp::SetPreRenderMemoryLimit(unsigned int megabytes)
+{
+    _playback->SetPreRenderMemoryLimit(megabytes);
+}
+
+void MyApp::SetPreRenderVoiceStems(bool enable)
+{
+    _playback->SetPreRenderVoiceStems(enable);
+}
+
+void MyApp::SetPreRenderCacheLimit(unsigned int megabytes)
+{
+    _playback->SetPreRenderCacheLimit(megabytes);
+}
+
+void MyApp::SetRenderAheadDepth(unsigned int depthMs)
+{
+    _playback->SetRenderAheadDepth(depthMs);
+}
+
+void MyApp::SetAdaptiveLatency(bool enable)
+{
+    _playback->SetAdaptiveLatency(enable);
+}
+
+void MyApp::SetRealtimeMode(bool enable, int cpuCore)
+{
+    _playback->SetRealtimeMode(enable, cpuCore);
+}
+
 void MyApp::SetVolume(float volume)
 {
     _playback->SetVolume(volume);
@@ -340,6 +602,11 @@ void MyApp::SetPlaybackSpeed(double factor)
     _playback->TrySetPlaybackSpeed(factor);
 }
 
+void MyApp::SetPitchPreserved(bool preserve)
+{
+    _playback->SetPitchPreserved(preserve);
+}
+
 void MyApp::ToggleVoice(unsigned int sidNum, unsigned int voice, bool enable)
 {
     _playback->ToggleVoice(sidNum, voice, enable);
@@ -26,12 +26,14 @@
 #include "Config/AppSettings.h"
 #include "SingleInstanceManager/SingleInstanceManager.h"
 #include "FramePlayer/FramePlayer.h"
+#include "../PlaybackController/DurationEstimator.h"
 #include "../PlaybackController/PlaybackController.h"
 #include "../Util/SimpleTimer.h"
 #include "../Util/SimpleSignal/SimpleSignalProvider.h"
 #include "../Util/SimpleSignal/SimpleSignalListener.h"
 
 #include <memory>
+#include <vector>
 
 enum class SignalsMyApp
 {
@@ -40,6 +42,14 @@ enum class SignalsMyApp
 
 class MyApp : public wxApp, public SimpleSignalProvider<SignalsMyApp>, private SimpleSignalListener<SignalsPlaybackController>
 {
+public:
+    struct UpcomingSubsong
+    {
+        wxString filename;
+        unsigned int subsong;
+        int preRenderDurationMs;
+    };
+
 public:
     MyApp() = default;
 
@@ -50,18 +60,46 @@ public:
 private:
     void HandoffToCanonicalInstance();
 
+    /// @brief Command-line mode without the GUI and the audio output: renders the given files/folders/playlists into WAV files. Returns the process exit code.
+    /// Usage: sidplaywx --export <output folder> <file|folder|playlist>...
+    bool IsHeadlessExportRequested() const;
+    int RunHeadlessExport();
+
 public:
     void Play(const wxString& filename, unsigned int subsong, int preRenderDurationMs); // TODO: PassKey or something to allow calling this by the TryPlayPlaylistItem method only?
     void ReplayLoadedTune(int preRenderDurationMs, bool reusePreRender = false);
     void PausePlayback();
     void ResumePlayback();
     void StopPlayback();
+
+    /// @brief Persists what the adaptive latency has learned so far (see PlaybackController::TrySaveLatencyProfiles).
+    void SaveLatencyProfiles();
     void PlaySubsong(int subsong, int preRenderDurationMs);
 
+    /// @brief Prepares the next (sub)song to follow the current one seamlessly at the switchAtMs (see PlaybackController::TryArmNext).
+    void ArmNext(const wxString& filename, unsigned int subsong, uint_least32_t switchAtMs);
+    void DisarmNext();
+
+    /// @brief Returns true if the playback has just seamlessly continued with the armed (sub)song, which is the active one from now on.
+    bool TryPromoteArmedTune();
+
+    void PreRenderUpcoming(const std::vector<UpcomingSubsong>& upcoming);
+    void SetUpcomingPreRenderLimit(unsigned int maxSubsongs);
+    void SetPreRenderMemoryLimit(unsigned int megabytes);
+    void SetPreRenderVoiceStems(bool enable);
+    void SetPreRenderCacheLimit(unsigned int megabytes);
+    void SetRenderAheadDepth(unsigned int depthMs);
+    void SetAdaptiveLatency(bool enable);
+    void SetRealtimeMode(bool enable, int cpuCore);
+
     void SetVolume(float volume);
     void SeekTo(uint_least32_t timeMs);
 
+    /// @brief Creates an estimator of the unknown song durations with the current emulation settings.
+    std::unique_ptr<DurationEstimator> CreateDurationEstimator();
+
     void SetPlaybackSpeed(double factor);
+    void SetPitchPreserved(bool preserve);
     void ToggleVoice(unsigned int sidNum, unsigned int voice, bool enable);
     const PlaybackController& GetPlaybackInfo() const;
     bool ReapplyPlaybackSettings();
@@ -94,6 +132,7 @@ public:
 
 private:
     bool _earlyExit = false;
+    int _earlyExitCode = EXIT_SUCCESS;
     FramePlayer* _framePlayer = nullptr;
     std::unique_ptr<PlaybackController> _playback;
     std::unique_ptr<SingleInstanceManager> _instanceManager;
@@ -95,6 +95,10 @@ namespace UIElements
 
 	void CompositeSeekBar::UpdatePlaybackPosition(long time, double preRenderProgressFactor)
 	{
+		const int oldProgressX = ToSeekAreaPixels(_progressFillFactor);
+		const int oldTargetX = ToSeekAreaPixels(_targetFillFactor);
+		const int oldPreRenderX = ToSeekAreaPixels(_preRenderFillFactor);
+
 		_progressFillFactor = (_duration > 1.0) ? std::min(1.0, time / _duration) : 0.0;
 		const bool seeking = !IsSeekTargetReached();
 		if (!_pressedDown && !seeking)
@@ -105,7 +109,12 @@ namespace UIElements
 		_preRenderFillFactor = preRenderProgressFactor;
 
 		UpdateTaskbarIndicator();
-		Refresh();
+
+		// Called on every refresh timer tick, but mostly nothing visibly changes (e.g., while paused, or for long songs).
+		if (ToSeekAreaPixels(_progressFillFactor) != oldProgressX || ToSeekAreaPixels(_targetFillFactor) != oldTargetX || ToSeekAreaPixels(_preRenderFillFactor) != oldPreRenderX)
+		{
+			Refresh();
+		}
 	}
 
 	void CompositeSeekBar::ResetPlaybackPosition(long duration)
@@ -125,6 +134,13 @@ namespace UIElements
 		Refresh();
 	}
 
+	void CompositeSeekBar::SetDuration(long duration)
+	{
+		_duration = std::max(1.0, static_cast<double>(duration));
+		SetEnabledAuto();
+		Refresh(); // Reminder: the progress itself catches up with the next UpdatePlaybackPosition.
+	}
+
 	void CompositeSeekBar::SetEnabledAuto()
 	{
 		Enable(_duration > 1.0);
@@ -53,6 +53,9 @@ namespace UIElements
 	public:
 		void UpdatePlaybackPosition(long time, double preRenderProgressFactor = 0.0);
 		void ResetPlaybackPosition(long duration);
+
+		/// @brief Changes the duration of the ongoing playback without resetting its position.
+		void SetDuration(long duration);
 		void SetEnabledAuto();
 		double GetNormalizedFillTarget() const;
 		bool IsSeekPreviewing() const;
@@ -76,6 +79,11 @@ namespace UIElements
 			return GetClientSize().GetWidth() - _thumbSize.GetWidth();
 		}
 
+		inline int ToSeekAreaPixels(double fillFactor) const
+		{
+			return static_cast<int>(GetSeekAreaWidth() * fillFactor);
+		}
+
 	private: // Event handlers
 		void OnPaintEvent(wxPaintEvent& evt);
 
@@ -30,7 +30,7 @@ namespace UIElements
 			const std::unique_ptr<BufferHolder>& data = Helpers::Wx::Files::GetFileContentFromDisk(image);
 			assert(data.get() != nullptr); // File not found.
 			const wxSize scaledImageSize = size * scale;
-			wxBitmapBundle bb = wxBitmapBundle::FromSVG(data->buffer, data->size, scaledImageSize);
+			wxBitmapBundle bb = wxBitmapBundle::FromSVG(data->data, data->size, scaledImageSize);
 			wxImage destImage = bb.GetBitmap(scaledImageSize).ConvertToImage().Resize(wxSize(scaledImageSize.GetWidth() / scale, scaledImageSize.GetHeight() / scale), wxPoint(artOffset.x * scale, artOffset.y * scale));
 			return std::make_shared<wxBitmap>(destImage);
 		}
@@ -88,6 +88,11 @@ UIElements::Playlist::PlaylistIconId PlaylistTreeModelNode::GetIconId() const
 	return _iconId;
 }
 
+uint_least32_t PlaylistTreeModelNode::GetEstimatedDuration() const
+{
+	return _estimatedDuration;
+}
+
 PlaylistTreeModelNode& PlaylistTreeModelNode::AddChild(PlaylistTreeModelNode* childToAdopt, PlaylistTreeModelNode::PassKey<UIElements::Playlist::Playlist>)
 {
 	assert(_parent == nullptr); // Adding children to children is unexpected usecase.
@@ -119,6 +124,11 @@ void PlaylistTreeModelNode::SetTag(ItemTag tag, PassKey<UIElements::Playlist::Pl
 	_tag = tag;
 }
 
+void PlaylistTreeModelNode::SetEstimatedDuration(uint_least32_t estimatedDuration, PassKey<UIElements::Playlist::Playlist>)
+{
+	_estimatedDuration = estimatedDuration;
+}
+
 void PlaylistTreeModelNode::SetIconId(UIElements::Playlist::PlaylistIconId newIconId, PassKey<UIElements::Playlist::Playlist>)
 {
 	_iconId = newIconId;
@@ -172,7 +182,14 @@ void PlaylistTreeModel::GetValue(wxVariant& variant, const wxDataViewItem& item,
 		{
 			if (node->GetSubsongCount() == 0)
 			{
-				variant = Helpers::Wx::GetTimeFormattedString(node->duration, true);
+				if (node->duration == 0 && node->GetEstimatedDuration() != 0)
+				{
+					variant = "~" + Helpers::Wx::GetTimeFormattedString(node->GetEstimatedDuration());
+				}
+				else
+				{
+					variant = Helpers::Wx::GetTimeFormattedString(node->duration, true);
+				}
 			}
 			break;
 		}
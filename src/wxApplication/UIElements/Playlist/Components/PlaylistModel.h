@@ -104,6 +104,9 @@ public:
 	ItemTag GetTag() const;
 	UIElements::Playlist::PlaylistIconId GetIconId() const;
 
+	/// @brief Duration estimated by the background analysis (0 if none). Only relevant when the duration is unknown.
+	uint_least32_t GetEstimatedDuration() const;
+
 public:
 	/// @brief This is a protected method that can only be called by the controller due to mandatory model refresh requirement.
 	PlaylistTreeModelNode& AddChild(PlaylistTreeModelNode* childToAdopt, PassKey<UIElements::Playlist::Playlist>);
@@ -123,6 +126,9 @@ public:
 	/// @brief This is a protected method that can only be called by the controller to ensure visual presentation consistency.
 	void SetTag(ItemTag tag, PassKey<UIElements::Playlist::Playlist>);
 
+	/// @brief This is a protected method that can only be called by the controller to ensure visual presentation consistency.
+	void SetEstimatedDuration(uint_least32_t estimatedDuration, PassKey<UIElements::Playlist::Playlist>);
+
 	/// @brief This is a protected method that can only be called by the controller to ensure visual presentation consistency.
 	void SetIconId(UIElements::Playlist::PlaylistIconId newIconId, PassKey<UIElements::Playlist::Playlist>);
 
@@ -145,6 +151,7 @@ private:
 	wxDataViewItemAttr _itemAttr;
 	bool _playable = true;
 	ItemTag _tag = ItemTag::Normal;
+	uint_least32_t _estimatedDuration = 0;
 	UIElements::Playlist::PlaylistIconId _iconId = UIElements::Playlist::PlaylistIconId::NoIcon;
 };
 
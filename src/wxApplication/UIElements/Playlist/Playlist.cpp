@@ -491,6 +491,12 @@ namespace UIElements
 			_model.ItemChanged(wxDataViewItem(&node)); // Refresh icon immediately.
 		}
 
+		void Playlist::SetEstimatedDuration(PlaylistTreeModelNode& node, uint_least32_t estimatedDuration)
+		{
+			node.SetEstimatedDuration(estimatedDuration, {});
+			_model.ItemChanged(wxDataViewItem(&node));
+		}
+
 		bool Playlist::Select(const PlaylistTreeModelNode& node)
 		{
 			const wxDataViewItem item = PlaylistTreeModel::ModelNodeToTreeItem(node);
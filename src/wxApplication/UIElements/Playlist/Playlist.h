@@ -109,6 +109,9 @@ namespace UIElements
 			/// @brief Applies the tag to the node with corresponding functional and visual changes. Ignores unplayable nodes by default unless forced.
 			void SetItemTag(PlaylistTreeModelNode& node, PlaylistTreeModelNode::ItemTag tag, bool force = false); // TODO: consider renaming to SetItemStatus (and "tag" concept to "status" concept)?
 
+			/// @brief Sets the estimated duration of a node with an unknown duration (and refreshes its display).
+			void SetEstimatedDuration(PlaylistTreeModelNode& node, uint_least32_t estimatedDuration);
+
 			/// @brief Soft-selects (highlights) a node in the tree.
 			bool Select(const PlaylistTreeModelNode& node);
 
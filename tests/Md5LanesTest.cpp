@@ -0,0 +1,150 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// Md5Lanes regression tests (see TestsMain.cpp).
+
+#include "Tests.h"
+#include "../src/PlaybackController/Util/Md5Lanes.h"
+
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Vector
+    {
+        std::string message;
+        const char* md5;
+    };
+
+    struct SizedVector
+    {
+        size_t size;
+        const char* md5;
+    };
+
+    using HashAllFunc = std::vector<Md5Lanes::Digest> (*)(const std::vector<Md5Lanes::Input>&);
+
+    const HashAllFunc HASH_ALL_VARIANTS[] = {&Md5Lanes::HashAll, &Md5Lanes::HashAllPortable};
+    const char* const HASH_ALL_VARIANT_NAMES[] = {"HashAll", "HashAllPortable"};
+
+    std::string ToHex(const Md5Lanes::Digest& digest)
+    {
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        std::string result;
+        for (uint_least8_t byte : digest)
+        {
+            result += DIGITS[byte >> 4];
+            result += DIGITS[byte & 0x0f];
+        }
+
+        return result;
+    }
+
+    /// @brief Hashes all the inputs in one batch (so the lanes get refilled) and verifies each digest against the expected one.
+    bool VerifyBatch(const std::vector<Md5Lanes::Input>& inputs, const std::vector<const char*>& expected)
+    {
+        for (size_t variant = 0; variant < std::size(HASH_ALL_VARIANTS); ++variant)
+        {
+            const std::vector<Md5Lanes::Digest> digests = HASH_ALL_VARIANTS[variant](inputs);
+            if (digests.size() != inputs.size())
+            {
+                std::printf("  %s returned %zu digests for %zu inputs\n", HASH_ALL_VARIANT_NAMES[variant], digests.size(), inputs.size());
+                return false;
+            }
+
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                const std::string actual = ToHex(digests[i]);
+                if (actual != expected[i])
+                {
+                    std::printf("  %s of %zu bytes: %s instead of %s\n", HASH_ALL_VARIANT_NAMES[variant], inputs[i].size, actual.c_str(), expected[i]);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+bool TestMd5RfcVectors()
+{
+    // RFC 1321, appendix A.5.
+    const Vector vectors[] =
+    {
+        {"", "d41d8cd98f00b204e9800998ecf8427e"},
+        {"a", "0cc175b9c0f1b6a831c399e269772661"},
+        {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+        {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+        {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+        {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f"},
+        {"12345678901234567890123456789012345678901234567890123456789012345678901234567890", "57edf4a22be3c955ac49da2e2107b67a"},
+    };
+
+    std::vector<Md5Lanes::Input> inputs;
+    std::vector<const char*> expected;
+    for (const Vector& vector : vectors)
+    {
+        inputs.push_back({reinterpret_cast<const uint_least8_t*>(vector.message.data()), vector.message.size()});
+        expected.push_back(vector.md5);
+    }
+
+    return VerifyBatch(inputs, expected);
+}
+
+bool TestMd5PaddingBoundaries()
+{
+    // Sizes around the block boundaries, where the padding and the length either still fit in the last data block or spill over into another one.
+    const SizedVector vectors[] =
+    {
+        {0, "d41d8cd98f00b204e9800998ecf8427e"},
+        {55, "852e13533f66e414bbbbb3348de4f81f"},
+        {56, "98e8cb3457434649644b5fe9f4e5e4fa"},
+        {63, "c9803ddca3b148d91d5f214be64197d4"},
+        {64, "bc00c8534af1e5aef0ede584d8ad5bc3"},
+        {65, "4e114d3e0baf5ace365e0552a3273291"},
+        {119, "e0c0cb3cbc027ba4d5a6c983754f2dc1"},
+        {120, "3d7a96a57e721a4e2c2cbe55937e10e2"},
+        {70000, "fb135edb858597ef70797dba7c495a9d"},
+    };
+
+    std::vector<uint_least8_t> data(70000);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<uint_least8_t>(i * 131 + 7);
+    }
+
+    // Each one alone, then all of them in one batch (the long one keeping its lane busy while the others take turns).
+    std::vector<Md5Lanes::Input> inputs;
+    std::vector<const char*> expected;
+    for (const SizedVector& vector : vectors)
+    {
+        if (!VerifyBatch({{data.data(), vector.size}}, {vector.md5}))
+        {
+            return false;
+        }
+
+        inputs.push_back({data.data(), vector.size});
+        expected.push_back(vector.md5);
+    }
+
+    return VerifyBatch(inputs, expected);
+}
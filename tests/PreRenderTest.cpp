@@ -0,0 +1,391 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// PreRender regression tests (see TestsMain.cpp).
+
+#include "Tests.h"
+#include "../src/PlaybackController/PreRender.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+
+namespace
+{
+    constexpr int SAMPLE_RATE = 8000;
+    constexpr int NUM_CHANNELS = 1;
+    constexpr int DURATION_MS = 60000;
+    constexpr int WINDOW_MS = 4000;
+    constexpr std::chrono::seconds TIMEOUT(10);
+    constexpr uint_least32_t FAST_FORWARD_STEP_MS = 20; // Like an emulation frame.
+    constexpr std::chrono::milliseconds FAST_FORWARD_STEP_DURATION(1);
+    constexpr std::chrono::milliseconds STOP_TOLERANCE(500);
+
+    /// @brief Renders each sample as its own position (wrapped to short), so the content at any position can be verified.
+    class RampRenderer : public IBufferWriter
+    {
+    public:
+        /// @brief Makes each fill take the fillDuration, and every fill from the failingFill on (counting from 0) fail.
+        RampRenderer(std::chrono::milliseconds fillDuration = std::chrono::milliseconds(0), size_t failingFill = SIZE_MAX) :
+            _fillDuration(fillDuration),
+            _failingFill(failingFill)
+        {
+        }
+
+        bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override
+        {
+            if (_fills++ >= _failingFill)
+            {
+                return false;
+            }
+
+            std::this_thread::sleep_for(_fillDuration);
+            short* const out = static_cast<short*>(buffer);
+            for (unsigned long i = 0; i < framesPerBuffer * NUM_CHANNELS; ++i)
+            {
+                out[i] = static_cast<short>(_position++);
+            }
+
+            return true;
+        }
+
+        /// @brief Fast-forwards from the start (slowly, like an emulator without any seek checkpoints) unless the callback gives up.
+        uint_least32_t SeekTo(uint_least32_t timeMs, const IBufferWriter::SeekStatusCallback& callback)
+        {
+            uint_least32_t cTimeMs = 0;
+            for (; cTimeMs < timeMs; cTimeMs += FAST_FORWARD_STEP_MS)
+            {
+                _position = static_cast<size_t>(cTimeMs) * SAMPLE_RATE / 1000 * NUM_CHANNELS;
+                if (callback(cTimeMs, false))
+                {
+                    return cTimeMs;
+                }
+
+                std::this_thread::sleep_for(FAST_FORWARD_STEP_DURATION);
+            }
+
+            _position = static_cast<size_t>(cTimeMs) * SAMPLE_RATE / 1000 * NUM_CHANNELS;
+            callback(cTimeMs, true);
+            return cTimeMs;
+        }
+
+        PreRender::AbortableRendererSeeker GetSeeker()
+        {
+            return [this](uint_least32_t timeMs, const IBufferWriter::SeekStatusCallback& callback) { return SeekTo(timeMs, callback); };
+        }
+
+    private:
+        std::atomic_size_t _position = 0;
+        const std::chrono::milliseconds _fillDuration;
+        const size_t _failingFill;
+        size_t _fills = 0;
+    };
+
+    bool WaitForWindowFull(const PreRender& preRender)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+        double lastFactor = -1.0;
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            const double factor = preRender.GetPreRenderProgressFactor();
+            if (factor > 0.0 && factor == lastFactor)
+            {
+                return true; // Stalled, waiting for the play head.
+            }
+
+            lastFactor = factor;
+        }
+
+        return false;
+    }
+
+    /// @brief Seeks until done or until the abortSeek is raised, returns whether it reached the target.
+    std::future<bool> StartSeek(PreRender& preRender, int targetMs, std::atomic_bool& abortSeek)
+    {
+        return std::async(std::launch::async, [&preRender, targetMs, &abortSeek]
+        {
+            bool done = false;
+            preRender.SeekTo(targetMs, [&abortSeek, &done](int /*timeMs*/, bool isDone)
+            {
+                done = done || isDone;
+                return abortSeek.load();
+            });
+
+            return done;
+        });
+    }
+
+    /// @brief Plays from the current position up to the endMs (waiting for the renderer as needed), verifying the content is continuous.
+    bool PlayAndVerify(PreRender& preRender, int endMs)
+    {
+        constexpr unsigned long FRAMES = 256;
+        const auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+        short buffer[FRAMES * NUM_CHANNELS];
+        size_t position = static_cast<size_t>(preRender.GetCurrentSongTimeMs()) * SAMPLE_RATE / 1000 * NUM_CHANNELS;
+        while (static_cast<int>(position * 1000 / SAMPLE_RATE / NUM_CHANNELS) < endMs)
+        {
+            if (preRender.GetCurrentSongTimeMs() != static_cast<int>(position * 1000 / SAMPLE_RATE / NUM_CHANNELS))
+            {
+                std::puts("  play head jumped");
+                return false;
+            }
+
+            const size_t renderedEnd = static_cast<size_t>(preRender.GetPreRenderProgressFactor() * DURATION_MS * SAMPLE_RATE / 1000 * NUM_CHANNELS);
+            if (position + FRAMES * NUM_CHANNELS * 2 > renderedEnd) // Some leeway for the rounding.
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    std::puts("  renderer never caught up");
+                    return false;
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            preRender.TryFillBuffer(buffer, FRAMES);
+            for (size_t i = 0; i < FRAMES * NUM_CHANNELS; ++i)
+            {
+                if (buffer[i] != static_cast<short>(position + i))
+                {
+                    std::printf("  wrong content at %zu\n", position + i);
+                    return false;
+                }
+            }
+
+            position += FRAMES * NUM_CHANNELS;
+        }
+
+        return true;
+    }
+}
+
+bool TestSeekJustPastRenderedEndOfFullWindow()
+{
+    RampRenderer renderer;
+    PreRender preRender;
+    preRender.DoPreRender(renderer, SAMPLE_RATE, NUM_CHANNELS, DURATION_MS, WINDOW_MS, renderer.GetSeeker());
+
+    if (!WaitForWindowFull(preRender))
+    {
+        std::puts("  window never filled up");
+        return false;
+    }
+
+    const int renderedEndMs = static_cast<int>(preRender.GetPreRenderProgressFactor() * DURATION_MS);
+    const int targetMs = renderedEndMs + 100; // Well within the "not worth re-anchoring" distance.
+
+    std::atomic_bool done = false;
+    std::future<void> seek = std::async(std::launch::async, [&preRender, &done, targetMs]
+    {
+        preRender.SeekTo(targetMs, [&done](int /*timeMs*/, bool isDone)
+        {
+            done = done || isDone;
+            return false;
+        });
+    });
+
+    if (seek.wait_for(TIMEOUT) != std::future_status::ready)
+    {
+        std::puts("  seek deadlocked");
+        std::fflush(stdout);
+        std::_Exit(1); // Can't join the stuck threads.
+    }
+
+    if (!done || preRender.GetCurrentSongTimeMs() < targetMs)
+    {
+        std::puts("  seek didn't reach the target");
+        return false;
+    }
+
+    const size_t targetPosition = static_cast<size_t>(preRender.GetCurrentSongTimeMs()) * SAMPLE_RATE / 1000 * NUM_CHANNELS;
+    short sample = 0;
+    preRender.TryFillBuffer(&sample, 1);
+    if (sample != static_cast<short>(targetPosition))
+    {
+        std::puts("  wrong content at the target");
+        return false;
+    }
+
+    return true;
+}
+
+bool TestStopDuringFarReanchor()
+{
+    RampRenderer renderer;
+    PreRender preRender;
+    preRender.DoPreRender(renderer, SAMPLE_RATE, NUM_CHANNELS, DURATION_MS, WINDOW_MS, renderer.GetSeeker());
+
+    if (!WaitForWindowFull(preRender))
+    {
+        std::puts("  window never filled up");
+        return false;
+    }
+
+    // Far ahead, so the renderer gets re-anchored (taking several seconds to fast-forward there).
+    std::atomic_bool abortSeek = false;
+    std::future<void> seek = std::async(std::launch::async, [&preRender, &abortSeek]
+    {
+        preRender.SeekTo(DURATION_MS - WINDOW_MS, [&abortSeek](int /*timeMs*/, bool /*isDone*/)
+        {
+            return abortSeek.load();
+        });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    abortSeek = true;
+    seek.wait();
+
+    const auto stopStart = std::chrono::steady_clock::now();
+    std::future<void> stop = std::async(std::launch::async, [&preRender] { preRender.Stop(); });
+    if (stop.wait_for(TIMEOUT) != std::future_status::ready)
+    {
+        std::puts("  stop never finished");
+        std::fflush(stdout);
+        std::_Exit(1); // Can't join the stuck threads.
+    }
+
+    if (std::chrono::steady_clock::now() - stopStart > STOP_TOLERANCE)
+    {
+        std::puts("  stop waited for the re-anchoring to complete");
+        return false;
+    }
+
+    return true;
+}
+
+bool TestNewerSeekSupersedesFarReanchor()
+{
+    RampRenderer renderer;
+    PreRender preRender;
+    preRender.DoPreRender(renderer, SAMPLE_RATE, NUM_CHANNELS, DURATION_MS, WINDOW_MS, renderer.GetSeeker());
+
+    if (!WaitForWindowFull(preRender))
+    {
+        std::puts("  window never filled up");
+        return false;
+    }
+
+    // Scrubbing: the first far seek gets abandoned (as the PlaybackController does) in favor of another far one.
+    std::atomic_bool abortFirst = false;
+    std::future<bool> first = StartSeek(preRender, DURATION_MS - WINDOW_MS, abortFirst);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    abortFirst = true;
+    first.wait();
+
+    constexpr int SECOND_TARGET_MS = DURATION_MS / 3;
+    const auto secondStart = std::chrono::steady_clock::now();
+    std::atomic_bool abortSecond = false;
+    std::future<bool> second = StartSeek(preRender, SECOND_TARGET_MS, abortSecond);
+    if (second.wait_for(TIMEOUT) != std::future_status::ready)
+    {
+        std::puts("  seek never finished");
+        std::fflush(stdout);
+        std::_Exit(1); // Can't join the stuck threads.
+    }
+
+    // Fast-forwarding to the second target alone takes a third of the time of the first one.
+    const auto secondDuration = std::chrono::steady_clock::now() - secondStart;
+    const auto secondAloneDuration = FAST_FORWARD_STEP_DURATION * (SECOND_TARGET_MS / FAST_FORWARD_STEP_MS);
+    if (!second.get() || secondDuration > secondAloneDuration * 2)
+    {
+        std::puts("  seek waited for the abandoned one");
+        return false;
+    }
+
+    return PlayAndVerify(preRender, SECOND_TARGET_MS + WINDOW_MS * 2);
+}
+
+bool TestContentAfterAbandonedReanchor()
+{
+    RampRenderer renderer;
+    PreRender preRender;
+    preRender.DoPreRender(renderer, SAMPLE_RATE, NUM_CHANNELS, DURATION_MS, WINDOW_MS, renderer.GetSeeker());
+
+    if (!WaitForWindowFull(preRender))
+    {
+        std::puts("  window never filled up");
+        return false;
+    }
+
+    // Far seek abandoned in favor of one within the window: the renderer must continue right where the window ended.
+    std::atomic_bool abortFirst = false;
+    std::future<bool> first = StartSeek(preRender, DURATION_MS - WINDOW_MS, abortFirst);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    abortFirst = true;
+    first.wait();
+
+    std::atomic_bool abortSecond = false;
+    if (!StartSeek(preRender, WINDOW_MS / 4, abortSecond).get())
+    {
+        std::puts("  seek within the window didn't finish");
+        return false;
+    }
+
+    return PlayAndVerify(preRender, WINDOW_MS * 3);
+}
+
+bool TestFailedJumpLaneDoesNotStopFrontLane()
+{
+    constexpr int TARGET_MS = DURATION_MS * 5 / 6; // Reached by the jump lane well before the (slow) front lane gets there.
+    RampRenderer frontRenderer(std::chrono::milliseconds(50));
+    RampRenderer jumpRenderer(std::chrono::milliseconds(0), 0);
+    PreRender preRender;
+    preRender.DoPreRenderSeekPriority({&frontRenderer, frontRenderer.GetSeeker()}, {&jumpRenderer, jumpRenderer.GetSeeker()}, SAMPLE_RATE, NUM_CHANNELS, DURATION_MS);
+
+    std::atomic_bool abortSeek = false;
+    if (!StartSeek(preRender, TARGET_MS, abortSeek).get())
+    {
+        std::puts("  seek didn't finish");
+        return false;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    while (!preRender.IsFullyAvailable())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            std::puts("  rendering stopped at the failed jump");
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return PlayAndVerify(preRender, DURATION_MS - 1000); // Reminder: it needs some leeway before the end.
+}
+
+bool TestAdoptRunningContinuesRendering()
+{
+    RampRenderer renderer(std::chrono::milliseconds(5));
+    PreRender upcoming;
+    upcoming.DoPreRender(renderer, SAMPLE_RATE, NUM_CHANNELS, DURATION_MS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    PreRender preRender;
+    if (!preRender.TryAdoptRunning(upcoming, renderer) || preRender.IsFullyAvailable())
+    {
+        std::puts("  render in progress wasn't taken over");
+        return false;
+    }
+
+    return PlayAndVerify(preRender, DURATION_MS - 1000);
+}
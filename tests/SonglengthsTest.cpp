@@ -0,0 +1,87 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// Songlengths regression tests (see TestsMain.cpp).
+
+#include "Tests.h"
+#include "../src/PlaybackController/PlaybackWrappers/Input/Songlengths.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+bool TestSonglengthsLookupByDigest()
+{
+    const std::string tune = "PSID stand-in, only its MD5 matters";
+    const Md5Lanes::Digest md5 = Md5Lanes::HashAll({{reinterpret_cast<const uint_least8_t*>(tune.data()), tune.size()}}).front();
+
+    std::string md5Hex;
+    for (uint_least8_t byte : md5)
+    {
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        md5Hex += DIGITS[byte >> 4];
+        md5Hex += DIGITS[byte & 0x0f];
+    }
+
+    const std::filesystem::path filepath = std::filesystem::temp_directory_path() / "sidplaywx-tests-Songlengths.md5";
+    const std::filesystem::path compiledFilepath = filepath.wstring() + L".bin";
+    std::filesystem::remove(compiledFilepath);
+    {
+        std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+        file << "; Test database\r\n[Database]\r\n";
+        file << "; /Some/Other.sid\r\n0123456789abcdef0123456789abcdef=1:00\r\n";
+        file << "; /Test.sid\r\n" << md5Hex << "=0:30 1:02.500 12:00\r\n";
+    }
+
+    Md5Lanes::Digest unknownMd5 = md5;
+    unknownMd5.back() ^= 0xff;
+
+    // First load parses the text (and compiles the sidecar), the second one uses the compiled sidecar.
+    bool success = true;
+    for (const char* source : {"text", "compiled"})
+    {
+        Songlengths songlengths;
+        if (!songlengths.TryLoad(filepath.wstring()))
+        {
+            std::printf("  %s database didn't load\n", source);
+            success = false;
+            break;
+        }
+
+        const Songlengths::SubsongDurations durations = songlengths.GetSubsongDurationsMs(md5);
+        if (durations != Songlengths::SubsongDurations{30000, 62500, 720000})
+        {
+            std::printf("  wrong durations from the %s database (%zu subsongs)\n", source, durations.size());
+            success = false;
+            break;
+        }
+
+        if (!songlengths.GetSubsongDurationsMs(unknownMd5).empty())
+        {
+            std::printf("  unknown tune found in the %s database\n", source);
+            success = false;
+            break;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(filepath, ec);
+    std::filesystem::remove(compiledFilepath, ec);
+    return success;
+}
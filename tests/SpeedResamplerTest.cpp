@@ -0,0 +1,243 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// SpeedResampler regression tests (see TestsMain.cpp).
+
+#include "Tests.h"
+#include "../src/PlaybackController/SpeedResampler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    constexpr int SAMPLE_RATE = 48000;
+    constexpr int NUM_CHANNELS = 2;
+    constexpr unsigned long FRAMES = 512; // Per audio callback.
+    constexpr int WARMUP_CALLBACKS = 4; // Output before the kernel is filled with the actual signal (the history starts silent).
+    constexpr int MEASURED_CALLBACKS = 64;
+    constexpr double PI = 3.14159265358979323846;
+    constexpr double MIN_STOPBAND_ATTENUATION_DB = 50.0;
+
+    /// @brief Same sine (or DC if the frequency is 0) on all channels.
+    class ToneSource : public IBufferWriter
+    {
+    public:
+        ToneSource(double frequency, double amplitude) :
+            _frequency(frequency),
+            _amplitude(amplitude)
+        {
+        }
+
+        bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override
+        {
+            short* const out = static_cast<short*>(buffer);
+            for (unsigned long i = 0; i < framesPerBuffer; ++i, ++_frame)
+            {
+                const double value = (_frequency == 0.0) ? _amplitude : _amplitude * std::sin(2.0 * PI * _frequency * _frame / SAMPLE_RATE);
+                for (int ch = 0; ch < NUM_CHANNELS; ++ch)
+                {
+                    out[i * NUM_CHANNELS + ch] = static_cast<short>(std::lround(value));
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        const double _frequency;
+        const double _amplitude;
+        size_t _frame = 0;
+    };
+
+    /// @brief Counts up by one per frame (on all channels), so any skipped or repeated source frame shows.
+    class RampSource : public IBufferWriter
+    {
+    public:
+        bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override
+        {
+            short* const out = static_cast<short*>(buffer);
+            for (unsigned long i = 0; i < framesPerBuffer; ++i, ++_frame)
+            {
+                for (int ch = 0; ch < NUM_CHANNELS; ++ch)
+                {
+                    out[i * NUM_CHANNELS + ch] = static_cast<short>(_frame);
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        size_t _frame = 0;
+    };
+
+    /// @brief Plays the source at the speed factor, returns the output past the warm-up (empty if the resampler failed).
+    std::vector<short> Play(IBufferWriter& source, double speedFactor)
+    {
+        SpeedResampler resampler;
+        resampler.SetSource(source, NUM_CHANNELS);
+        resampler.SetSpeedFactor(speedFactor);
+
+        std::vector<short> buffer(FRAMES * NUM_CHANNELS);
+        std::vector<short> result;
+        for (int i = 0; i < WARMUP_CALLBACKS + MEASURED_CALLBACKS; ++i)
+        {
+            if (!resampler.TryFillBuffer(buffer.data(), FRAMES))
+            {
+                return {};
+            }
+
+            if (i >= WARMUP_CALLBACKS)
+            {
+                result.insert(result.end(), buffer.begin(), buffer.end());
+            }
+        }
+
+        return result;
+    }
+
+    double GetRms(const std::vector<short>& samples)
+    {
+        double sum = 0.0;
+        for (short sample : samples)
+        {
+            sum += static_cast<double>(sample) * sample;
+        }
+
+        return std::sqrt(sum / samples.size());
+    }
+
+    /// @brief A tone above the output's Nyquist frequency (i.e., one which would alias) must be (almost) gone.
+    bool TestStopband(double speedFactor, double frequency)
+    {
+        constexpr double AMPLITUDE = 16000.0;
+        ToneSource source(frequency, AMPLITUDE);
+        const std::vector<short> output = Play(source, speedFactor);
+        if (output.empty())
+        {
+            std::puts("  resampler failed");
+            return false;
+        }
+
+        const double attenuationDb = 20.0 * std::log10((AMPLITUDE / std::sqrt(2.0)) / std::max(GetRms(output), 1e-9));
+        if (attenuationDb < MIN_STOPBAND_ATTENUATION_DB)
+        {
+            std::printf("  %.0f Hz attenuated by only %.1f dB\n", frequency, attenuationDb);
+            return false;
+        }
+
+        return true;
+    }
+}
+
+bool TestResamplerDcGain()
+{
+    constexpr short LEVEL = 10000;
+    for (double speedFactor : {SpeedResampler::MIN_SPEED_FACTOR, 0.7, 1.5, 2.0, SpeedResampler::MAX_SPEED_FACTOR})
+    {
+        ToneSource source(0.0, LEVEL);
+        const std::vector<short> output = Play(source, speedFactor);
+        if (output.empty())
+        {
+            std::puts("  resampler failed");
+            return false;
+        }
+
+        for (short sample : output)
+        {
+            if (std::abs(sample - LEVEL) > 1)
+            {
+                std::printf("  %d instead of %d at %.2fx\n", sample, LEVEL, speedFactor);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TestResamplerKernelNeverClamped()
+{
+    // The buffered taps are sized for the widest kernel, so the kernel (widened as the cutoff is lowered) must never be cut short to fit.
+    for (double speedFactor = SpeedResampler::MIN_SPEED_FACTOR; speedFactor < SpeedResampler::MAX_SPEED_FACTOR; speedFactor += 0.01)
+    {
+        if (SpeedResampler::GetKernelHalfWidth(speedFactor) > SpeedResampler::GetMaxKernelHalfWidth())
+        {
+            std::printf("  half width %zu exceeds %zu at %.2fx\n", SpeedResampler::GetKernelHalfWidth(speedFactor), SpeedResampler::GetMaxKernelHalfWidth(), speedFactor);
+            return false;
+        }
+    }
+
+    if (SpeedResampler::GetKernelHalfWidth(SpeedResampler::MAX_SPEED_FACTOR) != SpeedResampler::GetMaxKernelHalfWidth())
+    {
+        std::printf("  half width %zu at %.2fx instead of %zu\n", SpeedResampler::GetKernelHalfWidth(SpeedResampler::MAX_SPEED_FACTOR), SpeedResampler::MAX_SPEED_FACTOR, SpeedResampler::GetMaxKernelHalfWidth());
+        return false;
+    }
+
+    return true;
+}
+
+bool TestResamplerStopbandAt1_5x()
+{
+    // Output Nyquist is at 16 kHz of the source.
+    return TestStopband(1.5, 21000.0) && TestStopband(1.5, 23000.0);
+}
+
+bool TestResamplerStopbandAt4x()
+{
+    // Output Nyquist is at 6 kHz of the source.
+    return TestStopband(4.0, 9000.0) && TestStopband(4.0, 15000.0) && TestStopband(4.0, 22000.0);
+}
+
+bool TestResamplerContinuityAcrossPassThrough()
+{
+    RampSource source;
+    SpeedResampler resampler;
+    resampler.SetSource(source, NUM_CHANNELS);
+
+    // 1.0x is passed through, so switching to and from it must neither skip nor repeat more than the rounding to a whole frame.
+    std::vector<short> buffer(FRAMES * NUM_CHANNELS);
+    int previous = -1;
+    for (double speedFactor : {1.0, 1.0, 2.0, 2.0, 1.0, 0.5, 0.5, 1.0, 1.0, 1.5, 1.0})
+    {
+        resampler.SetSpeedFactor(speedFactor);
+        if (!resampler.TryFillBuffer(buffer.data(), FRAMES))
+        {
+            std::puts("  resampler failed");
+            return false;
+        }
+
+        for (unsigned long i = 0; i < FRAMES; ++i)
+        {
+            const int sample = buffer[i * NUM_CHANNELS];
+            const int maxStep = static_cast<int>(std::ceil(speedFactor)) + 1; // Plus the rounding.
+            if (previous >= 0 && (sample < previous || sample - previous > maxStep))
+            {
+                std::printf("  jump from %d to %d at %.2fx\n", previous, sample, speedFactor);
+                return false;
+            }
+
+            previous = sample;
+        }
+    }
+
+    return true;
+}
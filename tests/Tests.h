@@ -0,0 +1,47 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+#pragma once
+
+// Each returns whether it passed (printing the details of a failure, indented).
+
+// PreRenderTest.cpp
+bool TestSeekJustPastRenderedEndOfFullWindow();
+bool TestStopDuringFarReanchor();
+bool TestNewerSeekSupersedesFarReanchor();
+bool TestContentAfterAbandonedReanchor();
+bool TestFailedJumpLaneDoesNotStopFrontLane();
+bool TestAdoptRunningContinuesRendering();
+
+// SpeedResamplerTest.cpp
+bool TestResamplerDcGain();
+bool TestResamplerKernelNeverClamped();
+bool TestResamplerStopbandAt1_5x();
+bool TestResamplerStopbandAt4x();
+bool TestResamplerContinuityAcrossPassThrough();
+
+// TimeStretcherTest.cpp
+bool TestStretcherOutputLengthFollowsSpeed();
+bool TestStretcherReturnsToPassThrough();
+
+// Md5LanesTest.cpp
+bool TestMd5RfcVectors();
+bool TestMd5PaddingBoundaries();
+
+// SonglengthsTest.cpp
+bool TestSonglengthsLookupByDigest();
@@ -0,0 +1,60 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// Regression tests (console app). Prints one line per test and returns non-zero if any of them failed.
+// Usage: sidplaywx-tests
+
+#include "Tests.h"
+#include <cstdio>
+
+int main()
+{
+    struct
+    {
+        const char* name;
+        bool (*run)();
+    } const tests[] =
+    {
+        {"PreRender: seek just past the rendered end of a full window", &TestSeekJustPastRenderedEndOfFullWindow},
+        {"PreRender: stop during a far re-anchoring", &TestStopDuringFarReanchor},
+        {"PreRender: newer seek supersedes a far re-anchoring", &TestNewerSeekSupersedesFarReanchor},
+        {"PreRender: content after an abandoned re-anchoring", &TestContentAfterAbandonedReanchor},
+        {"PreRender: failed jump lane doesn't stop the front lane", &TestFailedJumpLaneDoesNotStopFrontLane},
+        {"PreRender: taken over render continues where it was", &TestAdoptRunningContinuesRendering},
+        {"SpeedResampler: DC gain", &TestResamplerDcGain},
+        {"SpeedResampler: kernel is never cut short", &TestResamplerKernelNeverClamped},
+        {"SpeedResampler: stopband attenuation at 1.5x", &TestResamplerStopbandAt1_5x},
+        {"SpeedResampler: stopband attenuation at 4x", &TestResamplerStopbandAt4x},
+        {"SpeedResampler: continuity across the pass-through toggle", &TestResamplerContinuityAcrossPassThrough},
+        {"TimeStretcher: output length follows the speed factor", &TestStretcherOutputLengthFollowsSpeed},
+        {"TimeStretcher: return to 1.0x passes the source through", &TestStretcherReturnsToPassThrough},
+        {"Md5Lanes: RFC 1321 test suite", &TestMd5RfcVectors},
+        {"Md5Lanes: padding at the block boundaries", &TestMd5PaddingBoundaries},
+        {"Songlengths: lookup by the batch hashed MD5", &TestSonglengthsLookupByDigest},
+    };
+
+    int failed = 0;
+    for (const auto& test : tests)
+    {
+        const bool passed = test.run();
+        std::printf("%s: %s\n", (passed) ? "PASS" : "FAIL", test.name);
+        failed += (passed) ? 0 : 1;
+    }
+
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/*
+ * This file is part of sidplaywx, a GUI player for Commodore 64 SID music files.
+ * Copyright (C) 2024 Jasmin Rutic (bytespiller@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see https://www.gnu.org/licenses/gpl-3.0.html
+ */
+
+// TimeStretcher regression tests (see TestsMain.cpp).
+
+#include "Tests.h"
+#include "../src/PlaybackController/TimeStretcher.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    constexpr int SAMPLE_RATE = 48000;
+    constexpr int NUM_CHANNELS = 2;
+    constexpr unsigned long FRAMES = 512; // Per audio callback.
+    constexpr size_t WINDOW_FRAMES = SAMPLE_RATE * 40 / 1000; // Like the TimeStretcher's.
+    constexpr double PI = 3.14159265358979323846;
+
+    /// @brief A 440 Hz sine with each frame's index in the last channel, so both the content and the consumed source frames can be verified.
+    class IndexedSource : public IBufferWriter
+    {
+    public:
+        bool TryFillBuffer(void* buffer, unsigned long framesPerBuffer) override
+        {
+            short* const out = static_cast<short*>(buffer);
+            for (unsigned long i = 0; i < framesPerBuffer; ++i, ++_frame)
+            {
+                out[i * NUM_CHANNELS] = static_cast<short>(std::lround(8000.0 * std::sin(2.0 * PI * 440.0 * _frame / SAMPLE_RATE)));
+                out[i * NUM_CHANNELS + NUM_CHANNELS - 1] = static_cast<short>(_frame);
+            }
+
+            return true;
+        }
+
+        size_t GetConsumedFrames() const
+        {
+            return _frame;
+        }
+
+    private:
+        size_t _frame = 0;
+    };
+}
+
+bool TestStretcherOutputLengthFollowsSpeed()
+{
+    constexpr size_t OUTPUT_FRAMES = SAMPLE_RATE * 4;
+    constexpr size_t SLACK_FRAMES = 2 * WINDOW_FRAMES + FRAMES; // Read ahead for the similarity search, plus the last callback.
+
+    std::vector<short> buffer(FRAMES * NUM_CHANNELS);
+    for (double speedFactor : {0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 4.0})
+    {
+        IndexedSource source;
+        TimeStretcher stretcher;
+        stretcher.SetSource(source, SAMPLE_RATE, NUM_CHANNELS);
+        stretcher.SetSpeedFactor(speedFactor);
+
+        for (size_t played = 0; played < OUTPUT_FRAMES; played += FRAMES)
+        {
+            if (!stretcher.TryFillBuffer(buffer.data(), FRAMES))
+            {
+                std::puts("  stretcher failed");
+                return false;
+            }
+        }
+
+        // The source is consumed at the speed factor, so the output is that much shorter (or longer) than the source.
+        // Reminder: at high speeds, the read-ahead for the next hop is shorter than the hop itself (i.e., half a window of output).
+        const double expectedFrames = OUTPUT_FRAMES * speedFactor;
+        const double consumedFrames = static_cast<double>(source.GetConsumedFrames());
+        if (consumedFrames < expectedFrames - WINDOW_FRAMES / 2 * speedFactor || consumedFrames > expectedFrames + SLACK_FRAMES)
+        {
+            std::printf("  consumed %.0f source frames for %zu at %.2fx (expected %.0f)\n", consumedFrames, OUTPUT_FRAMES, speedFactor, expectedFrames);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TestStretcherReturnsToPassThrough()
+{
+    constexpr int STRETCHED_CALLBACKS = 50;
+    constexpr int PASS_THROUGH_CALLBACKS = 50;
+
+    std::vector<short> buffer(FRAMES * NUM_CHANNELS);
+    for (double speedFactor : {0.5, 1.5, 3.0})
+    {
+        IndexedSource source;
+        TimeStretcher stretcher;
+        stretcher.SetSource(source, SAMPLE_RATE, NUM_CHANNELS);
+        stretcher.SetSpeedFactor(speedFactor);
+
+        for (int i = 0; i < STRETCHED_CALLBACKS; ++i)
+        {
+            if (!stretcher.TryFillBuffer(buffer.data(), FRAMES))
+            {
+                std::puts("  stretcher failed");
+                return false;
+            }
+        }
+
+        // Back at 1.0x only the rest of the last stretched hop (under half a window) may precede the untouched source, which then continues without any gap.
+        stretcher.SetSpeedFactor(1.0);
+        std::vector<short> output;
+        for (int i = 0; i < PASS_THROUGH_CALLBACKS; ++i)
+        {
+            if (!stretcher.TryFillBuffer(buffer.data(), FRAMES))
+            {
+                std::puts("  stretcher failed");
+                return false;
+            }
+
+            output.insert(output.end(), buffer.begin(), buffer.end());
+        }
+
+        const size_t outputFrames = output.size() / NUM_CHANNELS;
+        const auto indexAt = [&output](size_t frame) { return static_cast<unsigned short>(output[frame * NUM_CHANNELS + NUM_CHANNELS - 1]); };
+        size_t passThroughFrom = outputFrames - 1;
+        while (passThroughFrom > 0 && static_cast<unsigned short>(indexAt(passThroughFrom - 1) + 1) == indexAt(passThroughFrom))
+        {
+            --passThroughFrom;
+        }
+
+        if (passThroughFrom > WINDOW_FRAMES / 2)
+        {
+            std::printf("  still not passed through after %zu frames at %.2fx\n", passThroughFrom, speedFactor);
+            return false;
+        }
+
+        if (indexAt(outputFrames - 1) != static_cast<unsigned short>(source.GetConsumedFrames() - 1))
+        {
+            std::printf("  source not consumed at 1.0x after %.2fx\n", speedFactor);
+            return false;
+        }
+    }
+
+    return true;
+}